@@ -0,0 +1,94 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "arena.hpp"
+#include "flat_document.hpp"
+#include "gdl_generator.hpp"
+#include "tree_cursor.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+struct Placement {
+  const char* name;
+  bool uses_arena;
+  bool uses_huge_pages;
+  int numa_node;
+};
+
+// Random access over the whole document, like passes joining arguments of
+// distant clauses
+std::size_t VisitAll(const sp::FlatDocument& document) {
+  std::size_t checksum = 0;
+  for (sp::FlatTreeCursor cursor(document); cursor.IsValid(); cursor.Next()) {
+    const auto& node = document.GetNode(cursor.GetNode());
+    checksum += node.symbol != sp::kNoSymbol ? document.GetSymbolLength(node.symbol) : node.child_count;
+  }
+  return checksum;
+}
+
+}
+
+// Traversals over flat documents on the heap and in arenas with huge pages
+// and NUMA binding. Each worker builds and traverses its own document, as
+// per-worker arenas are bound to the worker's local node.
+// Args: [num_predicates] [num_threads]
+BENCHMARK(ArenaPlacement) {
+  sp::GameGeneratorOptions options;
+  options.num_predicates = args.size() >= 1 ? std::atoi(args[0].c_str()) : 200000;
+  options.max_arity = 4;
+  options.rule_width = 5;
+  const auto num_threads = args.size() >= 2 ? std::atoi(args[1].c_str()) : 1;
+  const auto kif = sp::GenerateGame(options);
+  const auto nodes = sp::ParseKIF(kif);
+  const Placement placements[] = {
+    {"heap", false, false, sp::kNoNumaNode},
+    {"arena", true, false, sp::kNoNumaNode},
+    {"arena, huge pages", true, true, sp::kNoNumaNode},
+    {"arena, huge pages, local node", true, true, sp::kLocalNumaNode}
+  };
+  for (const auto& placement : placements) {
+    sp::ArenaOptions arena_options;
+    arena_options.uses_huge_pages = placement.uses_huge_pages;
+    arena_options.numa_node = placement.numa_node;
+    std::vector<std::unique_ptr<sp::FlatDocument>> documents(num_threads);
+    const auto run = [&](const std::function<void(int)>& work) {
+      std::vector<std::thread> threads;
+      for (auto i = 0; i < num_threads; ++i) {
+        threads.emplace_back(work, i);
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    };
+    const auto label = std::string(placement.name) + ": ";
+    benchmark::Measure(label + "build", kif.size() * num_threads, 0, [&]() {
+      run([&](const int i) {
+        documents[i].reset(placement.uses_arena ? new sp::FlatDocument(nodes, arena_options) : new sp::FlatDocument(nodes));
+      });
+    });
+    const auto num_nodes = documents.front()->GetNodeCount();
+    std::vector<std::size_t> checksums(num_threads);
+    benchmark::Measure(label + "traverse", kif.size() * num_threads, num_nodes * num_threads, [&]() {
+      run([&](const int i) {
+        checksums[i] = VisitAll(*documents[i]);
+      });
+    });
+    benchmark::Measure(label + "ToTreeNodes", kif.size() * num_threads, num_nodes * num_threads, [&]() {
+      run([&](const int i) {
+        documents[i]->ToTreeNodes();
+      });
+    });
+    if (const auto arena = documents.front()->GetArena()) {
+      std::printf("  mapped %zu bytes, %zu with MAP_HUGETLB, %zu bound to node %d\n",
+          arena->GetMappedBytes(), arena->GetHugeTLBBytes(), arena->GetBoundBytes(), arena->GetNumaNode());
+    }
+  }
+}
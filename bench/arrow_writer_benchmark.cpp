@@ -0,0 +1,44 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "arrow_writer.hpp"
+#include "gdl_generator.hpp"
+#include "tree_writers.hpp"
+
+namespace sp = sexpr_parser;
+
+// Columnar export of many parsed records, against JSON of the same trees.
+// Args: [num_records] [num_predicates]
+BENCHMARK(ArrowExport) {
+  const auto num_records = args.size() >= 1 ? std::atoi(args[0].c_str()) : 200;
+  sp::GameGeneratorOptions options;
+  options.num_predicates = args.size() >= 2 ? std::atoi(args[1].c_str()) : 1000;
+  std::vector<std::vector<sp::TreeNode>> records;
+  std::size_t bytes = 0;
+  for (auto i = 0; i < num_records; ++i) {
+    options.seed = i + 1;
+    const auto kif = sp::GenerateGame(options);
+    bytes += kif.size();
+    records.push_back(sp::ParseKIF(kif));
+  }
+  std::ostringstream arrow;
+  sp::ArrowWriter writer(arrow);
+  benchmark::Measure("Arrow", bytes, 0, [&]() {
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      writer.WriteRecord(i, records[i]);
+    }
+    writer.Close();
+  });
+  std::ostringstream json;
+  benchmark::Measure("JSON", bytes, 0, [&]() {
+    for (const auto& record : records) {
+      sp::WriteJSON(json, record);
+    }
+  });
+  std::printf("  %zu rows in %zu batches, %zu symbols\n", writer.GetRowCount(), writer.GetBatchCount(), writer.GetSymbolCount());
+  std::printf("  Arrow: %zu bytes, JSON: %zu bytes\n", arrow.str().size(), json.str().size());
+}
@@ -0,0 +1,83 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+namespace benchmark {
+
+std::map<std::string, BenchmarkFunction>& GetBenchmarks() {
+  static std::map<std::string, BenchmarkFunction> benchmarks;
+  return benchmarks;
+}
+
+bool Register(const std::string& name, BenchmarkFunction function) {
+  return GetBenchmarks().emplace(name, function).second;
+}
+
+Timer::Timer() : start_(std::chrono::steady_clock::now()) {
+}
+
+void Timer::Restart() {
+  start_ = std::chrono::steady_clock::now();
+}
+
+double Timer::GetElapsedSeconds() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void Report(const std::string& label, const double seconds, const std::size_t bytes, const std::size_t nodes, const PerfCounters* counters) {
+  std::printf("%s: %.3f ms, %.1f MB/s\n", label.c_str(), seconds * 1e3, bytes / seconds / 1e6);
+  if (!counters) {
+    return;
+  }
+  auto any_available = false;
+  for (std::size_t i = 0; i < counters->GetCounterCount(); ++i) {
+    any_available = any_available || counters->IsAvailable(i);
+  }
+  if (!any_available) {
+    std::printf("  hardware counters unavailable\n");
+    return;
+  }
+  for (std::size_t i = 0; i < counters->GetCounterCount(); ++i) {
+    if (!counters->IsAvailable(i)) {
+      std::printf("  %-14s n/a\n", counters->GetName(i).c_str());
+      continue;
+    }
+    const auto value = static_cast<double>(counters->GetValue(i));
+    std::printf("  %-14s %14.0f  %8.3f/byte", counters->GetName(i).c_str(), value, bytes ? value / bytes : 0.0);
+    if (nodes) {
+      std::printf("  %8.3f/node", value / nodes);
+    }
+    if (counters->GetRunningFraction(i) < 1) {
+      std::printf("  (multiplexed, ran %.0f%%)", counters->GetRunningFraction(i) * 100);
+    }
+    std::printf("\n");
+  }
+}
+
+}
+
+// Usage: bench [name [args...]]
+// Without a name all benchmarks run with their default arguments.
+int main(int argc, char** argv) {
+  const auto& benchmarks = benchmark::GetBenchmarks();
+  if (argc >= 2) {
+    const auto found = benchmarks.find(argv[1]);
+    if (found == benchmarks.end()) {
+      std::cerr << "Unknown benchmark: " << argv[1] << std::endl;
+      std::cerr << "Available benchmarks:" << std::endl;
+      for (const auto& name_and_function : benchmarks) {
+        std::cerr << "  " << name_and_function.first << std::endl;
+      }
+      return 1;
+    }
+    found->second(std::vector<std::string>(argv + 2, argv + argc));
+    return 0;
+  }
+  for (const auto& name_and_function : benchmarks) {
+    std::cout << "[" << name_and_function.first << "]" << std::endl;
+    name_and_function.second(std::vector<std::string>());
+  }
+  return 0;
+}
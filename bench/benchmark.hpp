@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "perf_counters.hpp"
+
+namespace benchmark {
+
+// Benchmarks receive the command line arguments following their name
+using BenchmarkFunction = void (*)(const std::vector<std::string>& args);
+
+bool Register(const std::string& name, BenchmarkFunction function);
+
+#define BENCHMARK(name) \
+  static void name(const std::vector<std::string>& args); \
+  static const bool name##_registered = ::benchmark::Register(#name, name); \
+  static void name(const std::vector<std::string>& args)
+
+class Timer {
+public:
+  Timer();
+  void Restart();
+  double GetElapsedSeconds() const;
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Prints one line of the form "label: 12.345 ms, 81.0 MB/s", followed by
+// hardware counters per input byte and per node when they are given
+void Report(const std::string& label, const double seconds, const std::size_t bytes, const std::size_t nodes = 0, const PerfCounters* counters = nullptr);
+
+// Runs the function once under the timer and the hardware counters
+template <class Function>
+void Measure(const std::string& label, const std::size_t bytes, const std::size_t nodes, Function function) {
+  PerfCounters counters;
+  Timer timer;
+  counters.Start();
+  function();
+  counters.Stop();
+  const auto seconds = timer.GetElapsedSeconds();
+  Report(label, seconds, bytes, nodes, &counters);
+}
+
+}
+
+#endif /* BENCHMARK_HPP_ */
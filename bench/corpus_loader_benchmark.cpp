@@ -0,0 +1,128 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "corpus_loader.hpp"
+#include "gdl_generator.hpp"
+#include "scaling.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+// Writes num_files generated games to a new temporary directory
+std::string WriteCorpus(const std::size_t num_files, std::vector<std::string>& paths, std::size_t& bytes) {
+  char directory[] = "/tmp/sexpr_parser_corpusXXXXXX";
+  if (!::mkdtemp(directory)) {
+    return std::string();
+  }
+  bytes = 0;
+  for (std::size_t i = 0; i < num_files; ++i) {
+    sp::GameGeneratorOptions options;
+    options.seed = static_cast<unsigned>(i);
+    options.num_predicates = 20 + i % 50;
+    const auto kif = sp::GenerateGame(options);
+    paths.push_back(std::string(directory) + "/game" + std::to_string(i) + ".kif");
+    std::ofstream(paths.back()) << kif;
+    bytes += kif.size();
+  }
+  return directory;
+}
+
+void RemoveCorpus(const std::string& directory, const std::vector<std::string>& paths) {
+  for (const auto& path : paths) {
+    std::remove(path.c_str());
+  }
+  ::rmdir(directory.c_str());
+}
+
+// Paths of the regular files in a directory
+std::vector<std::string> ListFiles(const std::string& directory) {
+  std::vector<std::string> paths;
+  const auto dir = ::opendir(directory.c_str());
+  if (!dir) {
+    return paths;
+  }
+  while (const auto entry = ::readdir(dir)) {
+    if (entry->d_type == DT_REG) {
+      paths.push_back(directory + "/" + entry->d_name);
+    }
+  }
+  ::closedir(dir);
+  return paths;
+}
+
+class CorpusLoaderTarget : public benchmark::ScalingTarget {
+public:
+  std::size_t Prepare(const std::size_t size) override {
+    std::size_t bytes = 0;
+    // Size is in files here, at most 10000
+    directory_ = WriteCorpus(std::min<std::size_t>(size, 10000), paths_, bytes);
+    return bytes;
+  }
+  void Run(const std::size_t num_threads) override {
+    sp::CorpusLoaderOptions options;
+    options.num_parse_threads = num_threads;
+    sp::CorpusLoader(options).Load(paths_);
+  }
+  void Clear() override {
+    RemoveCorpus(directory_, paths_);
+    paths_.clear();
+  }
+private:
+  std::string directory_;
+  std::vector<std::string> paths_;
+};
+
+SCALING_TARGET(CorpusLoader, CorpusLoaderTarget);
+
+}
+
+// Loading a game library with one blocking read and Parse() per file, and
+// with CorpusLoader through io_uring and through its thread pool.
+// Without a directory, a corpus of generated games is written first.
+// The page cache is warm after the first pass; for cold-start numbers,
+// drop caches between runs ("echo 3 > /proc/sys/vm/drop_caches").
+// Args: [num_files | directory]
+BENCHMARK(CorpusLoading) {
+  std::vector<std::string> paths;
+  std::string directory;
+  std::size_t bytes = 0;
+  const auto uses_directory = args.size() >= 1 && std::atoi(args[0].c_str()) == 0;
+  if (uses_directory) {
+    paths = ListFiles(args[0]);
+  } else {
+    const std::size_t num_files = args.size() >= 1 ? std::atoi(args[0].c_str()) : 2000;
+    directory = WriteCorpus(num_files, paths, bytes);
+  }
+  benchmark::Measure("blocking read and Parse", bytes, 0, [&]() {
+    bytes = 0;
+    for (const auto& path : paths) {
+      std::ifstream file(path);
+      std::stringstream text;
+      text << file.rdbuf();
+      bytes += text.str().size();
+      sp::ParseKIF(text.str());
+    }
+  });
+  sp::CorpusLoaderOptions options;
+  sp::CorpusLoader loader(options);
+  benchmark::Measure("CorpusLoader", bytes, 0, [&]() {
+    loader.Load(paths);
+  });
+  std::printf("  backend: %s\n", loader.GetLastBackend() == sp::LoaderBackend::kIoUring ? "io_uring" : "thread pool");
+  options.uses_io_uring = false;
+  benchmark::Measure("CorpusLoader (thread pool)", bytes, 0, [&]() {
+    sp::CorpusLoader(options).Load(paths);
+  });
+  if (!uses_directory) {
+    RemoveCorpus(directory, paths);
+  }
+}
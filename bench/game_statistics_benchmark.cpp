@@ -0,0 +1,68 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "game_statistics.hpp"
+#include "gdl_generator.hpp"
+#include "scaling.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+// Size is in playouts here, with no time limit
+class GameStatisticsTarget : public benchmark::ScalingTarget {
+public:
+  std::size_t Prepare(const std::size_t size) override {
+    const auto kif = sp::GenerateGame();
+    clauses_ = sp::ParseKIF(kif);
+    max_playouts_ = size;
+    return kif.size();
+  }
+  void Run(const std::size_t num_threads) override {
+    sp::GameStatisticsOptions options;
+    options.num_threads = num_threads;
+    options.time_limit = 0;
+    options.max_playouts = max_playouts_;
+    sp::GameStatistics statistics;
+    sp::SampleGameStatistics(clauses_, options, statistics);
+  }
+  void Clear() override {
+    std::vector<sp::TreeNode>().swap(clauses_);
+  }
+private:
+  std::vector<sp::TreeNode> clauses_;
+  std::size_t max_playouts_;
+};
+
+SCALING_TARGET(GameStatistics, GameStatisticsTarget);
+
+}
+
+// Random playouts of a generated game for a fixed number of playouts, then
+// for a time limit, followed by the statistics as JSON.
+// Args: [board_size] [num_predicates] [time_limit]
+BENCHMARK(GameStatistics) {
+  sp::GameGeneratorOptions game_options;
+  game_options.board_size = args.size() >= 1 ? std::atoi(args[0].c_str()) : 5;
+  game_options.num_predicates = args.size() >= 2 ? std::atoi(args[1].c_str()) : 20;
+  const auto kif = sp::GenerateGame(game_options);
+  const auto clauses = sp::ParseKIF(kif);
+  sp::GameStatisticsOptions options;
+  options.time_limit = 0;
+  options.max_playouts = 100;
+  sp::GameStatistics statistics;
+  benchmark::Measure("100 playouts", kif.size(), 0, [&]() {
+    sp::SampleGameStatistics(clauses, options, statistics);
+  });
+  options.time_limit = args.size() >= 3 ? std::atof(args[2].c_str()) : 1;
+  options.max_playouts = SIZE_MAX;
+  sp::SampleGameStatistics(clauses, options, statistics);
+  std::printf("  %zu playouts, %zu states in %.2f s\n", statistics.playouts, statistics.states, statistics.seconds);
+  sp::WriteGameStatisticsJSON(std::cout, statistics);
+  std::cout << std::endl;
+}
@@ -0,0 +1,68 @@
+#include "memory_usage.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/resource.h>
+
+namespace benchmark {
+
+namespace {
+
+// Returns the value of a "Name:   1234 kB" line in bytes, or 0
+std::size_t ReadStatusField(const char* name) {
+  const auto file = std::fopen("/proc/self/status", "r");
+  if (!file) {
+    return 0;
+  }
+  const auto name_length = std::strlen(name);
+  char line[256];
+  std::size_t kilobytes = 0;
+  while (std::fgets(line, sizeof(line), file)) {
+    if (std::strncmp(line, name, name_length) == 0 && line[name_length] == ':') {
+      std::sscanf(line + name_length + 1, "%zu", &kilobytes);
+      break;
+    }
+  }
+  std::fclose(file);
+  return kilobytes * 1024;
+}
+
+}
+
+std::size_t GetResidentSetSize() {
+  return ReadStatusField("VmRSS");
+}
+
+std::size_t GetPeakResidentSetSize() {
+  const auto peak = ReadStatusField("VmHWM");
+  if (peak > 0) {
+    return peak;
+  }
+  rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+bool ResetPeakResidentSetSize() {
+  // See proc(5), /proc/[pid]/clear_refs
+  const auto file = std::fopen("/proc/self/clear_refs", "w");
+  if (!file) {
+    return false;
+  }
+  const auto ok = std::fputs("5", file) >= 0;
+  return (std::fclose(file) == 0) && ok;
+}
+
+void TrimHeap() {
+#ifdef __GLIBC__
+  ::malloc_trim(0);
+#endif
+}
+
+}
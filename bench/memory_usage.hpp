@@ -0,0 +1,24 @@
+#ifndef MEMORY_USAGE_HPP_
+#define MEMORY_USAGE_HPP_
+
+#include <cstddef>
+
+namespace benchmark {
+
+// Resident set size of the process in bytes, from /proc/self/status
+std::size_t GetResidentSetSize();
+
+// High-water mark of the resident set size in bytes. After a successful
+// ResetPeakResidentSetSize() it starts again from the current size, so a
+// peak can be attributed to a single measurement. The reset needs Linux
+// 4.0 or later; without it the peak covers the whole process lifetime.
+std::size_t GetPeakResidentSetSize();
+bool ResetPeakResidentSetSize();
+
+// Returns freed heap memory to the system where the allocator supports it,
+// so that memory of a previous measurement does not hide the next peak
+void TrimHeap();
+
+}
+
+#endif /* MEMORY_USAGE_HPP_ */
@@ -0,0 +1,201 @@
+#include "benchmark.hpp"
+
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+
+#include "gdl_generator.hpp"
+#include "parallel_parser.hpp"
+#include "parse_limits.hpp"
+#include "scaling.hpp"
+#include "sexpr_parser.hpp"
+#include "tree_cursor.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+// One top-level form holding all facts, like a big state snapshot
+std::string MakeSingleHugeForm(const int num_facts) {
+  std::ostringstream o;
+  o << "(init";
+  for (auto i = 0; i < num_facts; ++i) {
+    o << " (cell " << i % 1000 << ' ' << i / 1000 << " b)";
+  }
+  o << ')';
+  return o.str();
+}
+
+std::size_t CountNodes(const std::vector<sp::TreeNode>& nodes) {
+  std::size_t count = 0;
+  for (sp::TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next()) {
+    ++count;
+  }
+  return count;
+}
+
+}
+
+// Args: [num_facts] [num_threads]
+BENCHMARK(ParseSingleHugeForm) {
+  const auto num_facts = args.size() >= 1 ? std::atoi(args[0].c_str()) : 200000;
+  const auto num_threads = args.size() >= 2 ? std::atoi(args[1].c_str()) : std::thread::hardware_concurrency();
+  const auto sexpr = MakeSingleHugeForm(num_facts);
+  const auto num_nodes = CountNodes(sp::Parse(sexpr));
+  benchmark::Measure("Parse", sexpr.size(), num_nodes, [&]() {
+    sp::Parse(sexpr);
+  });
+  benchmark::Measure("ParseParallel (" + std::to_string(num_threads) + " threads)", sexpr.size(), num_nodes, [&]() {
+    sp::ParseParallel(sexpr, num_threads);
+  });
+}
+
+// Passes over a parsed game description
+// Args: [num_predicates]
+BENCHMARK(CollectPasses) {
+  sp::GameGeneratorOptions options;
+  options.num_predicates = args.size() >= 1 ? std::atoi(args[0].c_str()) : 20000;
+  const auto kif = sp::GenerateGame(options);
+  const auto nodes = sp::ParseKIF(kif);
+  const auto num_nodes = CountNodes(nodes);
+  benchmark::Measure("CollectAtoms", kif.size(), num_nodes, [&]() {
+    sp::CollectAtoms(nodes);
+  });
+  benchmark::Measure("CollectNonFunctorAtoms", kif.size(), num_nodes, [&]() {
+    sp::CollectNonFunctorAtoms(nodes);
+  });
+  benchmark::Measure("CollectFunctorAtoms", kif.size(), num_nodes, [&]() {
+    sp::CollectFunctorAtoms(nodes);
+  });
+  benchmark::Measure("ToProlog", kif.size(), num_nodes, [&]() {
+    sp::ToProlog(nodes, false);
+  });
+  benchmark::Measure("ToProlog with helper clauses", kif.size(), num_nodes, [&]() {
+    sp::ToProlog(nodes, false, "", "", true);
+  });
+}
+
+// Scaling with the size of synthetic games, and with adversarial inputs.
+// Time per byte should stay flat as the size grows.
+// Args: [max_predicates]
+BENCHMARK(GameScaling) {
+  const std::size_t max_predicates = args.size() >= 1 ? std::atol(args[0].c_str()) : 100000;
+  for (std::size_t num_predicates = 100; num_predicates <= max_predicates; num_predicates *= 10) {
+    sp::GameGeneratorOptions options;
+    options.num_predicates = num_predicates;
+    options.max_arity = 4;
+    options.rule_width = 5;
+    options.nesting_depth = 2;
+    const auto kif = sp::GenerateGame(options);
+    const auto nodes = sp::ParseKIF(kif);
+    const auto num_nodes = CountNodes(nodes);
+    const auto label = std::to_string(num_predicates) + " predicates: ";
+    benchmark::Measure(label + "ParseKIF", kif.size(), num_nodes, [&]() {
+      sp::ParseKIF(kif);
+    });
+    benchmark::Measure(label + "ToProlog", kif.size(), num_nodes, [&]() {
+      sp::ToProlog(nodes, false);
+    });
+    benchmark::Measure(label + "ToProlog with helper clauses", kif.size(), num_nodes, [&]() {
+      sp::ToProlog(nodes, false, "", "", true);
+    });
+  }
+  for (std::size_t size = 1000; size <= 10000; size *= 10) {
+    const auto deep = sp::GenerateDeeplyNestedTerm(size);
+    benchmark::Measure("depth " + std::to_string(size) + ": Parse", deep.size(), 2 * size + 1, [&]() {
+      sp::Parse(deep);
+    });
+    const auto wide = sp::GenerateWideRule(size);
+    const auto wide_nodes = sp::Parse(wide);
+    const auto num_nodes = CountNodes(wide_nodes);
+    benchmark::Measure("width " + std::to_string(size) + ": Parse", wide.size(), num_nodes, [&]() {
+      sp::Parse(wide);
+    });
+    benchmark::Measure("width " + std::to_string(size) + ": ToProlog with helper clauses", wide.size(), num_nodes, [&]() {
+      sp::ToProlog(wide_nodes, false, "", "", true);
+    });
+  }
+}
+
+// Hostile inputs under typical limits. Throughput in MB/s should not drop
+// as the input grows, whether the input is rejected or not.
+// Args: [max_size]
+BENCHMARK(AttackInputs) {
+  const std::size_t max_size = args.size() >= 1 ? std::atol(args[0].c_str()) : 1000000;
+  sp::ParseLimits limits;
+  limits.max_depth = 100;
+  limits.max_symbol_length = 1024;
+  limits.max_helper_pairs = 1000000;
+  for (std::size_t size = 1000; size <= max_size; size *= 10) {
+    const auto suffix = " (" + std::to_string(size) + ")";
+    std::vector<sp::TreeNode> nodes;
+    sp::LimitError error;
+    // Rejected at the depth limit, so only the bytes up to there count
+    const auto deep = sp::GenerateDeeplyNestedTerm(size);
+    sp::ParseWithLimits(deep, limits, nodes, error);
+    const auto consumed = error.kind == sp::LimitKind::kNone ? deep.size() : error.position;
+    benchmark::Measure("deep term" + suffix, consumed, 0, [&]() {
+      sp::ParseWithLimits(deep, limits, nodes, error);
+    });
+    benchmark::Measure("deep term without depth limit" + suffix, deep.size(), 0, [&]() {
+      sp::ParseWithLimits(deep, sp::ParseLimits(), nodes, error);
+    });
+    const auto long_symbol = "(f " + std::string(size * 4, 'a') + ")";
+    benchmark::Measure("long symbol" + suffix, long_symbol.size(), 0, [&]() {
+      sp::ParseWithLimits(long_symbol, limits, nodes, error);
+    });
+    const auto wide = sp::GenerateWideRule(size);
+    benchmark::Measure("wide rule" + suffix, wide.size(), 0, [&]() {
+      sp::ParseWithLimits(wide, limits, nodes, error);
+    });
+    const auto repeated = sp::GenerateRepeatedVariableRule(size);
+    benchmark::Measure("repeated variable rule" + suffix, repeated.size(), 0, [&]() {
+      sp::ParseWithLimits(repeated, limits, nodes, error);
+      sp::CheckHelperPairLimit(nodes, limits, error);
+    });
+  }
+}
+
+namespace {
+
+class ParseParallelTarget : public benchmark::ScalingTarget {
+public:
+  std::size_t Prepare(const std::size_t size) override {
+    sexpr_ = MakeSingleHugeForm(static_cast<int>(size));
+    return sexpr_.size();
+  }
+  void Run(const std::size_t num_threads) override {
+    sp::ParseParallel(sexpr_, num_threads);
+  }
+  void Clear() override {
+    std::string().swap(sexpr_);
+  }
+private:
+  std::string sexpr_;
+};
+
+// Many small top-level forms as in game descriptions
+class ParseKIFParallelTarget : public benchmark::ScalingTarget {
+public:
+  std::size_t Prepare(const std::size_t size) override {
+    std::ostringstream o;
+    for (std::size_t i = 0; i < size; ++i) {
+      o << "(<= (next (cell ?x " << i << ")) (does ?p (mark ?x)) (true (cell ?x b))) ; rule " << i << '\n';
+    }
+    kif_ = o.str();
+    return kif_.size();
+  }
+  void Run(const std::size_t num_threads) override {
+    sp::ParseKIFParallel(kif_, num_threads);
+  }
+  void Clear() override {
+    std::string().swap(kif_);
+  }
+private:
+  std::string kif_;
+};
+
+SCALING_TARGET(ParseParallel, ParseParallelTarget);
+SCALING_TARGET(ParseKIFParallel, ParseKIFParallelTarget);
+
+}
@@ -0,0 +1,121 @@
+#include "perf_counters.hpp"
+
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace benchmark {
+
+namespace {
+
+int OpenCounter(const std::uint32_t type, const std::uint64_t config) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  // User space only, which is allowed with the default perf_event_paranoid
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // Include threads started while counting, e.g. by ParseParallel()
+  attr.inherit = 1;
+  // To scale the count when the PMU multiplexes more events than it has
+  // counters
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+std::uint64_t CacheConfig(const std::uint64_t cache, const std::uint64_t op, const std::uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+}
+
+PerfCounters::PerfCounters() : counters_() {
+  const struct {
+    const char* name;
+    std::uint32_t type;
+    std::uint64_t config;
+  } events[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"L1d-misses", PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {"LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  };
+  for (const auto& event : events) {
+    counters_.push_back(Counter{event.name, OpenCounter(event.type, event.config), 0, 1});
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (const auto& counter : counters_) {
+    if (counter.fd >= 0) {
+      ::close(counter.fd);
+    }
+  }
+}
+
+void PerfCounters::Start() {
+  for (auto& counter : counters_) {
+    counter.value = 0;
+    counter.running_fraction = 1;
+    if (counter.fd >= 0) {
+      ::ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+      ::ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void PerfCounters::Stop() {
+  for (auto& counter : counters_) {
+    if (counter.fd < 0) {
+      continue;
+    }
+    ::ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+    // Value, time enabled and time running
+    std::uint64_t data[3];
+    if (::read(counter.fd, data, sizeof(data)) != sizeof(data)) {
+      // Treat a counter that cannot be read like one that cannot be opened
+      ::close(counter.fd);
+      counter.fd = -1;
+      continue;
+    }
+    if (data[2] == 0) {
+      // Never scheduled, so nothing to scale
+      counter.value = 0;
+      counter.running_fraction = data[1] > 0 ? 0 : 1;
+    } else if (data[2] < data[1]) {
+      counter.value = static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+      counter.running_fraction = static_cast<double>(data[2]) / data[1];
+    } else {
+      counter.value = data[0];
+    }
+  }
+}
+
+std::size_t PerfCounters::GetCounterCount() const {
+  return counters_.size();
+}
+
+const std::string& PerfCounters::GetName(const std::size_t index) const {
+  return counters_.at(index).name;
+}
+
+bool PerfCounters::IsAvailable(const std::size_t index) const {
+  return counters_.at(index).fd >= 0;
+}
+
+std::uint64_t PerfCounters::GetValue(const std::size_t index) const {
+  return counters_.at(index).value;
+}
+
+double PerfCounters::GetRunningFraction(const std::size_t index) const {
+  return counters_.at(index).running_fraction;
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef PERF_COUNTERS_HPP_
+#define PERF_COUNTERS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+// Hardware counters of the calling thread through perf_event_open(2).
+// Counters that cannot be opened (no PMU, container restrictions,
+// perf_event_paranoid) are reported as unavailable and do not affect the
+// others.
+class PerfCounters {
+public:
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+  void Start();
+  void Stop();
+  std::size_t GetCounterCount() const;
+  const std::string& GetName(const std::size_t index) const;
+  bool IsAvailable(const std::size_t index) const;
+  // Scaled up from the time the counter ran when the PMU multiplexed it
+  std::uint64_t GetValue(const std::size_t index) const;
+  // Of the time enabled, below 1 when the value is an estimate
+  double GetRunningFraction(const std::size_t index) const;
+private:
+  struct Counter {
+    std::string name;
+    int fd;
+    std::uint64_t value;
+    double running_fraction;
+  };
+  std::vector<Counter> counters_;
+};
+
+}
+
+#endif /* PERF_COUNTERS_HPP_ */
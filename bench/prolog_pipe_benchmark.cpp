@@ -0,0 +1,73 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "gdl_generator.hpp"
+#include "prolog_pipe.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+std::string ReplacePath(const std::string& command, const std::string& path) {
+  const auto pos = command.find("%s");
+  if (pos == std::string::npos) {
+    return command;
+  }
+  return command.substr(0, pos) + path + command.substr(pos + 2);
+}
+
+}
+
+// Time from KIF text to a Prolog process that has consulted all clauses,
+// through a temporary file and through a pipe.
+// Args: [num_rules] [file_consult_command] [stdin_consult_command]
+// In the file command, "%s" is replaced with the path of the temporary file.
+BENCHMARK(PrologPipe) {
+  const auto num_rules = args.size() >= 1 ? std::atoi(args[0].c_str()) : 20000;
+  std::string file_command = "swipl -q -g \"consult('%s')\" -t halt";
+  std::string stdin_command = "swipl -q -g \"load_files(kif, [stream(user_input)])\" -t halt";
+  if (args.size() >= 3) {
+    file_command = args[1];
+    stdin_command = args[2];
+  } else if (std::system("command -v swipl > /dev/null 2>&1") != 0) {
+    std::printf("swipl not found, measuring with cat as the consumer\n");
+    file_command = "cat %s > /dev/null";
+    stdin_command = "cat > /dev/null";
+  }
+  sp::GameGeneratorOptions options;
+  options.num_predicates = num_rules / options.rules_per_predicate;
+  const auto kif = sp::GenerateGame(options);
+  char path[] = "/tmp/sexpr_parser_benchXXXXXX";
+  const auto fd = ::mkstemp(path);
+  if (fd < 0) {
+    std::printf("failed to create a temporary file\n");
+    return;
+  }
+  ::close(fd);
+  auto status = 0;
+  benchmark::Measure("temporary file", kif.size(), 0, [&]() {
+    const auto nodes = sp::ParseKIF(kif);
+    std::ofstream(path) << sp::ToProlog(nodes, true);
+    status = std::system(ReplacePath(file_command, path).c_str());
+  });
+  if (status != 0) {
+    std::printf("command failed: %s\n", file_command.c_str());
+  }
+  benchmark::Measure("pipe", kif.size(), 0, [&]() {
+    const auto nodes = sp::ParseKIF(kif);
+    sp::PrologPipe pipe(stdin_command);
+    pipe.Consult(nodes, true);
+    status = pipe.Close();
+  });
+  if (status != 0) {
+    std::printf("command failed: %s\n", stdin_command.c_str());
+  }
+  std::remove(path);
+}
@@ -0,0 +1,33 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "clause_profiler.hpp"
+#include "gdl_generator.hpp"
+#include "reachability.hpp"
+
+namespace sp = sexpr_parser;
+
+// Relaxed reachability of generated games, followed by the clauses that
+// took the most time.
+// Args: [board_size] [num_predicates]
+BENCHMARK(Reachability) {
+  sp::GameGeneratorOptions options;
+  options.board_size = args.size() >= 1 ? std::atoi(args[0].c_str()) : 30;
+  options.num_predicates = args.size() >= 2 ? std::atoi(args[1].c_str()) : 200;
+  const auto kif = sp::GenerateGame(options);
+  const auto clauses = sp::ParseKIF(kif);
+  sp::Reachability reachability;
+  benchmark::Measure("without profiler", kif.size(), 0, [&]() {
+    sp::AnalyzeReachability(clauses, reachability);
+  });
+  sp::ClauseProfiler profiler(clauses, sp::LocateKIFForms(kif));
+  benchmark::Measure("with profiler", kif.size(), 0, [&]() {
+    sp::AnalyzeReachability(clauses, reachability, SIZE_MAX, &profiler);
+  });
+  std::printf("  %zu iterations, %zu facts, %zu bases, %zu inputs\n",
+      reachability.iterations, reachability.fact_count, reachability.bases.size(), reachability.inputs.size());
+  profiler.WriteReport(std::cout, 5);
+}
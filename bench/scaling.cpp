@@ -0,0 +1,110 @@
+#include "scaling.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "memory_usage.hpp"
+
+namespace benchmark {
+
+namespace {
+
+std::map<std::string, ScalingTarget*>& GetScalingTargets() {
+  static std::map<std::string, ScalingTarget*> targets;
+  return targets;
+}
+
+// 1, 2, 4, ... and max_threads itself
+std::vector<std::size_t> GetThreadCounts(const std::size_t max_threads) {
+  std::vector<std::size_t> counts;
+  for (std::size_t i = 1; i < max_threads; i *= 2) {
+    counts.push_back(i);
+  }
+  counts.push_back(max_threads);
+  return counts;
+}
+
+std::string EscapeJSON(const std::string& value) {
+  std::string escaped;
+  for (const auto c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+}
+
+bool RegisterScalingTarget(const std::string& name, ScalingTarget* target) {
+  return GetScalingTargets().emplace(name, target).second;
+}
+
+}
+
+// Sweeps every scaling target over thread counts from 1 to the number of
+// cores and input sizes from 1000 up to max_size in factors of 10, and
+// prints one JSON document. Seconds are the best of the repeats, peak RSS
+// is the largest high-water mark over them. Speedup and efficiency are
+// relative to one thread at the same size.
+// Args: [max_size] [max_threads] [repeats] [target]
+BENCHMARK(ThreadScaling) {
+  const std::size_t max_size = args.size() >= 1 ? std::atol(args[0].c_str()) : 100000;
+  const std::size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t max_threads = args.size() >= 2 ? std::atol(args[1].c_str()) : hardware_threads;
+  const auto repeats = args.size() >= 3 ? std::max(1, std::atoi(args[2].c_str())) : 3;
+  const auto only_target = args.size() >= 4 ? args[3] : std::string();
+  const auto peak_reset = benchmark::ResetPeakResidentSetSize();
+  std::printf("{\n");
+  std::printf("  \"hardware_concurrency\": %zu,\n", hardware_threads);
+  std::printf("  \"repeats\": %d,\n", repeats);
+  std::printf("  \"peak_rss_per_run\": %s,\n", peak_reset ? "true" : "false");
+  std::printf("  \"results\": [");
+  auto first = true;
+  for (const auto& name_and_target : benchmark::GetScalingTargets()) {
+    if (!only_target.empty() && name_and_target.first != only_target) {
+      continue;
+    }
+    const auto target = name_and_target.second;
+    for (std::size_t size = 1000; size <= max_size; size *= 10) {
+      const auto bytes = target->Prepare(size);
+      auto single_thread_seconds = 0.0;
+      for (const auto num_threads : benchmark::GetThreadCounts(max_threads)) {
+        auto best_seconds = 0.0;
+        std::size_t peak_rss = 0;
+        std::size_t base_rss = 0;
+        for (auto i = 0; i < repeats; ++i) {
+          benchmark::TrimHeap();
+          benchmark::ResetPeakResidentSetSize();
+          base_rss = std::max(base_rss, benchmark::GetResidentSetSize());
+          benchmark::Timer timer;
+          target->Run(num_threads);
+          const auto seconds = timer.GetElapsedSeconds();
+          peak_rss = std::max(peak_rss, benchmark::GetPeakResidentSetSize());
+          best_seconds = (i == 0) ? seconds : std::min(best_seconds, seconds);
+        }
+        if (num_threads == 1) {
+          single_thread_seconds = best_seconds;
+        }
+        const auto speedup = single_thread_seconds / best_seconds;
+        std::printf("%s\n    {\"target\": \"%s\", \"size\": %zu, \"bytes\": %zu, \"threads\": %zu, "
+            "\"seconds\": %.6f, \"speedup\": %.3f, \"efficiency\": %.3f, "
+            "\"base_rss_bytes\": %zu, \"peak_rss_bytes\": %zu}",
+            first ? "" : ",",
+            benchmark::EscapeJSON(name_and_target.first).c_str(), size, bytes, num_threads,
+            best_seconds, speedup, speedup / num_threads,
+            base_rss, peak_rss);
+        std::fflush(stdout);
+        first = false;
+      }
+      target->Clear();
+    }
+  }
+  std::printf("\n  ]\n}\n");
+}
@@ -0,0 +1,31 @@
+#ifndef SCALING_HPP_
+#define SCALING_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace benchmark {
+
+// A parallel entry point measured by the ThreadScaling benchmark.
+// Prepare() builds an input of the given size in the target's own unit
+// (facts, files, playouts, ...) and returns its size in bytes. Run()
+// processes the prepared input once with the given number of threads.
+class ScalingTarget {
+public:
+  virtual ~ScalingTarget() {}
+  virtual std::size_t Prepare(const std::size_t size) = 0;
+  virtual void Run(const std::size_t num_threads) = 0;
+  // Releases the input before the next size is prepared
+  virtual void Clear() = 0;
+};
+
+// The target must have static storage duration
+bool RegisterScalingTarget(const std::string& name, ScalingTarget* target);
+
+#define SCALING_TARGET(name, type) \
+  static type name##_target; \
+  static const bool name##_target_registered = ::benchmark::RegisterScalingTarget(#name, &name##_target)
+
+}
+
+#endif /* SCALING_HPP_ */
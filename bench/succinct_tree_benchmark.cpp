@@ -0,0 +1,67 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "flat_document.hpp"
+#include "gdl_generator.hpp"
+#include "memory_usage.hpp"
+#include "succinct_tree.hpp"
+
+namespace sp = sexpr_parser;
+
+// Memory of a parsed game as TreeNode, FlatDocument and SuccinctTree, and
+// the cost of navigating the succinct encoding.
+// Memory of TreeNode and FlatDocument is the growth of the resident set
+// while building them, so it includes allocator overhead.
+// Args: [num_predicates]
+BENCHMARK(SuccinctTree) {
+  sp::GameGeneratorOptions options;
+  options.num_predicates = args.size() >= 1 ? std::atoi(args[0].c_str()) : 200000;
+  options.max_arity = 4;
+  options.rule_width = 5;
+  const auto kif = sp::GenerateGame(options);
+  benchmark::TrimHeap();
+  auto resident = benchmark::GetResidentSetSize();
+  std::unique_ptr<std::vector<sp::TreeNode>> nodes(new std::vector<sp::TreeNode>(sp::ParseKIF(kif)));
+  const auto tree_node_bytes = benchmark::GetResidentSetSize() - resident;
+  resident = benchmark::GetResidentSetSize();
+  std::unique_ptr<sp::FlatDocument> document(new sp::FlatDocument(*nodes));
+  const auto flat_document_bytes = benchmark::GetResidentSetSize() - resident;
+  const auto num_nodes = document->GetNodeCount();
+  document.reset();
+  std::unique_ptr<sp::SuccinctTree> tree;
+  benchmark::Measure("build", kif.size(), num_nodes, [&]() {
+    tree.reset(new sp::SuccinctTree(*nodes));
+  });
+  std::size_t checksum = 0;
+  benchmark::Measure("visit by pre-order number", kif.size(), num_nodes, [&]() {
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+      const auto node = tree->GetNode(i);
+      checksum += tree->IsLeaf(node) ? tree->GetSymbolId(node) : tree->GetDepth(node);
+    }
+  });
+  benchmark::Measure("parent and subtree size", kif.size(), num_nodes, [&]() {
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+      const auto node = tree->GetNode(i);
+      const auto parent = tree->GetParent(node);
+      checksum += parent != sp::kNoSuccinctNode ? tree->GetSubtreeSize(parent) : 0;
+    }
+  });
+  benchmark::Measure("ToTreeNodes", kif.size(), num_nodes, [&]() {
+    checksum += tree->ToTreeNodes().size();
+  });
+  std::ostringstream archive;
+  tree->Write(archive);
+  const auto bits_per_node = [num_nodes](const std::size_t bytes) {
+    return bytes * 8.0 / num_nodes;
+  };
+  std::printf("  %zu nodes, %zu symbols, checksum %zu\n", num_nodes, tree->GetSymbolCount(), checksum);
+  std::printf("  TreeNode: %zu bytes (%.1f bits/node)\n", tree_node_bytes, bits_per_node(tree_node_bytes));
+  std::printf("  FlatDocument: %zu bytes (%.1f bits/node)\n", flat_document_bytes, bits_per_node(flat_document_bytes));
+  std::printf("  SuccinctTree: %zu bytes (%.1f bits/node)\n", tree->GetMemoryUsage(), bits_per_node(tree->GetMemoryUsage()));
+  std::printf("  archive: %zu bytes (%.1f bits/node)\n", archive.str().size(), bits_per_node(archive.str().size()));
+}
@@ -0,0 +1,104 @@
+#include "benchmark.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "flat_document.hpp"
+#include "gdl_generator.hpp"
+#include "scaling.hpp"
+#include "symbol_table.hpp"
+#include "tree_cursor.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+// Runs work(thread_index) on num_threads threads
+template <class Function>
+void RunThreads(const std::size_t num_threads, Function work) {
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(work, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Leaf values of a generated game, in document order, as a parser or a
+// document builder would intern them
+class InterningTarget : public benchmark::ScalingTarget {
+public:
+  std::size_t Prepare(const std::size_t size) override {
+    sp::GameGeneratorOptions options;
+    options.num_predicates = size;
+    options.board_size = 30;
+    const auto kif = sp::GenerateGame(options);
+    forms_ = sp::ParseKIF(kif);
+    for (sp::TreeCursor cursor(forms_, sp::TraversalOrder::kLeavesOnly); cursor.IsValid(); cursor.Next()) {
+      symbols_.push_back(cursor.GetNode()->GetValue());
+    }
+    return kif.size();
+  }
+  void Clear() override {
+    std::vector<sp::TreeNode>().swap(forms_);
+    std::vector<std::string>().swap(symbols_);
+  }
+protected:
+  // Each thread takes every num_threads-th symbol
+  template <class Function>
+  void ForEachSymbol(const std::size_t num_threads, Function intern) {
+    RunThreads(num_threads, [&](const std::size_t thread_index) {
+      for (auto i = thread_index; i < symbols_.size(); i += num_threads) {
+        intern(symbols_[i]);
+      }
+    });
+  }
+  std::vector<sp::TreeNode> forms_;
+  std::vector<std::string> symbols_;
+};
+
+class SymbolTableTarget : public InterningTarget {
+public:
+  void Run(const std::size_t num_threads) override {
+    sp::SymbolTable table;
+    ForEachSymbol(num_threads, [&](const std::string& symbol) {
+      table.Intern(symbol);
+    });
+  }
+};
+
+// Baseline: one table behind one lock
+class MutexSymbolTableTarget : public InterningTarget {
+public:
+  void Run(const std::size_t num_threads) override {
+    std::mutex mutex;
+    std::unordered_map<std::string, sp::SymbolId> table;
+    ForEachSymbol(num_threads, [&](const std::string& symbol) {
+      std::lock_guard<std::mutex> lock(mutex);
+      table.emplace(symbol, static_cast<sp::SymbolId>(table.size()));
+    });
+  }
+};
+
+// Documents built in parallel, one per form, with comparable symbol ids
+class SharedFlatDocumentsTarget : public InterningTarget {
+public:
+  void Run(const std::size_t num_threads) override {
+    sp::SymbolTable table;
+    RunThreads(num_threads, [&](const std::size_t thread_index) {
+      for (auto i = thread_index; i < forms_.size(); i += num_threads) {
+        sp::FlatDocument(std::vector<sp::TreeNode>(1, forms_[i]), table);
+      }
+    });
+  }
+};
+
+SCALING_TARGET(SymbolTable, SymbolTableTarget);
+SCALING_TARGET(MutexSymbolTable, MutexSymbolTableTarget);
+SCALING_TARGET(SharedFlatDocuments, SharedFlatDocumentsTarget);
+
+}
@@ -0,0 +1,24 @@
+# Builds the sexpr_parser extension module against the sources in ../src
+#   python3 setup.py build_ext --inplace
+from setuptools import Extension, setup
+
+setup(
+    name='sexpr_parser',
+    ext_modules=[
+        Extension(
+            'sexpr_parser',
+            sources=[
+                'sexpr_parser_module.cpp',
+                '../src/sexpr_parser.cpp',
+                '../src/flat_document.cpp',
+                '../src/parse_limits.cpp',
+                '../src/arena.cpp',
+                '../src/symbol_table.cpp',
+            ],
+            include_dirs=['../src'],
+            libraries=['boost_regex'],
+            extra_compile_args=['-std=c++0x'],
+            language='c++',
+        ),
+    ],
+)
@@ -0,0 +1,393 @@
+// CPython extension exposing FlatDocument.
+// Nodes are returned as small proxies created on access, and the per-node
+// arrays are exported through the buffer protocol without copying, so that
+// e.g. numpy.asarray(document.symbol_ids()) costs no Python objects per node.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <new>
+#include <string>
+
+#include "flat_document.hpp"
+
+namespace sp = sexpr_parser;
+
+namespace {
+
+struct DocumentObject {
+  PyObject_HEAD
+  sp::FlatDocument* document;
+};
+
+struct NodeObject {
+  PyObject_HEAD
+  DocumentObject* owner;
+  sp::NodeIndex index;
+};
+
+// Read-only one-dimensional uint32 array borrowed from a document
+struct ArrayObject {
+  PyObject_HEAD
+  DocumentObject* owner;
+  const char* data;
+  Py_ssize_t shape;
+  Py_ssize_t stride;
+};
+
+extern PyTypeObject DocumentType;
+extern PyTypeObject NodeType;
+extern PyTypeObject ArrayType;
+
+PyObject* NewNode(DocumentObject* owner, const sp::NodeIndex index) {
+  auto node = PyObject_New(NodeObject, &NodeType);
+  if (!node) {
+    return nullptr;
+  }
+  Py_INCREF(owner);
+  node->owner = owner;
+  node->index = index;
+  return reinterpret_cast<PyObject*>(node);
+}
+
+PyObject* NewArray(DocumentObject* owner, const void* data, const std::size_t shape, const std::size_t stride) {
+  // Zero-length buffers still need a valid address
+  static const std::uint32_t empty = 0;
+  auto array = PyObject_New(ArrayObject, &ArrayType);
+  if (!array) {
+    return nullptr;
+  }
+  Py_INCREF(owner);
+  array->owner = owner;
+  array->data = shape ? static_cast<const char*>(data) : reinterpret_cast<const char*>(&empty);
+  array->shape = static_cast<Py_ssize_t>(shape);
+  array->stride = static_cast<Py_ssize_t>(stride);
+  return reinterpret_cast<PyObject*>(array);
+}
+
+PyObject* NewSymbolString(const sp::FlatDocument& document, const sp::SymbolId symbol) {
+  return PyUnicode_DecodeUTF8(document.GetSymbol(symbol), document.GetSymbolLength(symbol), "surrogateescape");
+}
+
+// Document
+
+void Document_dealloc(DocumentObject* self) {
+  delete self->document;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+Py_ssize_t Document_length(DocumentObject* self) {
+  return self->document->GetRootCount();
+}
+
+PyObject* Document_item(DocumentObject* self, Py_ssize_t index) {
+  if (index < 0 || static_cast<std::size_t>(index) >= self->document->GetRootCount()) {
+    PyErr_SetString(PyExc_IndexError, "root index out of range");
+    return nullptr;
+  }
+  return NewNode(self, self->document->GetRoot(index));
+}
+
+PyObject* Document_node(DocumentObject* self, PyObject* arg) {
+  const auto index = PyLong_AsSsize_t(arg);
+  if (index == -1 && PyErr_Occurred()) {
+    return nullptr;
+  }
+  if (index < 0 || static_cast<std::size_t>(index) >= self->document->GetNodeCount()) {
+    PyErr_SetString(PyExc_IndexError, "node index out of range");
+    return nullptr;
+  }
+  return NewNode(self, static_cast<sp::NodeIndex>(index));
+}
+
+PyObject* Document_symbol(DocumentObject* self, PyObject* arg) {
+  const auto symbol = PyLong_AsSsize_t(arg);
+  if (symbol == -1 && PyErr_Occurred()) {
+    return nullptr;
+  }
+  if (symbol < 0 || static_cast<std::size_t>(symbol) >= self->document->GetSymbolCount()) {
+    PyErr_SetString(PyExc_IndexError, "symbol id out of range");
+    return nullptr;
+  }
+  return NewSymbolString(*self->document, static_cast<sp::SymbolId>(symbol));
+}
+
+PyObject* Document_symbol_ids(DocumentObject* self, PyObject*) {
+  const auto& nodes = self->document->GetNodes();
+  return NewArray(self, nodes.empty() ? nullptr : &nodes.front().symbol, nodes.size(), sizeof(sp::FlatNode));
+}
+
+PyObject* Document_child_offsets(DocumentObject* self, PyObject*) {
+  const auto& nodes = self->document->GetNodes();
+  return NewArray(self, nodes.empty() ? nullptr : &nodes.front().child_offset, nodes.size(), sizeof(sp::FlatNode));
+}
+
+PyObject* Document_child_counts(DocumentObject* self, PyObject*) {
+  const auto& nodes = self->document->GetNodes();
+  return NewArray(self, nodes.empty() ? nullptr : &nodes.front().child_count, nodes.size(), sizeof(sp::FlatNode));
+}
+
+PyObject* Document_child_indices(DocumentObject* self, PyObject*) {
+  const auto& child_indices = self->document->GetChildIndices();
+  return NewArray(self, child_indices.data(), child_indices.size(), sizeof(sp::NodeIndex));
+}
+
+PyObject* Document_get_node_count(DocumentObject* self, void*) {
+  return PyLong_FromSize_t(self->document->GetNodeCount());
+}
+
+PyObject* Document_get_symbol_count(DocumentObject* self, void*) {
+  return PyLong_FromSize_t(self->document->GetSymbolCount());
+}
+
+PySequenceMethods Document_as_sequence = {
+  reinterpret_cast<lenfunc>(Document_length),
+  nullptr,
+  nullptr,
+  reinterpret_cast<ssizeargfunc>(Document_item),
+};
+
+PyMethodDef Document_methods[] = {
+  {"node", reinterpret_cast<PyCFunction>(Document_node), METH_O, "Node proxy by pre-order index."},
+  {"symbol", reinterpret_cast<PyCFunction>(Document_symbol), METH_O, "Symbol string by id."},
+  {"symbol_ids", reinterpret_cast<PyCFunction>(Document_symbol_ids), METH_NOARGS, "Symbol id of each node as a uint32 buffer, 0xffffffff for lists."},
+  {"child_offsets", reinterpret_cast<PyCFunction>(Document_child_offsets), METH_NOARGS, "Offset of each node's children in child_indices() as a uint32 buffer."},
+  {"child_counts", reinterpret_cast<PyCFunction>(Document_child_counts), METH_NOARGS, "Number of children of each node as a uint32 buffer."},
+  {"child_indices", reinterpret_cast<PyCFunction>(Document_child_indices), METH_NOARGS, "Node indices of children as a uint32 buffer."},
+  {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef Document_getset[] = {
+  {const_cast<char*>("node_count"), reinterpret_cast<getter>(Document_get_node_count), nullptr, nullptr, nullptr},
+  {const_cast<char*>("symbol_count"), reinterpret_cast<getter>(Document_get_symbol_count), nullptr, nullptr, nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+// Node
+
+void Node_dealloc(NodeObject* self) {
+  Py_DECREF(self->owner);
+  PyObject_Free(self);
+}
+
+Py_ssize_t Node_length(NodeObject* self) {
+  return self->owner->document->GetChildCount(self->index);
+}
+
+PyObject* Node_item(NodeObject* self, Py_ssize_t index) {
+  const auto& document = *self->owner->document;
+  if (index < 0 || static_cast<std::size_t>(index) >= document.GetChildCount(self->index)) {
+    PyErr_SetString(PyExc_IndexError, "child index out of range");
+    return nullptr;
+  }
+  return NewNode(self->owner, document.GetChild(self->index, index));
+}
+
+PyObject* Node_get_index(NodeObject* self, void*) {
+  return PyLong_FromUnsignedLong(self->index);
+}
+
+PyObject* Node_get_is_leaf(NodeObject* self, void*) {
+  return PyBool_FromLong(self->owner->document->IsLeaf(self->index));
+}
+
+PyObject* Node_get_symbol(NodeObject* self, void*) {
+  const auto symbol = self->owner->document->GetNode(self->index).symbol;
+  if (symbol == sp::kNoSymbol) {
+    Py_RETURN_NONE;
+  }
+  return PyLong_FromUnsignedLong(symbol);
+}
+
+PyObject* Node_get_value(NodeObject* self, void*) {
+  const auto symbol = self->owner->document->GetNode(self->index).symbol;
+  if (symbol == sp::kNoSymbol) {
+    Py_RETURN_NONE;
+  }
+  return NewSymbolString(*self->owner->document, symbol);
+}
+
+PyObject* Node_to_sexpr(NodeObject* self, PyObject*) {
+  try {
+    const auto sexpr = self->owner->document->ToTreeNode(self->index).ToSexpr();
+    return PyUnicode_DecodeUTF8(sexpr.data(), sexpr.size(), "surrogateescape");
+  } catch (const std::bad_alloc&) {
+    return PyErr_NoMemory();
+  }
+}
+
+PyObject* Node_repr(NodeObject* self) {
+  const auto& document = *self->owner->document;
+  const auto symbol = document.GetNode(self->index).symbol;
+  if (symbol == sp::kNoSymbol) {
+    return PyUnicode_FromFormat("<Node %u list[%zu]>", self->index, document.GetChildCount(self->index));
+  }
+  return PyUnicode_FromFormat("<Node %u leaf %s>", self->index, document.GetSymbol(symbol));
+}
+
+PySequenceMethods Node_as_sequence = {
+  reinterpret_cast<lenfunc>(Node_length),
+  nullptr,
+  nullptr,
+  reinterpret_cast<ssizeargfunc>(Node_item),
+};
+
+PyMethodDef Node_methods[] = {
+  {"to_sexpr", reinterpret_cast<PyCFunction>(Node_to_sexpr), METH_NOARGS, "S-expression of the subtree."},
+  {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef Node_getset[] = {
+  {const_cast<char*>("index"), reinterpret_cast<getter>(Node_get_index), nullptr, nullptr, nullptr},
+  {const_cast<char*>("is_leaf"), reinterpret_cast<getter>(Node_get_is_leaf), nullptr, nullptr, nullptr},
+  {const_cast<char*>("symbol"), reinterpret_cast<getter>(Node_get_symbol), nullptr, nullptr, nullptr},
+  {const_cast<char*>("value"), reinterpret_cast<getter>(Node_get_value), nullptr, nullptr, nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+// Array
+
+void Array_dealloc(ArrayObject* self) {
+  Py_DECREF(self->owner);
+  PyObject_Free(self);
+}
+
+Py_ssize_t Array_length(ArrayObject* self) {
+  return self->shape;
+}
+
+PyObject* Array_item(ArrayObject* self, Py_ssize_t index) {
+  if (index < 0 || index >= self->shape) {
+    PyErr_SetString(PyExc_IndexError, "array index out of range");
+    return nullptr;
+  }
+  return PyLong_FromUnsignedLong(*reinterpret_cast<const std::uint32_t*>(self->data + index * self->stride));
+}
+
+int Array_getbuffer(ArrayObject* self, Py_buffer* view, int flags) {
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "array is read-only");
+    return -1;
+  }
+  // Contiguity requests include PyBUF_STRIDES, so they are checked as well
+  const auto requests_contiguous = (flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS ||
+      (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS ||
+      (flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS;
+  if ((!(flags & PyBUF_STRIDES) || requests_contiguous) && self->stride != sizeof(std::uint32_t)) {
+    PyErr_SetString(PyExc_BufferError, "array is not contiguous");
+    return -1;
+  }
+  Py_INCREF(self);
+  view->obj = reinterpret_cast<PyObject*>(self);
+  view->buf = const_cast<char*>(self->data);
+  view->len = self->shape * sizeof(std::uint32_t);
+  view->readonly = 1;
+  view->itemsize = sizeof(std::uint32_t);
+  view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("I") : nullptr;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &self->shape : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) ? &self->stride : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
+}
+
+PySequenceMethods Array_as_sequence = {
+  reinterpret_cast<lenfunc>(Array_length),
+  nullptr,
+  nullptr,
+  reinterpret_cast<ssizeargfunc>(Array_item),
+};
+
+PyBufferProcs Array_as_buffer = {
+  reinterpret_cast<getbufferproc>(Array_getbuffer),
+  nullptr,
+};
+
+PyTypeObject DocumentType = {PyVarObject_HEAD_INIT(nullptr, 0) "sexpr_parser.Document"};
+PyTypeObject NodeType = {PyVarObject_HEAD_INIT(nullptr, 0) "sexpr_parser.Node"};
+PyTypeObject ArrayType = {PyVarObject_HEAD_INIT(nullptr, 0) "sexpr_parser.Array"};
+
+// Module
+
+PyObject* ParseDocument(PyObject* args, const bool flatten_tuple_with_one_child) {
+  const char* buffer;
+  Py_ssize_t length;
+  if (!PyArg_ParseTuple(args, "s#", &buffer, &length)) {
+    return nullptr;
+  }
+  sp::FlatDocument* document = nullptr;
+  auto is_out_of_memory = false;
+  // No exception may leave the block, which restores the thread state, so
+  // the error is raised after it with the GIL held
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    const std::string sexpr(buffer, length);
+    document = new sp::FlatDocument(sp::Parse(sexpr, flatten_tuple_with_one_child));
+  } catch (const std::bad_alloc&) {
+    is_out_of_memory = true;
+  }
+  Py_END_ALLOW_THREADS
+  if (is_out_of_memory) {
+    return PyErr_NoMemory();
+  }
+  auto result = PyObject_New(DocumentObject, &DocumentType);
+  if (!result) {
+    delete document;
+    return nullptr;
+  }
+  result->document = document;
+  return reinterpret_cast<PyObject*>(result);
+}
+
+PyObject* Module_parse(PyObject*, PyObject* args) {
+  return ParseDocument(args, false);
+}
+
+PyObject* Module_parse_kif(PyObject*, PyObject* args) {
+  return ParseDocument(args, true);
+}
+
+PyMethodDef Module_methods[] = {
+  {"parse", Module_parse, METH_VARARGS, "Parse S-expressions into a Document."},
+  {"parse_kif", Module_parse_kif, METH_VARARGS, "Parse KIF into a Document, flattening tuples with one child."},
+  {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef Module_definition = {
+  PyModuleDef_HEAD_INIT,
+  "sexpr_parser",
+  "S-expression parser for General Game Playing.",
+  -1,
+  Module_methods,
+};
+
+}
+
+PyMODINIT_FUNC PyInit_sexpr_parser() {
+  DocumentType.tp_basicsize = sizeof(DocumentObject);
+  DocumentType.tp_dealloc = reinterpret_cast<destructor>(Document_dealloc);
+  DocumentType.tp_flags = Py_TPFLAGS_DEFAULT;
+  DocumentType.tp_doc = "Parsed S-expressions. Iterating yields root nodes.";
+  DocumentType.tp_as_sequence = &Document_as_sequence;
+  DocumentType.tp_methods = Document_methods;
+  DocumentType.tp_getset = Document_getset;
+  NodeType.tp_basicsize = sizeof(NodeObject);
+  NodeType.tp_dealloc = reinterpret_cast<destructor>(Node_dealloc);
+  NodeType.tp_flags = Py_TPFLAGS_DEFAULT;
+  NodeType.tp_doc = "Proxy of a node in a Document. Iterating yields child nodes.";
+  NodeType.tp_repr = reinterpret_cast<reprfunc>(Node_repr);
+  NodeType.tp_as_sequence = &Node_as_sequence;
+  NodeType.tp_methods = Node_methods;
+  NodeType.tp_getset = Node_getset;
+  ArrayType.tp_basicsize = sizeof(ArrayObject);
+  ArrayType.tp_dealloc = reinterpret_cast<destructor>(Array_dealloc);
+  ArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ArrayType.tp_doc = "Read-only uint32 array supporting the buffer protocol.";
+  ArrayType.tp_as_sequence = &Array_as_sequence;
+  ArrayType.tp_as_buffer = &Array_as_buffer;
+  if (PyType_Ready(&DocumentType) < 0 || PyType_Ready(&NodeType) < 0 || PyType_Ready(&ArrayType) < 0) {
+    return nullptr;
+  }
+  return PyModule_Create(&Module_definition);
+}
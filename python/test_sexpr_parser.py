@@ -0,0 +1,162 @@
+# Tests of the extension module built in place by "make python"
+#   cd python && python3 -m unittest -v test_sexpr_parser
+import ctypes
+import gc
+import unittest
+
+import sexpr_parser
+
+PyBUF_SIMPLE = 0
+PyBUF_WRITABLE = 0x0001
+PyBUF_FORMAT = 0x0004
+PyBUF_ND = 0x0008
+PyBUF_STRIDES = 0x0010 | PyBUF_ND
+PyBUF_C_CONTIGUOUS = 0x0020 | PyBUF_STRIDES
+PyBUF_F_CONTIGUOUS = 0x0040 | PyBUF_STRIDES
+PyBUF_ANY_CONTIGUOUS = 0x0080 | PyBUF_STRIDES
+
+
+class Py_buffer(ctypes.Structure):
+    _fields_ = [
+        ('buf', ctypes.c_void_p),
+        ('obj', ctypes.py_object),
+        ('len', ctypes.c_ssize_t),
+        ('itemsize', ctypes.c_ssize_t),
+        ('readonly', ctypes.c_int),
+        ('ndim', ctypes.c_int),
+        ('format', ctypes.c_char_p),
+        ('shape', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('strides', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('suboffsets', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('internal', ctypes.c_void_p),
+    ]
+
+
+ctypes.pythonapi.PyObject_GetBuffer.argtypes = [ctypes.py_object, ctypes.POINTER(Py_buffer), ctypes.c_int]
+ctypes.pythonapi.PyBuffer_Release.argtypes = [ctypes.POINTER(Py_buffer)]
+
+
+def get_buffer(obj, flags):
+    """Requests a buffer with exactly the given flags, returning its strides"""
+    view = Py_buffer()
+    ctypes.pythonapi.PyObject_GetBuffer(obj, ctypes.byref(view), flags)
+    try:
+        return view.strides[0] if view.strides else None
+    finally:
+        ctypes.pythonapi.PyBuffer_Release(ctypes.byref(view))
+
+
+class ParseTest(unittest.TestCase):
+    def test_parse(self):
+        document = sexpr_parser.parse('(role player) fact1 (fact2 1) (<= rule1 fact1) ()')
+        self.assertEqual(len(document), 5)
+        self.assertEqual(document.node_count, 12)
+        self.assertEqual(document.symbol_count, 7)
+        self.assertEqual([root.to_sexpr() for root in document], ['(role player)', 'fact1', '(fact2 1)', '(<= rule1 fact1)', '()'])
+
+    def test_parse_kif(self):
+        document = sexpr_parser.parse_kif('(<= (legal ?r noop) (role ?r)) ((init))')
+        self.assertEqual(document[1].to_sexpr(), 'init')
+        self.assertEqual(sexpr_parser.parse('((init))')[0].to_sexpr(), '((init))')
+
+    def test_reserved_words(self):
+        self.assertEqual(sexpr_parser.parse('(ROLE Player)')[0].to_sexpr(), '(role Player)')
+
+    def test_non_ascii(self):
+        self.assertEqual(sexpr_parser.parse('(f é)')[0][1].value, 'é')
+
+    def test_deep_nesting(self):
+        depth = 200000
+        document = sexpr_parser.parse('(f ' * depth + 'a' + ')' * depth)
+        self.assertEqual(document.node_count, 2 * depth + 1)
+        node = document[0]
+        for _ in range(depth):
+            self.assertEqual(len(node), 2)
+            node = node[1]
+        self.assertEqual(node.value, 'a')
+        self.assertEqual(list(memoryview(document.child_counts())).count(2), depth)
+
+
+class NodeTest(unittest.TestCase):
+    def test_proxies(self):
+        document = sexpr_parser.parse('(<= rule1 fact1) ()')
+        rule = document[0]
+        self.assertFalse(rule.is_leaf)
+        self.assertIsNone(rule.value)
+        self.assertIsNone(rule.symbol)
+        self.assertEqual(len(rule), 3)
+        fact1 = rule[2]
+        self.assertTrue(fact1.is_leaf)
+        self.assertEqual(fact1.value, 'fact1')
+        self.assertEqual(document.symbol(fact1.symbol), 'fact1')
+        self.assertEqual(fact1.index, 3)
+        self.assertEqual(document.node(3).value, 'fact1')
+        self.assertEqual([child.value for child in rule], ['<=', 'rule1', 'fact1'])
+        self.assertEqual(len(document[1]), 0)
+        self.assertEqual(repr(fact1), '<Node 3 leaf fact1>')
+        self.assertEqual(repr(rule), '<Node 0 list[3]>')
+
+    def test_proxies_keep_document(self):
+        node = sexpr_parser.parse('(cell 1 1 b)')[0][3]
+        gc.collect()
+        self.assertEqual(node.value, 'b')
+
+    def test_index_errors(self):
+        document = sexpr_parser.parse('(a b)')
+        with self.assertRaises(IndexError):
+            document[1]
+        with self.assertRaises(IndexError):
+            document[0][2]
+        with self.assertRaises(IndexError):
+            document.node(3)
+        with self.assertRaises(IndexError):
+            document.node(-1)
+        with self.assertRaises(IndexError):
+            document.symbol(2)
+        with self.assertRaises(TypeError):
+            document.node('0')
+
+
+class ArrayTest(unittest.TestCase):
+    def setUp(self):
+        self.document = sexpr_parser.parse('(role player) fact1 (fact2 1)')
+
+    def test_arrays(self):
+        self.assertEqual(list(self.document.symbol_ids()), [0xffffffff, 0, 1, 2, 0xffffffff, 3, 4])
+        self.assertEqual(list(self.document.child_counts()), [2, 0, 0, 0, 2, 0, 0])
+        self.assertEqual(list(self.document.child_offsets()), [0, 0, 0, 0, 2, 0, 0])
+        self.assertEqual(list(self.document.child_indices()), [1, 2, 5, 6])
+
+    def test_buffers(self):
+        child_counts = memoryview(self.document.child_counts())
+        self.assertTrue(child_counts.readonly)
+        self.assertEqual(child_counts.format, 'I')
+        self.assertEqual(child_counts.shape, (7,))
+        self.assertEqual(child_counts.strides, (12,))
+        self.assertEqual(child_counts.tolist(), [2, 0, 0, 0, 2, 0, 0])
+        child_indices = memoryview(self.document.child_indices())
+        self.assertTrue(child_indices.c_contiguous)
+        self.assertEqual(bytes(child_indices.cast('B'))[:4], (1).to_bytes(4, 'little'))
+        self.assertEqual(len(memoryview(sexpr_parser.parse('').symbol_ids())), 0)
+
+    def test_buffer_errors(self):
+        with self.assertRaises(BufferError):
+            get_buffer(self.document.child_indices(), PyBUF_WRITABLE)
+        with self.assertRaises(BufferError):
+            get_buffer(self.document.symbol_ids(), PyBUF_SIMPLE)
+        for flags in [PyBUF_C_CONTIGUOUS, PyBUF_F_CONTIGUOUS, PyBUF_ANY_CONTIGUOUS]:
+            with self.assertRaises(BufferError):
+                get_buffer(self.document.symbol_ids(), flags)
+            self.assertEqual(get_buffer(self.document.child_indices(), flags), 4)
+        self.assertEqual(get_buffer(self.document.symbol_ids(), PyBUF_STRIDES), 12)
+
+    def test_array_keeps_document(self):
+        symbol_ids = sexpr_parser.parse('(cell 1 1 b)').symbol_ids()
+        gc.collect()
+        self.assertEqual(list(symbol_ids), [0xffffffff, 0, 1, 1, 2])
+        with self.assertRaises(IndexError):
+            symbol_ids[5]
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,142 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sexpr_parser {
+
+namespace {
+
+const std::size_t kHugePageSize = 2 << 20;
+
+std::size_t RoundUp(const std::size_t size, const std::size_t unit) {
+  return (size + unit - 1) / unit * unit;
+}
+
+char* MapAnonymous(const std::size_t size, const int extra_flags) {
+  const auto data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+  return data == MAP_FAILED ? nullptr : static_cast<char*>(data);
+}
+
+// Maps size bytes at a 2 MB boundary, so that the kernel can back whole
+// huge pages
+char* MapHugePageAligned(const std::size_t size) {
+  const auto data = MapAnonymous(size + kHugePageSize, 0);
+  if (!data) {
+    return nullptr;
+  }
+  const auto address = reinterpret_cast<std::uintptr_t>(data);
+  const auto aligned = reinterpret_cast<char*>(RoundUp(address, kHugePageSize));
+  const auto head = static_cast<std::size_t>(aligned - data);
+  if (head > 0) {
+    ::munmap(data, head);
+  }
+  ::munmap(aligned + size, kHugePageSize - head);
+  ::madvise(aligned, size, MADV_HUGEPAGE);
+  return aligned;
+}
+
+// mbind(2) has no glibc wrapper without libnuma.
+// Pages are bound before they are touched, so they are allocated on the
+// node in the first place.
+bool BindToNumaNode(char* data, const std::size_t size, const int node) {
+  const std::size_t bits = sizeof(unsigned long) * 8;
+  std::vector<unsigned long> mask(node / bits + 1, 0);
+  mask[node / bits] |= 1UL << (node % bits);
+  return ::syscall(SYS_mbind, data, size, MPOL_BIND, mask.data(), mask.size() * bits + 1, 0) == 0;
+}
+
+}
+
+ArenaOptions::ArenaOptions() : uses_huge_pages(false), numa_node(kNoNumaNode), block_size(kHugePageSize) {
+}
+
+Arena::Arena(const ArenaOptions& options) :
+    uses_huge_pages_(options.uses_huge_pages),
+    numa_node_(options.numa_node == kLocalNumaNode ? GetCurrentNumaNode() : options.numa_node),
+    block_size_(std::max<std::size_t>(options.block_size, 1)),
+    blocks_(),
+    current_(nullptr),
+    end_(nullptr),
+    huge_tlb_bytes_(0),
+    bound_bytes_(0) {
+}
+
+Arena::~Arena() {
+  for (const auto& block : blocks_) {
+    ::munmap(block.data, block.size);
+  }
+}
+
+void Arena::AddBlock(const std::size_t min_size) {
+  const auto page_size = uses_huge_pages_ ? kHugePageSize : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  const auto size = RoundUp(std::max(block_size_, min_size), page_size);
+  char* data = nullptr;
+  if (uses_huge_pages_) {
+    // The hugetlbfs pool is often empty unless reserved by the administrator
+    data = MapAnonymous(size, MAP_HUGETLB);
+    if (data) {
+      huge_tlb_bytes_ += size;
+    } else {
+      data = MapHugePageAligned(size);
+    }
+  } else {
+    data = MapAnonymous(size, 0);
+  }
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  if (numa_node_ >= 0 && BindToNumaNode(data, size, numa_node_)) {
+    bound_bytes_ += size;
+  }
+  blocks_.push_back(Block{data, size});
+  current_ = data;
+  end_ = data + size;
+}
+
+void* Arena::Allocate(const std::size_t size, const std::size_t alignment) {
+  auto address = RoundUp(reinterpret_cast<std::uintptr_t>(current_), alignment);
+  if (!current_ || address + size > reinterpret_cast<std::uintptr_t>(end_)) {
+    // The rest of the current block is abandoned
+    AddBlock(size + alignment);
+    address = RoundUp(reinterpret_cast<std::uintptr_t>(current_), alignment);
+  }
+  current_ = reinterpret_cast<char*>(address + size);
+  return reinterpret_cast<void*>(address);
+}
+
+int Arena::GetNumaNode() const {
+  return numa_node_;
+}
+
+std::size_t Arena::GetMappedBytes() const {
+  std::size_t bytes = 0;
+  for (const auto& block : blocks_) {
+    bytes += block.size;
+  }
+  return bytes;
+}
+
+std::size_t Arena::GetHugeTLBBytes() const {
+  return huge_tlb_bytes_;
+}
+
+std::size_t Arena::GetBoundBytes() const {
+  return bound_bytes_;
+}
+
+int GetCurrentNumaNode() {
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return kNoNumaNode;
+  }
+  return static_cast<int>(node);
+}
+
+}
@@ -0,0 +1,117 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace sexpr_parser {
+
+// Binds no NUMA node, i.e. keeps the default memory policy
+const int kNoNumaNode = -1;
+// The NUMA node of the CPU the thread creating the arena runs on
+const int kLocalNumaNode = -2;
+
+struct ArenaOptions {
+  ArenaOptions();
+  // Backs blocks with 2 MB pages, from the reserved hugetlbfs pool
+  // (MAP_HUGETLB) when possible and as transparent huge pages
+  // (MADV_HUGEPAGE) otherwise
+  bool uses_huge_pages;
+  // Node that blocks are bound to with mbind(2), or one of the constants
+  // above
+  int numa_node;
+  std::size_t block_size;
+};
+
+// Bump allocator over blocks mapped with mmap(2). Memory is only released
+// when the arena is destroyed, all at once.
+// Not thread-safe; use one arena per worker so that each can be bound to
+// the worker's local node.
+class Arena {
+public:
+  explicit Arena(const ArenaOptions& options = ArenaOptions());
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  void* Allocate(const std::size_t size, const std::size_t alignment);
+  // Resolved node, or kNoNumaNode
+  int GetNumaNode() const;
+  std::size_t GetMappedBytes() const;
+  // Parts of the mapped bytes that MAP_HUGETLB and mbind(2) succeeded for
+  std::size_t GetHugeTLBBytes() const;
+  std::size_t GetBoundBytes() const;
+private:
+  struct Block {
+    char* data;
+    std::size_t size;
+  };
+  void AddBlock(const std::size_t min_size);
+  const bool uses_huge_pages_;
+  const int numa_node_;
+  const std::size_t block_size_;
+  std::vector<Block> blocks_;
+  char* current_;
+  char* end_;
+  std::size_t huge_tlb_bytes_;
+  std::size_t bound_bytes_;
+};
+
+// NUMA node of the CPU the calling thread runs on, or kNoNumaNode when it
+// cannot be determined
+int GetCurrentNumaNode();
+
+// Standard allocator over an arena, or over operator new without one.
+// Deallocation within an arena is a no-op, so containers in an arena
+// should be reserved to their final sizes.
+// Copies of containers are made on the heap, so that they do not depend on
+// the lifetime of the original's arena.
+template <class T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  template <class U>
+  struct rebind {
+    using other = ArenaAllocator<U>;
+  };
+  ArenaAllocator(Arena* arena = nullptr) : arena_(arena) {
+  }
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& another) : arena_(another.GetArena()) {
+  }
+  T* allocate(const std::size_t n) {
+    if (arena_) {
+      return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T* p, const std::size_t) {
+    if (!arena_) {
+      ::operator delete(p);
+    }
+  }
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+  Arena* GetArena() const {
+    return arena_;
+  }
+private:
+  Arena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.GetArena() == b.GetArena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.GetArena() != b.GetArena();
+}
+
+}
+
+#endif /* ARENA_HPP_ */
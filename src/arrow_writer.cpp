@@ -0,0 +1,477 @@
+#include "arrow_writer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+#include "tree_cursor.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+// Padded to 8 bytes at the start of the file
+const char kMagic[8] = {'A', 'R', 'R', 'O', 'W', '1', '\0', '\0'};
+const std::int16_t kMetadataVersionV5 = 4;
+const std::uint8_t kMessageHeaderSchema = 1;
+const std::uint8_t kMessageHeaderDictionaryBatch = 2;
+const std::uint8_t kMessageHeaderRecordBatch = 3;
+const std::uint8_t kTypeInt = 2;
+const std::uint8_t kTypeUtf8 = 5;
+const std::int64_t kSymbolDictionaryId = 0;
+
+std::size_t GetPaddedSize(const std::size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+// Scalar or offset field of a flatbuffer table
+struct TableField {
+  std::uint16_t id;
+  std::uint8_t size;
+  std::uint64_t value;
+};
+
+// Flatbuffer written front to back.
+// Tables are written before the tables, vectors and strings they refer to,
+// so that every offset points forward as required, and the offsets are
+// filled in by Link() once the targets are written.
+class FlatBufferBuilder {
+public:
+  FlatBufferBuilder() : buffer_(4, '\0') {
+  }
+  const std::string& GetBuffer() const {
+    return buffer_;
+  }
+  void SetRoot(const std::size_t table) {
+    Link(0, table);
+  }
+  // Returns the positions of the fields in field_positions, in the order
+  // of fields. Offset fields are written as 0 until linked.
+  std::size_t AddTable(const std::vector<TableField>& fields, std::vector<std::size_t>* field_positions = nullptr) {
+    // Larger fields first, so that they are aligned without padding
+    std::vector<std::size_t> order(fields.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&fields](const std::size_t a, const std::size_t b) {
+      return fields[a].size > fields[b].size;
+    });
+    std::vector<std::uint16_t> field_offsets(fields.size());
+    std::size_t table_size = 4;
+    for (const auto i : order) {
+      table_size = (table_size + fields[i].size - 1) / fields[i].size * fields[i].size;
+      field_offsets[i] = static_cast<std::uint16_t>(table_size);
+      table_size += fields[i].size;
+    }
+    std::uint16_t slot_count = 0;
+    for (const auto& field : fields) {
+      slot_count = std::max<std::uint16_t>(slot_count, field.id + 1);
+    }
+    std::vector<std::uint16_t> vtable(2 + slot_count);
+    vtable[0] = static_cast<std::uint16_t>(vtable.size() * 2);
+    vtable[1] = static_cast<std::uint16_t>(table_size);
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      vtable[2 + fields[i].id] = field_offsets[i];
+    }
+    Align(2);
+    const auto vtable_position = buffer_.size();
+    Append(vtable.data(), vtable.size() * 2);
+    // The table starts at 8 bytes, so that its fields are aligned
+    // absolutely as well
+    Align(8);
+    const auto table = buffer_.size();
+    buffer_.resize(table + table_size, '\0');
+    PutAt<std::int32_t>(table, static_cast<std::int32_t>(table - vtable_position));
+    if (field_positions) {
+      field_positions->clear();
+    }
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      // Little-endian
+      std::memcpy(&buffer_[table + field_offsets[i]], &fields[i].value, fields[i].size);
+      if (field_positions) {
+        field_positions->push_back(table + field_offsets[i]);
+      }
+    }
+    return table;
+  }
+  std::size_t AddString(const std::string& value) {
+    Align(4);
+    const auto position = buffer_.size();
+    Put<std::uint32_t>(value.size());
+    buffer_.append(value);
+    buffer_.push_back('\0');
+    return position;
+  }
+  // Elements are offsets to fill in by Link(), at GetElementPosition()
+  std::size_t AddOffsetVector(const std::size_t count) {
+    Align(4);
+    const auto position = buffer_.size();
+    Put<std::uint32_t>(count);
+    buffer_.resize(buffer_.size() + count * 4, '\0');
+    return position;
+  }
+  static std::size_t GetElementPosition(const std::size_t vector, const std::size_t index) {
+    return vector + 4 + index * 4;
+  }
+  // Vector of structs made of 64-bit words, which must be aligned to 8
+  std::size_t AddStructVector(const std::vector<std::uint64_t>& words, const std::size_t count) {
+    while ((buffer_.size() + 4) % 8 != 0) {
+      buffer_.push_back('\0');
+    }
+    const auto position = buffer_.size();
+    Put<std::uint32_t>(count);
+    Append(words.data(), words.size() * 8);
+    return position;
+  }
+  void Link(const std::size_t offset_position, const std::size_t target) {
+    assert(target > offset_position);
+    PutAt<std::uint32_t>(offset_position, target - offset_position);
+  }
+private:
+  void Align(const std::size_t alignment) {
+    while (buffer_.size() % alignment != 0) {
+      buffer_.push_back('\0');
+    }
+  }
+  void Append(const void* data, const std::size_t size) {
+    buffer_.append(static_cast<const char*>(data), size);
+  }
+  template <class T>
+  void Put(const T value) {
+    Append(&value, sizeof(value));
+  }
+  template <class T>
+  void PutAt(const std::size_t position, const T value) {
+    std::memcpy(&buffer_[position], &value, sizeof(value));
+  }
+  std::string buffer_;
+};
+
+TableField MakeField(const std::uint16_t id, const std::uint8_t size, const std::uint64_t value) {
+  return TableField{id, size, value};
+}
+
+TableField MakeOffsetField(const std::uint16_t id) {
+  return TableField{id, 4, 0};
+}
+
+std::size_t AddIntType(FlatBufferBuilder& builder, const std::int32_t bit_width) {
+  // Int { bitWidth, is_signed }
+  return builder.AddTable({MakeField(0, 4, bit_width), MakeField(1, 1, 1)});
+}
+
+struct ColumnField {
+  const char* name;
+  bool nullable;
+  std::int32_t bit_width;
+  bool is_dictionary;
+};
+
+const ColumnField kColumnFields[] = {
+  {"record_id", false, 64, false},
+  {"node_id", false, 32, false},
+  {"parent_id", true, 32, false},
+  {"depth", false, 32, false},
+  {"symbol", true, 32, true}
+};
+
+const std::size_t kColumnCount = sizeof(kColumnFields) / sizeof(kColumnFields[0]);
+
+std::size_t AddField(FlatBufferBuilder& builder, const ColumnField& column) {
+  // Field { name, nullable, type_type, type, dictionary, children }
+  std::vector<TableField> fields = {
+    MakeOffsetField(0),
+    MakeField(1, 1, column.nullable),
+    // A dictionary-encoded field has the type of its values
+    MakeField(2, 1, column.is_dictionary ? kTypeUtf8 : kTypeInt),
+    MakeOffsetField(3),
+    MakeOffsetField(5)
+  };
+  if (column.is_dictionary) {
+    fields.push_back(MakeOffsetField(4));
+  }
+  std::vector<std::size_t> positions;
+  const auto field = builder.AddTable(fields, &positions);
+  builder.Link(positions[0], builder.AddString(column.name));
+  builder.Link(positions[3], column.is_dictionary ? builder.AddTable({}) : AddIntType(builder, column.bit_width));
+  // Readers require the children even when empty
+  builder.Link(positions[4], builder.AddOffsetVector(0));
+  if (column.is_dictionary) {
+    // DictionaryEncoding { id, indexType }
+    std::vector<std::size_t> encoding_positions;
+    const auto encoding = builder.AddTable({MakeField(0, 8, kSymbolDictionaryId), MakeOffsetField(1)}, &encoding_positions);
+    builder.Link(positions[5], encoding);
+    builder.Link(encoding_positions[1], AddIntType(builder, column.bit_width));
+  }
+  return field;
+}
+
+std::size_t AddSchema(FlatBufferBuilder& builder) {
+  // Schema { endianness = Little, fields }
+  std::vector<std::size_t> positions;
+  const auto schema = builder.AddTable({MakeOffsetField(1)}, &positions);
+  const auto fields = builder.AddOffsetVector(kColumnCount);
+  builder.Link(positions[0], fields);
+  for (std::size_t i = 0; i < kColumnCount; ++i) {
+    builder.Link(FlatBufferBuilder::GetElementPosition(fields, i), AddField(builder, kColumnFields[i]));
+  }
+  return schema;
+}
+
+// FieldNode { length, null_count } and Buffer { offset, length } of a
+// record batch body
+struct BatchLayout {
+  std::size_t length;
+  std::vector<std::uint64_t> nodes;
+  std::vector<std::uint64_t> buffers;
+  std::string body;
+  void AddNode(const std::size_t null_count) {
+    nodes.push_back(length);
+    nodes.push_back(null_count);
+  }
+  void AddBuffer(const void* data, const std::size_t size) {
+    buffers.push_back(body.size());
+    buffers.push_back(size);
+    body.append(static_cast<const char*>(data), size);
+    body.resize(GetPaddedSize(body.size()), '\0');
+  }
+  // Columns without nulls can leave out the validity bitmap
+  void AddValidity(const std::vector<std::uint8_t>& validity, const std::size_t null_count) {
+    AddBuffer(validity.data(), null_count > 0 ? validity.size() : 0);
+  }
+};
+
+std::size_t AddRecordBatch(FlatBufferBuilder& builder, const BatchLayout& layout) {
+  // RecordBatch { length, nodes, buffers }
+  std::vector<std::size_t> positions;
+  const auto batch = builder.AddTable({MakeField(0, 8, layout.length), MakeOffsetField(1), MakeOffsetField(2)}, &positions);
+  builder.Link(positions[1], builder.AddStructVector(layout.nodes, layout.nodes.size() / 2));
+  builder.Link(positions[2], builder.AddStructVector(layout.buffers, layout.buffers.size() / 2));
+  return batch;
+}
+
+// Message { version, header_type, header, bodyLength } whose header is
+// added by the given function
+template <class AddHeader>
+std::string BuildMessage(const std::uint8_t header_type, const std::size_t body_length, AddHeader add_header) {
+  FlatBufferBuilder builder;
+  std::vector<std::size_t> positions;
+  const auto message = builder.AddTable({
+    MakeField(0, 2, kMetadataVersionV5),
+    MakeField(1, 1, header_type),
+    MakeOffsetField(2),
+    MakeField(3, 8, body_length)
+  }, &positions);
+  builder.SetRoot(message);
+  builder.Link(positions[2], add_header(builder));
+  return builder.GetBuffer();
+}
+
+void SetValidity(std::vector<std::uint8_t>& validity, const std::size_t row, const bool is_valid) {
+  if (row % 8 == 0) {
+    validity.push_back(0);
+  }
+  if (is_valid) {
+    validity.back() |= static_cast<std::uint8_t>(1 << (row % 8));
+  }
+}
+
+}
+
+ArrowWriter::ArrowWriter(std::ostream& o, const std::size_t batch_size) :
+    o_(o),
+    batch_size_(batch_size),
+    position_(0),
+    row_count_(0),
+    closed_(false),
+    record_ids_(),
+    node_ids_(),
+    parent_ids_(),
+    parent_validity_(),
+    parent_null_count_(0),
+    depths_(),
+    symbols_(),
+    symbol_validity_(),
+    symbol_null_count_(0),
+    symbol_ids_(),
+    symbol_offsets_(1, 0),
+    symbol_data_(),
+    record_batches_() {
+  assert(batch_size_ > 0);
+  Write(kMagic, 8);
+  const auto schema = BuildMessage(kMessageHeaderSchema, 0, [](FlatBufferBuilder& builder) {
+    return AddSchema(builder);
+  });
+  WriteMessage(schema, std::string());
+}
+
+void ArrowWriter::Write(const char* data, const std::size_t size) {
+  o_.write(data, size);
+  position_ += size;
+}
+
+ArrowWriter::Block ArrowWriter::WriteMessage(const std::string& metadata, const std::string& body) {
+  // Continuation marker and metadata size, then the metadata padded so
+  // that the body starts at 8 bytes
+  const auto padded_size = static_cast<std::int32_t>(GetPaddedSize(8 + metadata.size()) - 8);
+  const Block block = {static_cast<std::int64_t>(position_), padded_size + 8, static_cast<std::int64_t>(body.size())};
+  const std::uint32_t continuation = 0xFFFFFFFF;
+  Write(reinterpret_cast<const char*>(&continuation), 4);
+  Write(reinterpret_cast<const char*>(&padded_size), 4);
+  Write(metadata.data(), metadata.size());
+  const char padding[8] = {};
+  Write(padding, padded_size - metadata.size());
+  Write(body.data(), body.size());
+  return block;
+}
+
+void ArrowWriter::AddRow(const std::int64_t record_id, const std::int32_t node_id, const std::int32_t parent_id, const std::int32_t depth, const TreeNode& node) {
+  const auto row = record_ids_.size();
+  record_ids_.push_back(record_id);
+  node_ids_.push_back(node_id);
+  parent_ids_.push_back(parent_id >= 0 ? parent_id : 0);
+  SetValidity(parent_validity_, row, parent_id >= 0);
+  parent_null_count_ += parent_id < 0;
+  depths_.push_back(depth);
+  std::int32_t symbol = 0;
+  if (node.IsLeaf()) {
+    // Looked up first, since emplace() would copy the value every time
+    const auto found = symbol_ids_.find(node.GetValue());
+    if (found != symbol_ids_.end()) {
+      symbol = found->second;
+    } else {
+      symbol = static_cast<std::int32_t>(symbol_ids_.size());
+      symbol_ids_.emplace(node.GetValue(), symbol);
+      symbol_data_.append(node.GetValue());
+      assert(symbol_data_.size() <= INT32_MAX);
+      symbol_offsets_.push_back(static_cast<std::int32_t>(symbol_data_.size()));
+    }
+  }
+  symbols_.push_back(symbol);
+  SetValidity(symbol_validity_, row, node.IsLeaf());
+  symbol_null_count_ += !node.IsLeaf();
+  ++row_count_;
+  if (record_ids_.size() >= batch_size_) {
+    FlushBatch();
+  }
+}
+
+void ArrowWriter::WriteRecord(const std::int64_t record_id, const std::vector<TreeNode>& roots) {
+  assert(!closed_);
+  // Node ids of the ancestors of the current node
+  std::vector<std::int32_t> ancestors;
+  std::int32_t node_id = 0;
+  for (TreeCursor cursor(roots); cursor.IsValid(); cursor.Next()) {
+    const auto depth = cursor.GetDepth();
+    ancestors.resize(depth);
+    AddRow(record_id, node_id, depth > 0 ? ancestors.back() : -1, static_cast<std::int32_t>(depth), *cursor.GetNode());
+    ancestors.push_back(node_id);
+    assert(node_id < INT32_MAX);
+    ++node_id;
+  }
+}
+
+void ArrowWriter::FlushBatch() {
+  if (record_ids_.empty()) {
+    return;
+  }
+  BatchLayout layout;
+  layout.length = record_ids_.size();
+  layout.AddNode(0);
+  layout.AddBuffer(nullptr, 0);
+  layout.AddBuffer(record_ids_.data(), record_ids_.size() * sizeof(std::int64_t));
+  layout.AddNode(0);
+  layout.AddBuffer(nullptr, 0);
+  layout.AddBuffer(node_ids_.data(), node_ids_.size() * sizeof(std::int32_t));
+  layout.AddNode(parent_null_count_);
+  layout.AddValidity(parent_validity_, parent_null_count_);
+  layout.AddBuffer(parent_ids_.data(), parent_ids_.size() * sizeof(std::int32_t));
+  layout.AddNode(0);
+  layout.AddBuffer(nullptr, 0);
+  layout.AddBuffer(depths_.data(), depths_.size() * sizeof(std::int32_t));
+  layout.AddNode(symbol_null_count_);
+  layout.AddValidity(symbol_validity_, symbol_null_count_);
+  layout.AddBuffer(symbols_.data(), symbols_.size() * sizeof(std::int32_t));
+  const auto metadata = BuildMessage(kMessageHeaderRecordBatch, layout.body.size(), [&layout](FlatBufferBuilder& builder) {
+    return AddRecordBatch(builder, layout);
+  });
+  record_batches_.push_back(WriteMessage(metadata, layout.body));
+  record_ids_.clear();
+  node_ids_.clear();
+  parent_ids_.clear();
+  parent_validity_.clear();
+  parent_null_count_ = 0;
+  depths_.clear();
+  symbols_.clear();
+  symbol_validity_.clear();
+  symbol_null_count_ = 0;
+}
+
+bool ArrowWriter::Close() {
+  assert(!closed_);
+  closed_ = true;
+  FlushBatch();
+  // The whole dictionary as one utf8 column without nulls
+  BatchLayout layout;
+  layout.length = symbol_ids_.size();
+  layout.AddNode(0);
+  layout.AddBuffer(nullptr, 0);
+  layout.AddBuffer(symbol_offsets_.data(), symbol_offsets_.size() * sizeof(std::int32_t));
+  layout.AddBuffer(symbol_data_.data(), symbol_data_.size());
+  const auto metadata = BuildMessage(kMessageHeaderDictionaryBatch, layout.body.size(), [&layout](FlatBufferBuilder& builder) -> std::size_t {
+    // DictionaryBatch { id, data }
+    std::vector<std::size_t> positions;
+    const auto dictionary = builder.AddTable({MakeField(0, 8, kSymbolDictionaryId), MakeOffsetField(1)}, &positions);
+    builder.Link(positions[1], AddRecordBatch(builder, layout));
+    return dictionary;
+  });
+  const auto dictionary = WriteMessage(metadata, layout.body);
+  // End of stream
+  const std::uint32_t end_of_stream[] = {0xFFFFFFFF, 0};
+  Write(reinterpret_cast<const char*>(end_of_stream), sizeof(end_of_stream));
+  // Footer { version, schema, dictionaries, recordBatches }, where Block is
+  // { offset, metaDataLength, bodyLength } with 4 bytes of padding
+  const auto to_words = [](const std::vector<Block>& blocks) -> std::vector<std::uint64_t> {
+    std::vector<std::uint64_t> words;
+    for (const auto& block : blocks) {
+      words.push_back(block.offset);
+      words.push_back(static_cast<std::uint32_t>(block.metadata_length));
+      words.push_back(block.body_length);
+    }
+    return words;
+  };
+  FlatBufferBuilder builder;
+  std::vector<std::size_t> positions;
+  const auto footer = builder.AddTable({
+    MakeField(0, 2, kMetadataVersionV5),
+    MakeOffsetField(1),
+    MakeOffsetField(2),
+    MakeOffsetField(3)
+  }, &positions);
+  builder.SetRoot(footer);
+  builder.Link(positions[1], AddSchema(builder));
+  builder.Link(positions[2], builder.AddStructVector(to_words({dictionary}), 1));
+  builder.Link(positions[3], builder.AddStructVector(to_words(record_batches_), record_batches_.size()));
+  const auto& footer_data = builder.GetBuffer();
+  Write(footer_data.data(), footer_data.size());
+  const auto footer_size = static_cast<std::int32_t>(footer_data.size());
+  Write(reinterpret_cast<const char*>(&footer_size), 4);
+  Write(kMagic, 6);
+  o_.flush();
+  return static_cast<bool>(o_);
+}
+
+std::size_t ArrowWriter::GetRowCount() const {
+  return row_count_;
+}
+
+std::size_t ArrowWriter::GetBatchCount() const {
+  return record_batches_.size();
+}
+
+std::size_t ArrowWriter::GetSymbolCount() const {
+  return symbol_ids_.size();
+}
+
+}
@@ -0,0 +1,74 @@
+#ifndef ARROW_WRITER_HPP_
+#define ARROW_WRITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Writes parsed records as an Apache Arrow IPC file, which is also a
+// Feather V2 file, with one row per node in pre-order:
+//   record_id: int64, given for each record
+//   node_id: int32, pre-order number of the node in its record
+//   parent_id: int32, null for roots
+//   depth: int32, 0 for roots
+//   symbol: dictionary<values=utf8, indices=int32>, null for non-leaves
+// Rows are written out in record batches as the batches fill up. The
+// symbol dictionary grows over all the records and is written once by
+// Close(), where readers find it through the file footer, so the output
+// is only readable as a file and not as an IPC stream.
+// The metadata flatbuffers are written by hand, so the Arrow libraries are
+// not needed. Buffers are little-endian and the host must be as well.
+class ArrowWriter {
+public:
+  explicit ArrowWriter(std::ostream& o, const std::size_t batch_size = 65536);
+  ArrowWriter(const ArrowWriter&) = delete;
+  ArrowWriter& operator=(const ArrowWriter&) = delete;
+  void WriteRecord(const std::int64_t record_id, const std::vector<TreeNode>& roots);
+  // Must be called once after the last record.
+  // False if writing to the stream failed at any point.
+  bool Close();
+  std::size_t GetRowCount() const;
+  std::size_t GetBatchCount() const;
+  std::size_t GetSymbolCount() const;
+private:
+  struct Block {
+    std::int64_t offset;
+    std::int32_t metadata_length;
+    std::int64_t body_length;
+  };
+  void AddRow(const std::int64_t record_id, const std::int32_t node_id, const std::int32_t parent_id, const std::int32_t depth, const TreeNode& node);
+  void FlushBatch();
+  Block WriteMessage(const std::string& metadata, const std::string& body);
+  void Write(const char* data, const std::size_t size);
+  std::ostream& o_;
+  const std::size_t batch_size_;
+  std::size_t position_;
+  std::size_t row_count_;
+  bool closed_;
+  // Columns of the current batch
+  std::vector<std::int64_t> record_ids_;
+  std::vector<std::int32_t> node_ids_;
+  std::vector<std::int32_t> parent_ids_;
+  std::vector<std::uint8_t> parent_validity_;
+  std::size_t parent_null_count_;
+  std::vector<std::int32_t> depths_;
+  std::vector<std::int32_t> symbols_;
+  std::vector<std::uint8_t> symbol_validity_;
+  std::size_t symbol_null_count_;
+  // Dictionary as a utf8 column
+  std::unordered_map<std::string, std::int32_t> symbol_ids_;
+  std::vector<std::int32_t> symbol_offsets_;
+  std::string symbol_data_;
+  std::vector<Block> record_batches_;
+};
+
+}
+
+#endif /* ARROW_WRITER_HPP_ */
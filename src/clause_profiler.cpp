@@ -0,0 +1,163 @@
+#include "clause_profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+#include "incremental_parser.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+// "functor/arity" of the head of a rule, or of a fact
+std::string GetPredicateIndicator(const TreeNode& clause) {
+  auto head = &clause;
+  if (!clause.IsLeaf() && clause.GetChildren().size() >= 2 && clause.GetChildren().front().GetValue() == "<=") {
+    head = &clause.GetChildren()[1];
+  }
+  if (head->IsLeaf()) {
+    return head->GetValue() + "/0";
+  }
+  if (head->GetChildren().empty() || !head->GetChildren().front().IsLeaf()) {
+    return head->ToSexpr(16);
+  }
+  return head->GetChildren().front().GetValue() + "/" + std::to_string(head->GetChildren().size() - 1);
+}
+
+}
+
+std::vector<SourceLocation> LocateKIFForms(const std::string& kif) {
+  // The incremental parser finds the same forms as ParseKIF()
+  const IncrementalParser parser(kif, true);
+  std::vector<SourceLocation> locations;
+  locations.reserve(parser.GetSpans().size());
+  SourceLocation current = {1, 1};
+  std::size_t pos = 0;
+  for (const auto& span : parser.GetSpans()) {
+    for (; pos < span.begin; ++pos) {
+      if (kif[pos] == '\n') {
+        ++current.line;
+        current.column = 1;
+      } else {
+        ++current.column;
+      }
+    }
+    locations.push_back(current);
+  }
+  return locations;
+}
+
+ClauseProfile::ClauseProfile() : invocations(0), tuples(0), probes(0), seconds(0) {
+}
+
+ClauseProfiler::ClauseProfiler(const std::vector<TreeNode>& clauses, const std::vector<SourceLocation>& locations) :
+    labels_(), profiles_(clauses.size()) {
+  assert(locations.empty() || locations.size() == clauses.size());
+  labels_.reserve(clauses.size());
+  for (std::size_t i = 0; i < clauses.size(); ++i) {
+    auto label = GetPredicateIndicator(clauses[i]);
+    if (locations.empty()) {
+      label += " #" + std::to_string(i);
+    } else {
+      label += " at " + std::to_string(locations[i].line) + ":" + std::to_string(locations[i].column);
+    }
+    labels_.push_back(label);
+  }
+}
+
+ClauseProfiler::Scope::Scope(ClauseProfiler* profiler, const std::size_t clause_index) :
+    profiler_(profiler), clause_index_(clause_index), start_(std::chrono::steady_clock::now()) {
+}
+
+ClauseProfiler::Scope::~Scope() {
+  if (!profiler_) {
+    return;
+  }
+  auto& profile = profiler_->profiles_[clause_index_];
+  ++profile.invocations;
+  profile.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void ClauseProfiler::AddTuples(const std::size_t clause_index, const std::uint64_t count) {
+  profiles_[clause_index].tuples += count;
+}
+
+void ClauseProfiler::AddProbes(const std::size_t clause_index, const std::uint64_t count) {
+  profiles_[clause_index].probes += count;
+}
+
+void ClauseProfiler::Merge(const ClauseProfiler& another) {
+  assert(another.profiles_.size() == profiles_.size());
+  for (std::size_t i = 0; i < profiles_.size(); ++i) {
+    profiles_[i].invocations += another.profiles_[i].invocations;
+    profiles_[i].tuples += another.profiles_[i].tuples;
+    profiles_[i].probes += another.profiles_[i].probes;
+    profiles_[i].seconds += another.profiles_[i].seconds;
+  }
+}
+
+std::size_t ClauseProfiler::GetClauseCount() const {
+  return profiles_.size();
+}
+
+const ClauseProfile& ClauseProfiler::GetProfile(const std::size_t clause_index) const {
+  return profiles_.at(clause_index);
+}
+
+std::string ClauseProfiler::GetLabel(const std::size_t clause_index) const {
+  return labels_.at(clause_index);
+}
+
+std::vector<std::size_t> ClauseProfiler::GetSortedClauses() const {
+  std::vector<std::size_t> clauses;
+  for (std::size_t i = 0; i < profiles_.size(); ++i) {
+    if (profiles_[i].invocations > 0) {
+      clauses.push_back(i);
+    }
+  }
+  // Ties, e.g. on coarse clocks, are broken by the work done
+  std::stable_sort(clauses.begin(), clauses.end(), [this](const std::size_t a, const std::size_t b) {
+    const auto& p = profiles_[a];
+    const auto& q = profiles_[b];
+    if (p.seconds != q.seconds) {
+      return p.seconds > q.seconds;
+    }
+    return p.probes + p.tuples > q.probes + q.tuples;
+  });
+  return clauses;
+}
+
+void ClauseProfiler::WriteReport(std::ostream& o, const std::size_t max_rows) const {
+  double total_seconds = 0;
+  for (const auto& profile : profiles_) {
+    total_seconds += profile.seconds;
+  }
+  char line[160];
+  std::snprintf(line, sizeof(line), "%12s %6s %12s %12s %12s  %s\n", "time ms", "%", "invocations", "tuples", "probes", "clause");
+  o << line;
+  const auto clauses = GetSortedClauses();
+  for (std::size_t i = 0; i < clauses.size() && i < max_rows; ++i) {
+    const auto& profile = profiles_[clauses[i]];
+    std::snprintf(line, sizeof(line), "%12.3f %6.1f %12llu %12llu %12llu  ",
+        profile.seconds * 1e3,
+        total_seconds > 0 ? profile.seconds / total_seconds * 100 : 0.0,
+        static_cast<unsigned long long>(profile.invocations),
+        static_cast<unsigned long long>(profile.tuples),
+        static_cast<unsigned long long>(profile.probes));
+    o << line << labels_[clauses[i]] << '\n';
+  }
+}
+
+void ClauseProfiler::WriteFoldedStacks(std::ostream& o, const std::string& root) const {
+  for (const auto clause : GetSortedClauses()) {
+    // Frames are separated by ';', and the count follows the last space
+    auto label = labels_[clause];
+    std::replace(label.begin(), label.end(), ';', ',');
+    const auto microseconds = static_cast<unsigned long long>(std::llround(profiles_[clause].seconds * 1e6));
+    o << root << ';' << label << ' ' << microseconds << '\n';
+  }
+}
+
+}
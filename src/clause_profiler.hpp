@@ -0,0 +1,75 @@
+#ifndef CLAUSE_PROFILER_HPP_
+#define CLAUSE_PROFILER_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// 1-based line and column of the first character of a form
+struct SourceLocation {
+  std::size_t line;
+  std::size_t column;
+};
+
+// Locations of the forms of ParseKIF(kif), in the same order
+std::vector<SourceLocation> LocateKIFForms(const std::string& kif);
+
+struct ClauseProfile {
+  ClauseProfile();
+  // Evaluations of the clause, e.g. once per fixpoint iteration
+  std::uint64_t invocations;
+  // Head tuples produced, including ones already known
+  std::uint64_t tuples;
+  // Candidate tuples tested against body literals
+  std::uint64_t probes;
+  double seconds;
+};
+
+// Counters of an evaluation engine per clause, where clauses are the forms
+// given to the engine. One profiler per thread; Merge() the profilers of a
+// parallel run.
+class ClauseProfiler {
+public:
+  // Without locations, clauses are only identified by their indices
+  explicit ClauseProfiler(const std::vector<TreeNode>& clauses, const std::vector<SourceLocation>& locations = std::vector<SourceLocation>());
+  // Counts one invocation and its time while alive
+  class Scope {
+  public:
+    Scope(ClauseProfiler* profiler, const std::size_t clause_index);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  private:
+    ClauseProfiler* const profiler_;
+    const std::size_t clause_index_;
+    const std::chrono::steady_clock::time_point start_;
+  };
+  void AddTuples(const std::size_t clause_index, const std::uint64_t count);
+  void AddProbes(const std::size_t clause_index, const std::uint64_t count);
+  void Merge(const ClauseProfiler& another);
+  std::size_t GetClauseCount() const;
+  const ClauseProfile& GetProfile(const std::size_t clause_index) const;
+  // e.g. "legal/2 at 12:1"
+  std::string GetLabel(const std::size_t clause_index) const;
+  // Clauses that were invoked, the slowest first
+  std::vector<std::size_t> GetSortedClauses() const;
+  // Table of the slowest clauses with their share of the total time
+  void WriteReport(std::ostream& o, const std::size_t max_rows = SIZE_MAX) const;
+  // One "root;label microseconds" line per invoked clause, the folded stack
+  // format read by flamegraph.pl and speedscope
+  void WriteFoldedStacks(std::ostream& o, const std::string& root = "evaluation") const;
+private:
+  std::vector<std::string> labels_;
+  std::vector<ClauseProfile> profiles_;
+};
+
+}
+
+#endif /* CLAUSE_PROFILER_HPP_ */
@@ -0,0 +1,424 @@
+#include "corpus_loader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sexpr_parser {
+
+namespace {
+
+// Larger files are read in several requests
+const std::size_t kMaxReadLength = 1 << 30;
+
+// Texts whose reads completed, waiting for a parse worker.
+// Push() blocks while the queued texts hold max_bytes, so that reads do not
+// run ahead of parsing and keep a whole corpus in memory. A text is always
+// accepted into an empty queue, however long.
+class ParseQueue {
+public:
+  explicit ParseQueue(const std::size_t max_bytes) :
+      mutex_(), not_empty_(), not_full_(), items_(), bytes_(0), max_bytes_(max_bytes), closed_(false) {
+  }
+  void Push(const std::size_t index, std::string&& text) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_.wait(lock, [this, &text]() {
+        return items_.empty() || bytes_ + text.size() <= max_bytes_;
+      });
+      bytes_ += text.size();
+      items_.emplace_back(index, std::move(text));
+    }
+    not_empty_.notify_one();
+  }
+  // Returns false when closed and empty
+  bool Pop(std::size_t& index, std::string& text) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this]() {
+        return closed_ || !items_.empty();
+      });
+      if (items_.empty()) {
+        return false;
+      }
+      index = items_.front().first;
+      text = std::move(items_.front().second);
+      items_.pop_front();
+      bytes_ -= text.size();
+    }
+    not_full_.notify_all();
+    return true;
+  }
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+  }
+private:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<std::pair<std::size_t, std::string>> items_;
+  std::size_t bytes_;
+  const std::size_t max_bytes_;
+  bool closed_;
+};
+
+// Minimal io_uring over the raw system calls, as liburing is not required.
+// Only the thread that created it may use it.
+class IoUring {
+public:
+  explicit IoUring(const unsigned entries) :
+      ring_fd_(-1), sq_ring_(nullptr), sq_ring_size_(0), cq_ring_(nullptr), cq_ring_size_(0), sqes_(nullptr), sqes_size_(0),
+      sq_tail_(nullptr), sq_mask_(0), sq_entries_(0), sq_array_(nullptr), cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(0), cqes_(nullptr),
+      queued_(0) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(::syscall(SYS_io_uring_setup, entries, &params));
+    if (ring_fd_ < 0) {
+      return;
+    }
+    // IORING_OP_READ needs Linux 5.6, which also introduced this feature
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+      Close();
+      return;
+    }
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = single_mmap ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+    if (!sq_ring_ || !cq_ring_ || !sqes_) {
+      Close();
+      return;
+    }
+    const auto sq = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    const auto cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+  ~IoUring() {
+    Close();
+  }
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+  bool IsOpen() const {
+    return ring_fd_ >= 0;
+  }
+  unsigned GetEntryCount() const {
+    return sq_entries_;
+  }
+  // Queues a read to be submitted by the next Submit()
+  void PrepareRead(const int fd, char* buffer, const unsigned length, const std::uint64_t offset, const std::uint64_t user_data) {
+    assert(queued_ < sq_entries_);
+    const auto tail = *sq_tail_ + queued_;
+    const auto index = tail & sq_mask_;
+    auto& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe.len = length;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    sq_array_[index] = index;
+    ++queued_;
+  }
+  // Submits the queued reads and waits for at least one completion
+  bool SubmitAndWait() {
+    // The kernel reads the tail after this store
+    __atomic_store_n(sq_tail_, *sq_tail_ + queued_, __ATOMIC_RELEASE);
+    auto to_submit = queued_;
+    queued_ = 0;
+    while (true) {
+      const auto result = ::syscall(SYS_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (result >= 0) {
+        return true;
+      }
+      if (errno != EINTR && errno != EAGAIN) {
+        return false;
+      }
+      // Interrupted waits are retried without submitting twice
+      to_submit = 0;
+    }
+  }
+  // Calls function(user_data, result) for each completion, where result is
+  // the byte count or a negated errno
+  template <class Function>
+  void ForEachCompletion(Function function) {
+    auto head = *cq_head_;
+    const auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const auto& cqe = cqes_[head & cq_mask_];
+      function(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+private:
+  void* Map(const std::size_t size, const off_t offset) {
+    const auto data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    return data == MAP_FAILED ? nullptr : data;
+  }
+  void Close() {
+    if (sqes_) {
+      ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+      ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+      ::munmap(sq_ring_, sq_ring_size_);
+    }
+    sqes_ = nullptr;
+    cq_ring_ = sq_ring_ = nullptr;
+    if (ring_fd_ >= 0) {
+      ::close(ring_fd_);
+    }
+    ring_fd_ = -1;
+  }
+  int ring_fd_;
+  void* sq_ring_;
+  std::size_t sq_ring_size_;
+  void* cq_ring_;
+  std::size_t cq_ring_size_;
+  io_uring_sqe* sqes_;
+  std::size_t sqes_size_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+  unsigned queued_;
+};
+
+// Opens a file and sizes its buffer, or sets the error of the file
+int OpenForRead(LoadedFile& file, std::string& buffer) {
+  const auto fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    file.error = errno;
+    return -1;
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    file.error = errno;
+    ::close(fd);
+    return -1;
+  }
+  file.size = static_cast<std::size_t>(status.st_size);
+  buffer.assign(file.size, '\0');
+  return fd;
+}
+
+// State of a file whose reads are in flight
+struct PendingRead {
+  int fd;
+  std::string buffer;
+  std::size_t done;
+};
+
+}
+
+CorpusLoaderOptions::CorpusLoaderOptions() :
+    queue_depth(64),
+    num_parse_threads(0),
+    num_read_threads(0),
+    max_queued_bytes(256 << 20),
+    uses_io_uring(true),
+    flatten_tuple_with_one_child(true),
+    limits() {
+}
+
+LoadedFile::LoadedFile() : path(), error(0), size(0), forms(), limit_error() {
+}
+
+CorpusLoader::CorpusLoader(const CorpusLoaderOptions& options) : options_(options), last_backend_(LoaderBackend::kThreadPool) {
+}
+
+std::vector<LoadedFile> CorpusLoader::Load(const std::vector<std::string>& paths) {
+  std::vector<LoadedFile> files(paths.size());
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    files[i].path = paths[i];
+  }
+  ParseQueue queue(options_.max_queued_bytes);
+  auto num_parse_threads = options_.num_parse_threads;
+  if (num_parse_threads == 0) {
+    num_parse_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::vector<std::thread> parse_threads;
+  for (std::size_t i = 0; i < num_parse_threads; ++i) {
+    parse_threads.emplace_back([&]() {
+      std::size_t index = 0;
+      std::string text;
+      while (queue.Pop(index, text)) {
+        auto& file = files[index];
+        ParseWithLimits(text, options_.limits, file.forms, file.limit_error, options_.flatten_tuple_with_one_child);
+        std::string().swap(text);
+      }
+    });
+  }
+  // Files that have been handed to the parse queue or have failed
+  std::vector<char> finished(paths.size(), false);
+  const auto finish = [&](const std::size_t index, std::string&& text) {
+    finished[index] = true;
+    if (files[index].error == 0) {
+      queue.Push(index, std::move(text));
+    }
+  };
+  const auto queue_depth = std::max<std::size_t>(1, options_.queue_depth);
+  last_backend_ = LoaderBackend::kThreadPool;
+  // Declared before the ring, so that buffers outlive any read in flight
+  std::vector<PendingRead> pending;
+  std::unique_ptr<IoUring> ring;
+  if (options_.uses_io_uring) {
+    ring.reset(new IoUring(static_cast<unsigned>(queue_depth)));
+  }
+  if (ring && ring->IsOpen()) {
+    last_backend_ = LoaderBackend::kIoUring;
+    pending.resize(paths.size());
+    const auto max_in_flight = std::min<std::size_t>(queue_depth, ring->GetEntryCount());
+    std::size_t next = 0;
+    std::size_t in_flight = 0;
+    const auto prepare_read = [&](const std::size_t index) {
+      auto& read = pending[index];
+      const auto length = std::min(read.buffer.size() - read.done, kMaxReadLength);
+      ring->PrepareRead(read.fd, &read.buffer[read.done], static_cast<unsigned>(length), read.done, index);
+    };
+    const auto complete = [&](const std::size_t index) {
+      auto& read = pending[index];
+      ::close(read.fd);
+      read.buffer.resize(read.done);
+      files[index].size = read.done;
+      finish(index, std::move(read.buffer));
+      --in_flight;
+    };
+    while (next < paths.size() || in_flight > 0) {
+      while (in_flight < max_in_flight && next < paths.size()) {
+        const auto index = next++;
+        auto& read = pending[index];
+        read.done = 0;
+        read.fd = OpenForRead(files[index], read.buffer);
+        if (read.fd < 0) {
+          finish(index, std::string());
+        } else if (read.buffer.empty()) {
+          ++in_flight;
+          complete(index);
+        } else {
+          ++in_flight;
+          prepare_read(index);
+        }
+      }
+      if (in_flight == 0) {
+        break;
+      }
+      if (!ring->SubmitAndWait()) {
+        // Files in flight are read again by the thread pool below
+        for (std::size_t i = 0; i < next; ++i) {
+          if (!finished[i]) {
+            ::close(pending[i].fd);
+          }
+        }
+        break;
+      }
+      ring->ForEachCompletion([&](const std::uint64_t user_data, const int result) {
+        const auto index = static_cast<std::size_t>(user_data);
+        auto& read = pending[index];
+        if (result < 0) {
+          files[index].error = -result;
+          read.done = 0;
+          complete(index);
+        } else if (result == 0 || read.done + result == read.buffer.size()) {
+          // A file that shrank after fstat() ends early
+          read.done += result;
+          complete(index);
+        } else {
+          // Short read
+          read.done += result;
+          prepare_read(index);
+        }
+      });
+    }
+  }
+  // Fallback, and files left over by a failed io_uring
+  std::atomic<std::size_t> next_file(0);
+  const auto num_read_threads = options_.num_read_threads ? options_.num_read_threads : queue_depth;
+  std::vector<std::thread> read_threads;
+  for (std::size_t i = 0; i < num_read_threads && i < paths.size(); ++i) {
+    read_threads.emplace_back([&]() {
+      for (auto index = next_file++; index < paths.size(); index = next_file++) {
+        if (finished[index]) {
+          continue;
+        }
+        auto& file = files[index];
+        file.error = 0;
+        std::string buffer;
+        const auto fd = OpenForRead(file, buffer);
+        std::size_t done = 0;
+        while (fd >= 0 && done < buffer.size()) {
+          const auto result = ::pread(fd, &buffer[done], std::min(buffer.size() - done, kMaxReadLength), done);
+          if (result < 0 && errno == EINTR) {
+            continue;
+          }
+          if (result < 0) {
+            file.error = errno;
+            break;
+          }
+          if (result == 0) {
+            break;
+          }
+          done += result;
+        }
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        buffer.resize(done);
+        file.size = done;
+        finish(index, std::move(buffer));
+      }
+    });
+  }
+  for (auto& thread : read_threads) {
+    thread.join();
+  }
+  queue.Close();
+  for (auto& thread : parse_threads) {
+    thread.join();
+  }
+  return files;
+}
+
+LoaderBackend CorpusLoader::GetLastBackend() const {
+  return last_backend_;
+}
+
+}
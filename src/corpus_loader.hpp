@@ -0,0 +1,69 @@
+#ifndef CORPUS_LOADER_HPP_
+#define CORPUS_LOADER_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "parse_limits.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+enum class LoaderBackend {
+  kIoUring,
+  kThreadPool
+};
+
+struct CorpusLoaderOptions {
+  CorpusLoaderOptions();
+  // Reads in flight at once
+  std::size_t queue_depth;
+  // 0 means the hardware concurrency
+  std::size_t num_parse_threads;
+  // Reader threads of the fallback, 0 means queue_depth
+  std::size_t num_read_threads;
+  // Text read but not yet parsed, beyond which reads wait for the parse
+  // workers. A single larger file is still read.
+  std::size_t max_queued_bytes;
+  // false always uses the thread pool, e.g. for comparison
+  bool uses_io_uring;
+  // true parses files as ParseKIF() does
+  bool flatten_tuple_with_one_child;
+  ParseLimits limits;
+};
+
+struct LoadedFile {
+  LoadedFile();
+  std::string path;
+  // errno of a failed open or read, or 0
+  int error;
+  std::size_t size;
+  std::vector<TreeNode> forms;
+  // Set when the file exceeded a parse limit, in which case forms is empty
+  LimitError limit_error;
+};
+
+// Reads many files and parses them in parallel, handing each file to a
+// parse worker as soon as its read completes, so that I/O and parsing
+// overlap. Reads pause while max_queued_bytes of text wait to be parsed.
+// Reads are submitted in batches through io_uring(7), driven by raw system
+// calls, with one system call for a whole batch of submissions and
+// completions. Where io_uring is unavailable (kernels before 5.6, seccomp
+// filters, io_uring_disabled), a pool of threads issues blocking reads.
+// Files are opened and sized synchronously before their reads.
+class CorpusLoader {
+public:
+  explicit CorpusLoader(const CorpusLoaderOptions& options = CorpusLoaderOptions());
+  // Files in the order of paths
+  std::vector<LoadedFile> Load(const std::vector<std::string>& paths);
+  // Backend of the last Load()
+  LoaderBackend GetLastBackend() const;
+private:
+  const CorpusLoaderOptions options_;
+  LoaderBackend last_backend_;
+};
+
+}
+
+#endif /* CORPUS_LOADER_HPP_ */
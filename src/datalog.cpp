@@ -0,0 +1,687 @@
+#include "datalog.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace sexpr_parser {
+
+namespace {
+
+const std::size_t kMaxIndexedChildren = 15;
+
+bool HasVariable(const TreeNode& node) {
+  if (node.IsLeaf()) {
+    return node.IsVariable();
+  }
+  for (const auto& child : node.GetChildren()) {
+    if (HasVariable(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsCompound(const TreeNode& node, const char* functor) {
+  return !node.IsLeaf() && !node.GetChildren().empty() && node.GetChildren().front().IsLeaf() && node.GetChildren().front().GetValue() == functor;
+}
+
+// Each conjunction of left followed by each of right
+template <class T>
+std::vector<std::vector<T>> Conjoin(const std::vector<std::vector<T>>& left, const std::vector<std::vector<T>>& right) {
+  std::vector<std::vector<T>> conjoined;
+  conjoined.reserve(left.size() * right.size());
+  for (const auto& first : left) {
+    for (const auto& second : right) {
+      conjoined.push_back(first);
+      conjoined.back().insert(conjoined.back().end(), second.begin(), second.end());
+    }
+  }
+  return conjoined;
+}
+
+}
+
+DatalogEngine::DatalogEngine(const bool relaxes, const std::size_t max_facts, ClauseProfiler* profiler) :
+    relaxes_(relaxes), store_(), relations_(), relation_ids_(), rules_(), strata_(), max_facts_(max_facts),
+    fact_count_(0), iteration_count_(0), overflows_(false), profiler_(profiler) {
+}
+
+TermStore& DatalogEngine::GetTermStore() {
+  return store_;
+}
+
+const TermStore& DatalogEngine::GetTermStore() const {
+  return store_;
+}
+
+void DatalogEngine::AddClause(const TreeNode& clause, const std::size_t clause_index) {
+  assert(strata_.empty());
+  const TreeNode* head = &clause;
+  std::vector<std::vector<BodyLiteral>> bodies(1);
+  if (IsCompound(clause, "<=")) {
+    const auto& children = clause.GetChildren();
+    if (children.size() < 2) {
+      return;
+    }
+    head = &children[1];
+    for (std::size_t i = 2; i < children.size(); ++i) {
+      bodies = Conjoin(bodies, ExpandLiteral(children[i], false));
+    }
+  }
+  for (const auto& body : bodies) {
+    AddRule(*head, body, clause_index);
+  }
+}
+
+std::size_t DatalogEngine::GetRelation(const std::string& name, const std::size_t arity) {
+  return GetRelation(store_.InternAtom(name), arity);
+}
+
+bool DatalogEngine::Stratify() {
+  for (const auto& rule : rules_) {
+    for (const auto& literal : rule.body) {
+      relations_[literal.relation].dependents.push_back(rule.head_relation);
+    }
+    for (const auto& literal : rule.negatives) {
+      relations_[literal.relation].dependents.push_back(rule.head_relation);
+    }
+  }
+  for (auto& relation : relations_) {
+    std::sort(relation.dependents.begin(), relation.dependents.end());
+    relation.dependents.erase(std::unique(relation.dependents.begin(), relation.dependents.end()), relation.dependents.end());
+  }
+  // A head is in a stratum at least as high as its positive literals and
+  // higher than its negative ones, which can only be met without recursion
+  // through negation
+  std::size_t max_stratum = 0;
+  for (auto changes = true; changes; ) {
+    changes = false;
+    for (const auto& rule : rules_) {
+      auto& stratum = relations_[rule.head_relation].stratum;
+      const auto old_stratum = stratum;
+      for (const auto& literal : rule.body) {
+        stratum = std::max(stratum, relations_[literal.relation].stratum);
+      }
+      for (const auto& literal : rule.negatives) {
+        stratum = std::max(stratum, relations_[literal.relation].stratum + 1);
+      }
+      if (stratum > relations_.size()) {
+        return false;
+      }
+      changes = changes || stratum != old_stratum;
+      max_stratum = std::max(max_stratum, stratum);
+    }
+  }
+  strata_.assign(max_stratum + 1, std::vector<const Rule*>());
+  for (const auto& rule : rules_) {
+    strata_[relations_[rule.head_relation].stratum].push_back(&rule);
+  }
+  return true;
+}
+
+void DatalogEngine::SetInputs(const std::vector<std::size_t>& relations) {
+  for (const auto relation : relations) {
+    relations_[relation].is_input = true;
+  }
+}
+
+void DatalogEngine::ClearInputs() {
+  std::vector<bool> clears(relations_.size(), false);
+  std::vector<std::size_t> pending;
+  for (std::size_t i = 0; i < relations_.size(); ++i) {
+    if (relations_[i].is_input) {
+      clears[i] = true;
+      pending.push_back(i);
+    }
+  }
+  while (!pending.empty()) {
+    const auto relation_id = pending.back();
+    auto& relation = relations_[relation_id];
+    pending.pop_back();
+    for (const auto dependent : relation.dependents) {
+      if (!clears[dependent]) {
+        clears[dependent] = true;
+        pending.push_back(dependent);
+      }
+    }
+    fact_count_ -= relation.facts.size();
+    relation.facts.clear();
+    relation.positions.clear();
+    // The entries are kept to reuse their memory for the next facts
+    for (auto& entry : relation.index) {
+      entry.second.clear();
+    }
+    relation.stable = 0;
+    relation.delta_end = 0;
+    relation.is_changed = true;
+    for (const auto fact : relation.ground_facts) {
+      Insert(relation_id, fact);
+    }
+  }
+  overflows_ = fact_count_ > max_facts_;
+}
+
+void DatalogEngine::AddFact(const std::size_t relation, const TermId fact) {
+  assert(store_.GetChildCount(fact) == relations_[relation].arity + 1 || (relations_[relation].arity == 0 && store_.IsAtom(fact)));
+  Insert(relation, fact);
+}
+
+bool DatalogEngine::Run() {
+  assert(!strata_.empty() || rules_.empty());
+  // Only the relations derived from changed ones are evaluated again
+  std::vector<bool> stale(relations_.size(), false);
+  std::vector<std::size_t> pending;
+  for (std::size_t i = 0; i < relations_.size(); ++i) {
+    if (relations_[i].is_changed) {
+      stale[i] = true;
+      pending.push_back(i);
+    }
+  }
+  while (!pending.empty()) {
+    const auto& relation = relations_[pending.back()];
+    pending.pop_back();
+    for (const auto dependent : relation.dependents) {
+      if (!stale[dependent]) {
+        stale[dependent] = true;
+        pending.push_back(dependent);
+      }
+    }
+  }
+  for (auto& relation : relations_) {
+    relation.stable = relation.facts.size();
+    relation.delta_end = relation.facts.size();
+  }
+  std::vector<const Rule*> rules;
+  for (const auto& stratum : strata_) {
+    rules.clear();
+    for (const auto rule : stratum) {
+      if (stale[rule->head_relation]) {
+        rules.push_back(rule);
+      }
+    }
+    if (!rules.empty()) {
+      EvaluateStratum(rules);
+    }
+    if (overflows_) {
+      break;
+    }
+  }
+  for (auto& relation : relations_) {
+    relation.is_changed = false;
+  }
+  return !overflows_;
+}
+
+const std::vector<TermId>& DatalogEngine::GetFacts(const std::size_t relation) const {
+  return relations_[relation].facts;
+}
+
+bool DatalogEngine::HasFact(const std::size_t relation, const TermId fact) const {
+  return relations_[relation].positions.count(fact) > 0;
+}
+
+std::size_t DatalogEngine::GetIterationCount() const {
+  return iteration_count_;
+}
+
+std::size_t DatalogEngine::GetFactCount() const {
+  return fact_count_;
+}
+
+std::vector<TreeNode> DatalogEngine::ToClauses(const std::string& name, const std::size_t arity, const std::string& head) {
+  std::vector<TreeNode> clauses;
+  const auto found = relation_ids_.find(GetRelationKey(store_.InternAtom(name), arity));
+  if (found == relation_ids_.end()) {
+    return clauses;
+  }
+  const auto& relation = relations_[found->second];
+  clauses.reserve(relation.facts.size());
+  for (const auto fact : relation.facts) {
+    std::vector<TreeNode> children(1, TreeNode(head));
+    for (std::size_t i = 1; i <= arity; ++i) {
+      children.push_back(store_.ToTreeNode(store_.GetChild(fact, i)));
+    }
+    clauses.emplace_back(std::move(children));
+  }
+  return clauses;
+}
+
+// Child 0 stands for the argument itself
+std::uint64_t DatalogEngine::GetIndexKey(const std::size_t argument, const std::size_t child, const TermId term) {
+  return (static_cast<std::uint64_t>(argument * (kMaxIndexedChildren + 1) + child) << 32) | term;
+}
+
+std::uint64_t DatalogEngine::GetRelationKey(const TermId functor, const std::size_t arity) {
+  return (static_cast<std::uint64_t>(functor) << 32) | arity;
+}
+
+// Alternative conjunctions of a body literal. Under "not", "or" becomes a
+// conjunction of negated literals.
+std::vector<std::vector<DatalogEngine::BodyLiteral>> DatalogEngine::ExpandLiteral(const TreeNode& literal, const bool negated) const {
+  if (IsCompound(literal, "not")) {
+    if (relaxes_ || literal.GetChildren().size() != 2) {
+      return std::vector<std::vector<BodyLiteral>>(1);
+    }
+    return ExpandLiteral(literal.GetChildren()[1], !negated);
+  }
+  if (IsCompound(literal, "or")) {
+    std::vector<std::vector<BodyLiteral>> alternatives(negated ? 1 : 0);
+    for (std::size_t i = 1; i < literal.GetChildren().size(); ++i) {
+      auto expanded = ExpandLiteral(literal.GetChildren()[i], negated);
+      if (negated) {
+        alternatives = Conjoin(alternatives, expanded);
+      } else {
+        for (auto& alternative : expanded) {
+          alternatives.push_back(std::move(alternative));
+        }
+      }
+    }
+    return alternatives;
+  }
+  return std::vector<std::vector<BodyLiteral>>(1, std::vector<BodyLiteral>(1, BodyLiteral{&literal, negated}));
+}
+
+bool DatalogEngine::GetRelation(const TreeNode& atom, std::size_t& relation_id) {
+  if (atom.IsLeaf()) {
+    if (atom.IsVariable()) {
+      return false;
+    }
+    relation_id = GetRelation(store_.InternAtom(atom.GetValue()), 0);
+    return true;
+  }
+  const auto& children = atom.GetChildren();
+  if (children.empty() || !children.front().IsLeaf() || children.front().IsVariable()) {
+    return false;
+  }
+  relation_id = GetRelation(store_.InternAtom(children.front().GetValue()), children.size() - 1);
+  return true;
+}
+
+std::size_t DatalogEngine::GetRelation(const TermId functor, const std::size_t arity) {
+  const auto inserted = relation_ids_.emplace(GetRelationKey(functor, arity), relations_.size());
+  if (inserted.second) {
+    relations_.push_back(Relation());
+    auto& relation = relations_.back();
+    relation.arity = arity;
+    relation.stable = 0;
+    relation.delta_end = 0;
+    relation.stratum = 0;
+    relation.is_input = false;
+    relation.is_changed = false;
+  }
+  return inserted.first->second;
+}
+
+DatalogEngine::Pattern DatalogEngine::Compile(const TreeNode& node, std::unordered_map<std::string, std::size_t>& variables) {
+  Pattern pattern;
+  pattern.constant = kNoTerm;
+  pattern.variable = 0;
+  if (!HasVariable(node)) {
+    pattern.kind = Pattern::Kind::kConstant;
+    pattern.constant = store_.Intern(node);
+  } else if (node.IsLeaf()) {
+    pattern.kind = Pattern::Kind::kVariable;
+    pattern.variable = variables.emplace(node.GetValue(), variables.size()).first->second;
+  } else {
+    pattern.kind = Pattern::Kind::kList;
+    for (const auto& child : node.GetChildren()) {
+      pattern.children.push_back(Compile(child, variables));
+    }
+  }
+  return pattern;
+}
+
+void DatalogEngine::AddRule(const TreeNode& head, const std::vector<BodyLiteral>& body, const std::size_t clause_index) {
+  Rule rule;
+  rule.clause_index = clause_index;
+  if (!GetRelation(head, rule.head_relation)) {
+    return;
+  }
+  // Variables of the positive literals come first, so that the others
+  // are the unsafe ones
+  std::unordered_map<std::string, std::size_t> variables;
+  std::vector<BodyLiteral> others;
+  for (const auto& literal : body) {
+    if (literal.negated || IsCompound(*literal.node, "distinct")) {
+      others.push_back(literal);
+      continue;
+    }
+    Literal compiled;
+    if (!GetRelation(*literal.node, compiled.relation)) {
+      return;
+    }
+    compiled.pattern = Compile(*literal.node, variables);
+    rule.body.push_back(std::move(compiled));
+  }
+  const auto bound_count = variables.size();
+  rule.head = Compile(head, variables);
+  for (const auto& literal : others) {
+    if (IsCompound(*literal.node, "distinct")) {
+      const auto& children = literal.node->GetChildren();
+      if (children.size() == 3) {
+        auto& pairs = literal.negated ? rule.equals : rule.distincts;
+        pairs.emplace_back(Compile(children[1], variables), Compile(children[2], variables));
+      }
+      continue;
+    }
+    Literal compiled;
+    if (!GetRelation(*literal.node, compiled.relation)) {
+      return;
+    }
+    compiled.pattern = Compile(*literal.node, variables);
+    rule.negatives.push_back(std::move(compiled));
+  }
+  if (variables.size() > bound_count) {
+    return;
+  }
+  rule.variable_count = variables.size();
+  if (rule.body.empty() && rule.negatives.empty()) {
+    // Facts are the first delta
+    if (Satisfies(rule, std::vector<TermId>())) {
+      relations_[rule.head_relation].ground_facts.push_back(rule.head.constant);
+      Insert(rule.head_relation, rule.head.constant);
+    }
+    return;
+  }
+  rules_.push_back(std::move(rule));
+}
+
+bool DatalogEngine::Match(const Pattern& pattern, const TermId term, std::vector<TermId>& bindings, std::vector<std::size_t>& trail) const {
+  switch (pattern.kind) {
+  case Pattern::Kind::kConstant:
+    return term == pattern.constant;
+  case Pattern::Kind::kVariable:
+    if (bindings[pattern.variable] == kNoTerm) {
+      bindings[pattern.variable] = term;
+      trail.push_back(pattern.variable);
+      return true;
+    }
+    return bindings[pattern.variable] == term;
+  case Pattern::Kind::kList:
+    if (store_.IsAtom(term) || store_.GetChildCount(term) != pattern.children.size()) {
+      return false;
+    }
+    for (std::size_t i = 0; i < pattern.children.size(); ++i) {
+      if (!Match(pattern.children[i], store_.GetChild(term, i), bindings, trail)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+TermId DatalogEngine::Instantiate(const Pattern& pattern, const std::vector<TermId>& bindings, const bool interns) {
+  switch (pattern.kind) {
+  case Pattern::Kind::kConstant:
+    return pattern.constant;
+  case Pattern::Kind::kVariable:
+    assert(bindings[pattern.variable] != kNoTerm);
+    return bindings[pattern.variable];
+  case Pattern::Kind::kList:
+    break;
+  }
+  std::vector<TermId> children;
+  children.reserve(pattern.children.size());
+  for (const auto& child : pattern.children) {
+    children.push_back(Instantiate(child, bindings, interns));
+    if (children.back() == kNoTerm) {
+      return kNoTerm;
+    }
+  }
+  return interns ? store_.InternList(children.data(), children.size()) : store_.FindList(children.data(), children.size());
+}
+
+bool DatalogEngine::IsBound(const Pattern& pattern, const std::vector<TermId>& bindings) {
+  switch (pattern.kind) {
+  case Pattern::Kind::kConstant:
+    return true;
+  case Pattern::Kind::kVariable:
+    return bindings[pattern.variable] != kNoTerm;
+  case Pattern::Kind::kList:
+    break;
+  }
+  for (const auto& child : pattern.children) {
+    if (!IsBound(child, bindings)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Negative literals are checked against complete relations, as those are
+// in lower strata
+bool DatalogEngine::Satisfies(const Rule& rule, const std::vector<TermId>& bindings) {
+  for (const auto& distinct : rule.distincts) {
+    if (Instantiate(distinct.first, bindings, true) == Instantiate(distinct.second, bindings, true)) {
+      return false;
+    }
+  }
+  for (const auto& equal : rule.equals) {
+    if (Instantiate(equal.first, bindings, true) != Instantiate(equal.second, bindings, true)) {
+      return false;
+    }
+  }
+  for (const auto& literal : rule.negatives) {
+    const auto fact = Instantiate(literal.pattern, bindings, false);
+    if (fact != kNoTerm && HasFact(literal.relation, fact)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DatalogEngine::Insert(const std::size_t relation_id, const TermId fact) {
+  auto& relation = relations_[relation_id];
+  const auto position = static_cast<std::uint32_t>(relation.facts.size());
+  if (!relation.positions.emplace(fact, position).second) {
+    return;
+  }
+  relation.facts.push_back(fact);
+  relation.is_changed = true;
+  for (std::size_t i = 0; i < relation.arity; ++i) {
+    const auto argument = store_.GetChild(fact, i + 1);
+    relation.index[GetIndexKey(i, 0, argument)].push_back(position);
+    if (!store_.IsAtom(argument)) {
+      const auto child_count = std::min<std::size_t>(store_.GetChildCount(argument), kMaxIndexedChildren);
+      for (std::size_t j = 0; j < child_count; ++j) {
+        relation.index[GetIndexKey(i, j + 1, store_.GetChild(argument, j))].push_back(position);
+      }
+    }
+  }
+  if (++fact_count_ > max_facts_) {
+    overflows_ = true;
+  }
+}
+
+// The rules are first joined against all facts, as those of lower strata
+// are complete by now, and then against the deltas of their own stratum
+void DatalogEngine::EvaluateStratum(const std::vector<const Rule*>& rules) {
+  ++iteration_count_;
+  for (const auto rule : rules) {
+    Evaluate(*rule, rule->body.size());
+    if (overflows_) {
+      return;
+    }
+  }
+  for (;;) {
+    auto has_delta = false;
+    for (auto& relation : relations_) {
+      relation.delta_end = relation.facts.size();
+      has_delta = has_delta || relation.delta_end > relation.stable;
+    }
+    if (!has_delta) {
+      return;
+    }
+    ++iteration_count_;
+    for (const auto rule : rules) {
+      for (std::size_t i = 0; i < rule->body.size(); ++i) {
+        const auto& relation = relations_[rule->body[i].relation];
+        if (relation.delta_end > relation.stable) {
+          Evaluate(*rule, i);
+        }
+        if (overflows_) {
+          return;
+        }
+      }
+    }
+    for (auto& relation : relations_) {
+      relation.stable = relation.delta_end;
+    }
+  }
+}
+
+// Joins the body with the given literal restricted to the delta, the
+// literals before it to the facts before the delta and the ones after it
+// to all facts up to the end of the delta, so that each combination of
+// facts with at least one new fact is joined exactly once. With no delta
+// literal, all literals are joined with the facts before the delta.
+void DatalogEngine::Evaluate(const Rule& rule, const std::size_t delta_literal) {
+  const ClauseProfiler::Scope scope(rule.clause_index != kNoClause ? profiler_ : nullptr, rule.clause_index);
+  std::vector<TermId> bindings(rule.variable_count, kNoTerm);
+  std::vector<std::size_t> trail;
+  std::vector<bool> joined(rule.body.size(), false);
+  std::uint64_t tuples = 0;
+  std::uint64_t probes = 0;
+  // The delta literal first, as it has the fewest facts
+  const auto first = delta_literal < rule.body.size() ? delta_literal : ChooseLiteral(rule, delta_literal, bindings, joined);
+  Join(rule, first, delta_literal, bindings, trail, joined, tuples, probes);
+  if (profiler_ && rule.clause_index != kNoClause) {
+    profiler_->AddTuples(rule.clause_index, tuples);
+    profiler_->AddProbes(rule.clause_index, probes);
+  }
+}
+
+void DatalogEngine::GetRange(const std::size_t literal_index, const std::size_t delta_literal, const Relation& relation, std::size_t& begin, std::size_t& end) const {
+  begin = 0;
+  end = relation.delta_end;
+  if (literal_index < delta_literal) {
+    end = relation.stable;
+  } else if (literal_index == delta_literal) {
+    begin = relation.stable;
+  }
+}
+
+std::size_t DatalogEngine::ChooseLiteral(const Rule& rule, const std::size_t delta_literal, const std::vector<TermId>& bindings, const std::vector<bool>& joined) {
+  auto chosen = rule.body.size();
+  std::size_t chosen_count = SIZE_MAX;
+  for (std::size_t i = 0; i < rule.body.size(); ++i) {
+    if (joined[i]) {
+      continue;
+    }
+    const auto& relation = relations_[rule.body[i].relation];
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    GetRange(i, delta_literal, relation, begin, end);
+    const std::vector<std::uint32_t>* positions = nullptr;
+    if (!FindPositions(rule.body[i], relation, bindings, positions)) {
+      // Fails at once
+      return i;
+    }
+    const auto count = positions ? positions->size() : end - begin;
+    if (count < chosen_count) {
+      chosen = i;
+      chosen_count = count;
+    }
+  }
+  return chosen;
+}
+
+bool DatalogEngine::FindPositions(const Literal& literal, const Relation& relation, const std::vector<TermId>& bindings, const std::vector<std::uint32_t>*& positions) {
+  positions = nullptr;
+  const auto& pattern = literal.pattern;
+  if (pattern.kind == Pattern::Kind::kConstant) {
+    return true;
+  }
+  const auto find = [&](const std::size_t argument, const std::size_t child, const Pattern& subpattern) -> bool {
+    const auto term = Instantiate(subpattern, bindings, false);
+    if (term == kNoTerm) {
+      return false;
+    }
+    const auto found = relation.index.find(GetIndexKey(argument, child, term));
+    if (found == relation.index.end()) {
+      return false;
+    }
+    if (!positions || found->second.size() < positions->size()) {
+      positions = &found->second;
+    }
+    return true;
+  };
+  for (std::size_t i = 0; i < relation.arity; ++i) {
+    const auto& argument = pattern.children[i + 1];
+    if (IsBound(argument, bindings)) {
+      if (!find(i, 0, argument)) {
+        return false;
+      }
+    } else if (argument.kind == Pattern::Kind::kList) {
+      const auto child_count = std::min<std::size_t>(argument.children.size(), kMaxIndexedChildren);
+      for (std::size_t j = 0; j < child_count; ++j) {
+        if (IsBound(argument.children[j], bindings) && !find(i, j + 1, argument.children[j])) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void DatalogEngine::Join(const Rule& rule, const std::size_t literal_index, const std::size_t delta_literal, std::vector<TermId>& bindings,
+    std::vector<std::size_t>& trail, std::vector<bool>& joined, std::uint64_t& tuples, std::uint64_t& probes) {
+  if (overflows_) {
+    return;
+  }
+  if (literal_index == rule.body.size()) {
+    if (Satisfies(rule, bindings)) {
+      ++tuples;
+      Insert(rule.head_relation, Instantiate(rule.head, bindings, true));
+    }
+    return;
+  }
+  const auto& literal = rule.body[literal_index];
+  const auto& relation = relations_[literal.relation];
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  GetRange(literal_index, delta_literal, relation, begin, end);
+  joined[literal_index] = true;
+  const auto try_fact = [&](const std::size_t position) {
+    ++probes;
+    const auto trail_size = trail.size();
+    if (Match(literal.pattern, relation.facts[position], bindings, trail)) {
+      Join(rule, ChooseLiteral(rule, delta_literal, bindings, joined), delta_literal, bindings, trail, joined, tuples, probes);
+    }
+    for (auto i = trail_size; i < trail.size(); ++i) {
+      bindings[trail[i]] = kNoTerm;
+    }
+    trail.resize(trail_size);
+  };
+  JoinLiteral(literal, relation, begin, end, bindings, try_fact);
+  joined[literal_index] = false;
+}
+
+template <class TryFact>
+void DatalogEngine::JoinLiteral(const Literal& literal, const Relation& relation, const std::size_t begin, const std::size_t end, const std::vector<TermId>& bindings, TryFact try_fact) {
+  if (literal.pattern.kind == Pattern::Kind::kConstant) {
+    const auto found = relation.positions.find(literal.pattern.constant);
+    if (found != relation.positions.end() && found->second >= begin && found->second < end) {
+      try_fact(found->second);
+    }
+    return;
+  }
+  const std::vector<std::uint32_t>* positions = nullptr;
+  if (!FindPositions(literal, relation, bindings, positions)) {
+    return;
+  }
+  if (positions) {
+    // Facts inserted while joining are after end
+    for (auto i = std::lower_bound(positions->begin(), positions->end(), begin) - positions->begin();
+        i < static_cast<std::ptrdiff_t>(positions->size()) && (*positions)[i] < end; ++i) {
+      try_fact((*positions)[i]);
+    }
+    return;
+  }
+  for (auto position = begin; position < end; ++position) {
+    try_fact(position);
+  }
+}
+
+}
@@ -0,0 +1,165 @@
+#ifndef DATALOG_HPP_
+#define DATALOG_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "clause_profiler.hpp"
+#include "sexpr_parser.hpp"
+#include "term_store.hpp"
+
+namespace sexpr_parser {
+
+const std::size_t kNoClause = SIZE_MAX;
+
+// Bottom-up evaluation of GDL rules over interned ground terms.
+// Rules are ordered into strata by their negative literals, and each
+// stratum is computed by semi-naive iteration, so that a rule is only
+// joined against facts new in the previous iteration. Body literals are
+// joined in the order of the fewest candidate facts, found through indexes
+// on the arguments and on the children of arguments.
+// "distinct" and negative literals are checked once their variables are
+// bound, and "or" is expanded into several rules. Unsafe rules are ignored.
+// Input relations, such as "true" and "does" for a game state, can be
+// cleared along with everything derived from them and evaluated again.
+class DatalogEngine {
+public:
+  // With relaxes, negative literals are dropped so that the rules become
+  // monotone. Run() fails once more than max_facts facts are held.
+  // The profiler, if given, counts the rules on their clause indices.
+  explicit DatalogEngine(const bool relaxes, const std::size_t max_facts = SIZE_MAX, ClauseProfiler* profiler = nullptr);
+  DatalogEngine(const DatalogEngine&) = delete;
+  DatalogEngine& operator=(const DatalogEngine&) = delete;
+  TermStore& GetTermStore();
+  const TermStore& GetTermStore() const;
+  // Ground facts are inserted at once, rules are evaluated by Run()
+  void AddClause(const TreeNode& clause, const std::size_t clause_index = kNoClause);
+  // Id of the relation of a predicate, created if not used by any clause
+  std::size_t GetRelation(const std::string& name, const std::size_t arity);
+  // Must be called after the last clause and before the first Run().
+  // False if the rules recurse through negation.
+  bool Stratify();
+  // Relations that ClearInputs() clears along with those depending on them.
+  // Facts of the clauses in the cleared relations are inserted again.
+  void SetInputs(const std::vector<std::size_t>& relations);
+  void ClearInputs();
+  // The fact is the whole atom, e.g. (true (control r0)), and its relation
+  // must be an input or have no rules
+  void AddFact(const std::size_t relation, const TermId fact);
+  // Evaluates the rules of the relations changed since the last Run() until
+  // no new fact is derived. False if max_facts is exceeded.
+  bool Run();
+  const std::vector<TermId>& GetFacts(const std::size_t relation) const;
+  bool HasFact(const std::size_t relation, const TermId fact) const;
+  // Iterations of all the Run() calls
+  std::size_t GetIterationCount() const;
+  std::size_t GetFactCount() const;
+  // The arguments of the facts of a predicate, prefixed by head
+  std::vector<TreeNode> ToClauses(const std::string& name, const std::size_t arity, const std::string& head);
+private:
+  // Term with variables of a rule. Subterms without variables are
+  // constants, so lists have at least one variable.
+  struct Pattern {
+    enum class Kind {
+      kConstant,
+      kVariable,
+      kList
+    };
+    Kind kind;
+    TermId constant;
+    std::size_t variable;
+    std::vector<Pattern> children;
+  };
+  struct Literal {
+    std::size_t relation;
+    Pattern pattern;
+  };
+  // Literal of a clause body after expanding "or", negated by "not"
+  struct BodyLiteral {
+    const TreeNode* node;
+    bool negated;
+  };
+  struct Rule {
+    std::size_t clause_index;
+    std::size_t head_relation;
+    Pattern head;
+    std::vector<Literal> body;
+    std::vector<Literal> negatives;
+    std::vector<std::pair<Pattern, Pattern>> distincts;
+    // From negated "distinct"
+    std::vector<std::pair<Pattern, Pattern>> equals;
+    std::size_t variable_count;
+  };
+  // Facts of a predicate in the order derived. Facts before stable have
+  // been joined with each other, and those in [stable, delta_end) are the
+  // delta of the current iteration.
+  struct Relation {
+    std::vector<TermId> facts;
+    std::unordered_map<TermId, std::uint32_t> positions;
+    std::size_t arity;
+    // Fact positions in ascending order by GetIndexKey() of each argument,
+    // and of each child of the arguments that are lists, so that e.g.
+    // (true (cell ?x ?y b)) is looked up by b
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> index;
+    std::size_t stable;
+    std::size_t delta_end;
+    std::size_t stratum;
+    // Facts of the clauses, kept to be inserted again by ClearInputs()
+    std::vector<TermId> ground_facts;
+    // Relations with rules using this one
+    std::vector<std::size_t> dependents;
+    bool is_input;
+    // Changed since the last Run()
+    bool is_changed;
+  };
+  static std::uint64_t GetIndexKey(const std::size_t argument, const std::size_t child, const TermId term);
+  static std::uint64_t GetRelationKey(const TermId functor, const std::size_t arity);
+  std::vector<std::vector<BodyLiteral>> ExpandLiteral(const TreeNode& literal, const bool negated) const;
+  // Atoms such as "terminal" are predicates of arity 0.
+  // Returns false for forms that are not atomic formulas.
+  bool GetRelation(const TreeNode& atom, std::size_t& relation_id);
+  std::size_t GetRelation(const TermId functor, const std::size_t arity);
+  Pattern Compile(const TreeNode& node, std::unordered_map<std::string, std::size_t>& variables);
+  void AddRule(const TreeNode& head, const std::vector<BodyLiteral>& body, const std::size_t clause_index);
+  bool Match(const Pattern& pattern, const TermId term, std::vector<TermId>& bindings, std::vector<std::size_t>& trail) const;
+  // With interns false, kNoTerm when the term does not exist yet.
+  // All variables must be bound.
+  TermId Instantiate(const Pattern& pattern, const std::vector<TermId>& bindings, const bool interns);
+  static bool IsBound(const Pattern& pattern, const std::vector<TermId>& bindings);
+  bool Satisfies(const Rule& rule, const std::vector<TermId>& bindings);
+  void Insert(const std::size_t relation_id, const TermId fact);
+  void EvaluateStratum(const std::vector<const Rule*>& rules);
+  void Evaluate(const Rule& rule, const std::size_t delta_literal);
+  // Facts of the literal that Join() would visit
+  void GetRange(const std::size_t literal_index, const std::size_t delta_literal, const Relation& relation, std::size_t& begin, std::size_t& end) const;
+  // The next literal to join, the one with the fewest candidate facts
+  std::size_t ChooseLiteral(const Rule& rule, const std::size_t delta_literal, const std::vector<TermId>& bindings, const std::vector<bool>& joined);
+  // The smallest index entry for the bound arguments and children of
+  // arguments of the literal, or nullptr when nothing is bound.
+  // False when no fact can match.
+  bool FindPositions(const Literal& literal, const Relation& relation, const std::vector<TermId>& bindings, const std::vector<std::uint32_t>*& positions);
+  void Join(const Rule& rule, const std::size_t literal_index, const std::size_t delta_literal, std::vector<TermId>& bindings,
+      std::vector<std::size_t>& trail, std::vector<bool>& joined, std::uint64_t& tuples, std::uint64_t& probes);
+  template <class TryFact>
+  void JoinLiteral(const Literal& literal, const Relation& relation, const std::size_t begin, const std::size_t end, const std::vector<TermId>& bindings, TryFact try_fact);
+  const bool relaxes_;
+  TermStore store_;
+  std::vector<Relation> relations_;
+  std::unordered_map<std::uint64_t, std::size_t> relation_ids_;
+  std::vector<Rule> rules_;
+  // Rules of each stratum
+  std::vector<std::vector<const Rule*>> strata_;
+  const std::size_t max_facts_;
+  std::size_t fact_count_;
+  std::size_t iteration_count_;
+  bool overflows_;
+  ClauseProfiler* const profiler_;
+};
+
+}
+
+#endif /* DATALOG_HPP_ */
@@ -0,0 +1,214 @@
+#include "flat_document.hpp"
+
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+#include "tree_cursor.hpp"
+
+namespace sexpr_parser {
+
+FlatDocument::FlatDocument(const std::vector<TreeNode>& roots) :
+    arena_(), symbol_table_(), nodes_(), child_indices_(), roots_(), symbol_data_(), symbol_offsets_() {
+  Build(roots);
+}
+
+// Symbols are interned on the heap first, since their total size is only
+// known at the end, and then copied to the arena at their exact sizes
+FlatDocument::FlatDocument(const std::vector<TreeNode>& roots, const ArenaOptions& arena_options) :
+    arena_(new Arena(arena_options)),
+    symbol_table_(),
+    nodes_(arena_.get()),
+    child_indices_(arena_.get()),
+    roots_(arena_.get()),
+    symbol_data_(),
+    symbol_offsets_() {
+  Build(roots);
+  symbol_data_ = SymbolData(symbol_data_.begin(), symbol_data_.end(), arena_.get());
+  symbol_offsets_ = SymbolOffsetVector(symbol_offsets_.begin(), symbol_offsets_.end(), arena_.get());
+}
+
+FlatDocument::FlatDocument(const std::vector<TreeNode>& roots, SymbolTable& symbol_table) :
+    arena_(), symbol_table_(&symbol_table), nodes_(), child_indices_(), roots_(), symbol_data_(), symbol_offsets_() {
+  Build(roots);
+}
+
+FlatDocument::FlatDocument(const std::vector<TreeNode>& roots, SymbolTable& symbol_table, const ArenaOptions& arena_options) :
+    arena_(new Arena(arena_options)),
+    symbol_table_(&symbol_table),
+    nodes_(arena_.get()),
+    child_indices_(arena_.get()),
+    roots_(arena_.get()),
+    symbol_data_(),
+    symbol_offsets_() {
+  Build(roots);
+}
+
+void FlatDocument::Build(const std::vector<TreeNode>& roots) {
+  // Exact sizes, so that no array is reallocated
+  std::size_t num_nodes = 0;
+  std::size_t num_child_indices = 0;
+  for (TreeCursor cursor(roots); cursor.IsValid(); cursor.Next()) {
+    ++num_nodes;
+    num_child_indices += cursor.GetNode()->GetChildren().size();
+  }
+  nodes_.reserve(num_nodes);
+  child_indices_.reserve(num_child_indices);
+  roots_.reserve(roots.size());
+  // Children get contiguous slots of the child index array, reserved when
+  // their list is entered, before any of their descendants do. The cursor
+  // keeps the call stack flat for any nesting depth.
+  std::vector<std::uint32_t> child_offsets;
+  // Only needed while building, so that symbols are not kept twice
+  std::unordered_map<std::string, SymbolId> symbol_ids;
+  for (TreeCursor cursor(roots); cursor.IsValid(); cursor.Next()) {
+    const auto& node = *cursor.GetNode();
+    const auto index = static_cast<NodeIndex>(nodes_.size());
+    child_offsets.resize(cursor.GetDepth());
+    if (child_offsets.empty()) {
+      roots_.push_back(index);
+    } else {
+      child_indices_[child_offsets.back() + cursor.GetIndex()] = index;
+    }
+    if (node.IsLeaf()) {
+      nodes_.push_back(FlatNode{Intern(node.GetValue(), symbol_ids), 0, 0});
+      continue;
+    }
+    const auto child_offset = static_cast<std::uint32_t>(child_indices_.size());
+    nodes_.push_back(FlatNode{kNoSymbol, child_offset, static_cast<std::uint32_t>(node.GetChildren().size())});
+    child_indices_.resize(child_indices_.size() + node.GetChildren().size());
+    child_offsets.push_back(child_offset);
+  }
+  if (!symbol_table_) {
+    // Sentinel so that the length of the last symbol can be computed
+    symbol_offsets_.push_back(symbol_data_.size());
+  }
+}
+
+SymbolId FlatDocument::Intern(const std::string& value, std::unordered_map<std::string, SymbolId>& symbol_ids) {
+  if (symbol_table_) {
+    return symbol_table_->Intern(value);
+  }
+  const auto found = symbol_ids.find(value);
+  if (found != symbol_ids.end()) {
+    return found->second;
+  }
+  const auto symbol = static_cast<SymbolId>(symbol_offsets_.size());
+  symbol_offsets_.push_back(symbol_data_.size());
+  symbol_data_.append(value.data(), value.size());
+  symbol_data_.push_back('\0');
+  symbol_ids.emplace(value, symbol);
+  return symbol;
+}
+
+std::size_t FlatDocument::GetRootCount() const {
+  return roots_.size();
+}
+
+NodeIndex FlatDocument::GetRoot(const std::size_t index) const {
+  assert(index < roots_.size());
+  return roots_[index];
+}
+
+std::size_t FlatDocument::GetNodeCount() const {
+  return nodes_.size();
+}
+
+const FlatNode& FlatDocument::GetNode(const NodeIndex index) const {
+  assert(index < nodes_.size());
+  return nodes_[index];
+}
+
+const FlatNodeVector& FlatDocument::GetNodes() const {
+  return nodes_;
+}
+
+const NodeIndexVector& FlatDocument::GetChildIndices() const {
+  return child_indices_;
+}
+
+bool FlatDocument::IsLeaf(const NodeIndex index) const {
+  return GetNode(index).symbol != kNoSymbol;
+}
+
+std::size_t FlatDocument::GetChildCount(const NodeIndex index) const {
+  return GetNode(index).child_count;
+}
+
+NodeIndex FlatDocument::GetChild(const NodeIndex index, const std::size_t child_index) const {
+  const auto& node = GetNode(index);
+  assert(child_index < node.child_count);
+  return child_indices_[node.child_offset + child_index];
+}
+
+std::size_t FlatDocument::GetSymbolCount() const {
+  if (symbol_table_) {
+    return symbol_table_->GetSymbolCount();
+  }
+  return symbol_offsets_.size() - 1;
+}
+
+const char* FlatDocument::GetSymbol(const SymbolId symbol) const {
+  if (symbol_table_) {
+    return symbol_table_->GetSymbol(symbol);
+  }
+  assert(symbol < GetSymbolCount());
+  return symbol_data_.data() + symbol_offsets_[symbol];
+}
+
+std::size_t FlatDocument::GetSymbolLength(const SymbolId symbol) const {
+  if (symbol_table_) {
+    return symbol_table_->GetSymbolLength(symbol);
+  }
+  assert(symbol < GetSymbolCount());
+  // Excluding the terminating null character
+  return symbol_offsets_[symbol + 1] - symbol_offsets_[symbol] - 1;
+}
+
+// With an explicit stack, and subtrees are moved into their parents
+TreeNode FlatDocument::ToTreeNode(const NodeIndex index) const {
+  // Complete subtrees, the children built so far of each open list last
+  std::vector<TreeNode> subtrees;
+  // Lists being rebuilt with the number of their children entered
+  std::vector<std::pair<NodeIndex, std::uint32_t>> open_lists;
+  auto current = index;
+  for (;;) {
+    const auto& node = GetNode(current);
+    if (node.symbol != kNoSymbol) {
+      subtrees.push_back(TreeNode(std::string(GetSymbol(node.symbol), GetSymbolLength(node.symbol))));
+    } else {
+      open_lists.emplace_back(current, 0);
+    }
+    while (!open_lists.empty() && open_lists.back().second == GetNode(open_lists.back().first).child_count) {
+      const auto first_child = subtrees.end() - open_lists.back().second;
+      std::vector<TreeNode> children(std::make_move_iterator(first_child), std::make_move_iterator(subtrees.end()));
+      subtrees.erase(first_child, subtrees.end());
+      subtrees.push_back(TreeNode(std::move(children)));
+      open_lists.pop_back();
+    }
+    if (open_lists.empty()) {
+      return std::move(subtrees.back());
+    }
+    auto& list = open_lists.back();
+    current = child_indices_[GetNode(list.first).child_offset + list.second++];
+  }
+}
+
+std::vector<TreeNode> FlatDocument::ToTreeNodes() const {
+  std::vector<TreeNode> results;
+  results.reserve(roots_.size());
+  for (const auto root : roots_) {
+    results.push_back(ToTreeNode(root));
+  }
+  return results;
+}
+
+const Arena* FlatDocument::GetArena() const {
+  return arena_.get();
+}
+
+const SymbolTable* FlatDocument::GetSymbolTable() const {
+  return symbol_table_;
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef FLAT_DOCUMENT_HPP_
+#define FLAT_DOCUMENT_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.hpp"
+#include "sexpr_parser.hpp"
+#include "symbol_table.hpp"
+
+namespace sexpr_parser {
+
+using NodeIndex = std::uint32_t;
+
+// Node of FlatDocument.
+// Leaves have a symbol, and non-leaves have their child indices stored in
+// a contiguous range of the document's child index array.
+struct FlatNode {
+  SymbolId symbol;
+  std::uint32_t child_offset;
+  std::uint32_t child_count;
+};
+
+using FlatNodeVector = std::vector<FlatNode, ArenaAllocator<FlatNode>>;
+using NodeIndexVector = std::vector<NodeIndex, ArenaAllocator<NodeIndex>>;
+
+// Immutable tree stored in a few contiguous arrays.
+// Nodes are numbered in pre-order, each distinct leaf value is stored once
+// as a null-terminated string, and all of it is released at once.
+// With arena options, the arrays are placed in an arena of the document,
+// e.g. on huge pages of the NUMA node of the thread that builds it.
+// With a symbol table, symbols are interned there instead, so that symbol
+// ids are shared with the other documents of the table, which must outlive
+// the document.
+class FlatDocument {
+public:
+  explicit FlatDocument(const std::vector<TreeNode>& roots);
+  FlatDocument(const std::vector<TreeNode>& roots, const ArenaOptions& arena_options);
+  FlatDocument(const std::vector<TreeNode>& roots, SymbolTable& symbol_table);
+  FlatDocument(const std::vector<TreeNode>& roots, SymbolTable& symbol_table, const ArenaOptions& arena_options);
+  std::size_t GetRootCount() const;
+  NodeIndex GetRoot(const std::size_t index) const;
+  std::size_t GetNodeCount() const;
+  const FlatNode& GetNode(const NodeIndex index) const;
+  const FlatNodeVector& GetNodes() const;
+  const NodeIndexVector& GetChildIndices() const;
+  bool IsLeaf(const NodeIndex index) const;
+  std::size_t GetChildCount(const NodeIndex index) const;
+  NodeIndex GetChild(const NodeIndex index, const std::size_t child_index) const;
+  std::size_t GetSymbolCount() const;
+  const char* GetSymbol(const SymbolId symbol) const;
+  std::size_t GetSymbolLength(const SymbolId symbol) const;
+  TreeNode ToTreeNode(const NodeIndex index) const;
+  std::vector<TreeNode> ToTreeNodes() const;
+  // nullptr without arena options
+  const Arena* GetArena() const;
+  // nullptr for symbols of the document's own
+  const SymbolTable* GetSymbolTable() const;
+private:
+  using SymbolData = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+  using SymbolOffsetVector = std::vector<std::uint32_t, ArenaAllocator<std::uint32_t>>;
+  void Build(const std::vector<TreeNode>& roots);
+  SymbolId Intern(const std::string& value, std::unordered_map<std::string, SymbolId>& symbol_ids);
+  // Declared first so that it outlives the arrays
+  std::unique_ptr<Arena> arena_;
+  SymbolTable* const symbol_table_;
+  FlatNodeVector nodes_;
+  NodeIndexVector child_indices_;
+  NodeIndexVector roots_;
+  SymbolData symbol_data_;
+  SymbolOffsetVector symbol_offsets_;
+};
+
+}
+
+#endif /* FLAT_DOCUMENT_HPP_ */
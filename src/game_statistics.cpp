@@ -0,0 +1,286 @@
+#include "game_statistics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "tree_writers.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+struct Playout {
+  std::size_t index;
+  std::size_t length;
+  bool completes;
+  std::size_t states;
+  std::size_t simultaneous_states;
+  // Sums over the states, for the averages of the playout
+  std::vector<std::size_t> legal_move_sums;
+  double joint_move_sum;
+  std::vector<int> goals;
+};
+
+Estimate EstimateMean(const std::vector<double>& samples) {
+  Estimate estimate;
+  estimate.count = samples.size();
+  if (samples.empty()) {
+    return estimate;
+  }
+  double sum = 0;
+  for (const auto sample : samples) {
+    sum += sample;
+  }
+  estimate.mean = sum / samples.size();
+  if (samples.size() > 1) {
+    double squares = 0;
+    for (const auto sample : samples) {
+      squares += (sample - estimate.mean) * (sample - estimate.mean);
+    }
+    estimate.margin = 1.96 * std::sqrt(squares / (samples.size() - 1) / samples.size());
+  }
+  return estimate;
+}
+
+Playout RunPlayout(StateMachine& machine, const std::size_t index, const GameStatisticsOptions& options) {
+  const auto role_count = machine.GetRoleCount();
+  Playout playout;
+  playout.index = index;
+  playout.length = 0;
+  playout.completes = true;
+  playout.states = 0;
+  playout.simultaneous_states = 0;
+  playout.legal_move_sums.assign(role_count, 0);
+  playout.joint_move_sum = 0;
+  std::mt19937_64 random(options.seed + index);
+  auto state = machine.GetInitialState();
+  std::vector<GameMove> moves(role_count);
+  while (!machine.IsTerminal(state)) {
+    if (playout.length >= options.max_length) {
+      playout.completes = false;
+      return playout;
+    }
+    std::size_t choosing_roles = 0;
+    double joint_moves = 1;
+    for (std::size_t i = 0; i < role_count; ++i) {
+      const auto legal_moves = machine.GetLegalMoves(state, i);
+      if (legal_moves.empty()) {
+        playout.completes = false;
+        return playout;
+      }
+      playout.legal_move_sums[i] += legal_moves.size();
+      joint_moves *= legal_moves.size();
+      if (legal_moves.size() > 1) {
+        ++choosing_roles;
+      }
+      moves[i] = legal_moves[std::uniform_int_distribution<std::size_t>(0, legal_moves.size() - 1)(random)];
+    }
+    ++playout.states;
+    playout.joint_move_sum += joint_moves;
+    if (choosing_roles > 1) {
+      ++playout.simultaneous_states;
+    }
+    state = machine.GetNextState(state, moves);
+    ++playout.length;
+  }
+  for (std::size_t i = 0; i < role_count; ++i) {
+    playout.goals.push_back(machine.GetGoal(state, i));
+  }
+  return playout;
+}
+
+void WriteEstimate(std::ostream& o, const Estimate& estimate) {
+  o << "{\"mean\":" << estimate.mean << ",\"margin\":" << estimate.margin << ",\"count\":" << estimate.count << '}';
+}
+
+}
+
+GameStatisticsOptions::GameStatisticsOptions() :
+    num_threads(0),
+    time_limit(1),
+    max_playouts(SIZE_MAX),
+    max_length(1000),
+    seed(1) {
+}
+
+Estimate::Estimate() : mean(0), margin(0), count(0) {
+}
+
+RoleStatistics::RoleStatistics() : name(), branching_factor(), goal(), goal_counts() {
+}
+
+GameStatistics::GameStatistics() :
+    fingerprint(), playouts(0), incomplete_playouts(0), states(0), length(), min_length(0), max_length(0), roles(),
+    joint_branching_factor(), simultaneous_fraction(0), is_simultaneous(false), seconds(0) {
+}
+
+// FNV-1a of the sorted clauses, so that reordering the clauses or their
+// formatting does not change it
+std::string GetGameFingerprint(const std::vector<TreeNode>& clauses) {
+  std::vector<std::string> sexprs;
+  sexprs.reserve(clauses.size());
+  for (const auto& clause : clauses) {
+    sexprs.push_back(clause.ToSexpr());
+  }
+  std::sort(sexprs.begin(), sexprs.end());
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const auto& sexpr : sexprs) {
+    for (const auto c : sexpr) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    hash = (hash ^ '\n') * 0x100000001b3ULL;
+  }
+  static const char hex_digits[] = "0123456789abcdef";
+  std::string fingerprint(16, '0');
+  for (auto i = 15; i >= 0; --i, hash >>= 4) {
+    fingerprint[i] = hex_digits[hash & 0xf];
+  }
+  return fingerprint;
+}
+
+void SampleGameStatistics(const StateMachineFactory& factory, const GameStatisticsOptions& options, GameStatistics& statistics) {
+  assert(options.time_limit > 0 || options.max_playouts < SIZE_MAX);
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.time_limit));
+  auto num_threads = options.num_threads;
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::max<std::size_t>(1, std::min(num_threads, options.max_playouts));
+  std::atomic<std::size_t> next_index(0);
+  std::mutex mutex;
+  std::vector<Playout> playouts;
+  std::vector<std::string> role_names;
+  const auto work = [&]() {
+    auto machine = factory();
+    std::vector<Playout> local_playouts;
+    for (;;) {
+      if (options.time_limit > 0 && std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+      const auto index = next_index++;
+      if (index >= options.max_playouts) {
+        break;
+      }
+      local_playouts.push_back(RunPlayout(*machine, index, options));
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (role_names.empty()) {
+      for (std::size_t i = 0; i < machine->GetRoleCount(); ++i) {
+        role_names.push_back(machine->GetRoleName(i));
+      }
+    }
+    playouts.insert(playouts.end(), local_playouts.begin(), local_playouts.end());
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // In the order of the playouts, so that sums are the same for any threads
+  std::sort(playouts.begin(), playouts.end(), [](const Playout& left, const Playout& right) {
+    return left.index < right.index;
+  });
+  statistics.playouts = playouts.size();
+  statistics.incomplete_playouts = 0;
+  statistics.states = 0;
+  statistics.min_length = SIZE_MAX;
+  statistics.max_length = 0;
+  statistics.roles.assign(role_names.size(), RoleStatistics());
+  std::size_t simultaneous_states = 0;
+  std::vector<double> lengths;
+  std::vector<double> joint_branching_factors;
+  std::vector<std::vector<double>> branching_factors(role_names.size());
+  std::vector<std::vector<double>> goals(role_names.size());
+  for (const auto& playout : playouts) {
+    statistics.states += playout.states;
+    simultaneous_states += playout.simultaneous_states;
+    if (playout.states > 0) {
+      joint_branching_factors.push_back(playout.joint_move_sum / playout.states);
+      for (std::size_t i = 0; i < role_names.size(); ++i) {
+        branching_factors[i].push_back(static_cast<double>(playout.legal_move_sums[i]) / playout.states);
+      }
+    }
+    if (!playout.completes) {
+      ++statistics.incomplete_playouts;
+      continue;
+    }
+    lengths.push_back(playout.length);
+    statistics.min_length = std::min(statistics.min_length, playout.length);
+    statistics.max_length = std::max(statistics.max_length, playout.length);
+    for (std::size_t i = 0; i < role_names.size(); ++i) {
+      ++statistics.roles[i].goal_counts[playout.goals[i]];
+      if (playout.goals[i] >= 0) {
+        goals[i].push_back(playout.goals[i]);
+      }
+    }
+  }
+  if (lengths.empty()) {
+    statistics.min_length = 0;
+  }
+  statistics.length = EstimateMean(lengths);
+  statistics.joint_branching_factor = EstimateMean(joint_branching_factors);
+  for (std::size_t i = 0; i < role_names.size(); ++i) {
+    statistics.roles[i].name = role_names[i];
+    statistics.roles[i].branching_factor = EstimateMean(branching_factors[i]);
+    statistics.roles[i].goal = EstimateMean(goals[i]);
+  }
+  statistics.simultaneous_fraction = statistics.states > 0 ? static_cast<double>(simultaneous_states) / statistics.states : 0;
+  statistics.is_simultaneous = simultaneous_states > 0;
+  statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool SampleGameStatistics(const std::vector<TreeNode>& clauses, const GameStatisticsOptions& options, GameStatistics& statistics) {
+  if (!DatalogStateMachine(clauses).IsValid()) {
+    return false;
+  }
+  SampleGameStatistics([&]() {
+    return std::unique_ptr<StateMachine>(new DatalogStateMachine(clauses));
+  }, options, statistics);
+  statistics.fingerprint = GetGameFingerprint(clauses);
+  return true;
+}
+
+void WriteGameStatisticsJSON(std::ostream& o, const GameStatistics& statistics) {
+  o << "{\"fingerprint\":";
+  WriteJSON(o, TreeNode(statistics.fingerprint));
+  o << ",\"playouts\":" << statistics.playouts;
+  o << ",\"incomplete_playouts\":" << statistics.incomplete_playouts;
+  o << ",\"states\":" << statistics.states;
+  o << ",\"length\":";
+  WriteEstimate(o, statistics.length);
+  o << ",\"min_length\":" << statistics.min_length;
+  o << ",\"max_length\":" << statistics.max_length;
+  o << ",\"joint_branching_factor\":";
+  WriteEstimate(o, statistics.joint_branching_factor);
+  o << ",\"simultaneous_fraction\":" << statistics.simultaneous_fraction;
+  o << ",\"is_simultaneous\":" << (statistics.is_simultaneous ? "true" : "false");
+  o << ",\"seconds\":" << statistics.seconds;
+  o << ",\"roles\":[";
+  for (std::size_t i = 0; i < statistics.roles.size(); ++i) {
+    const auto& role = statistics.roles[i];
+    o << (i > 0 ? ",{\"name\":" : "{\"name\":");
+    WriteJSON(o, TreeNode(role.name));
+    o << ",\"branching_factor\":";
+    WriteEstimate(o, role.branching_factor);
+    o << ",\"goal\":";
+    WriteEstimate(o, role.goal);
+    o << ",\"goal_counts\":{";
+    for (auto j = role.goal_counts.begin(); j != role.goal_counts.end(); ++j) {
+      o << (j != role.goal_counts.begin() ? ",\"" : "\"") << j->first << "\":" << j->second;
+    }
+    o << "}}";
+  }
+  o << "]}";
+}
+
+}
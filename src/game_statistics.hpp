@@ -0,0 +1,96 @@
+#ifndef GAME_STATISTICS_HPP_
+#define GAME_STATISTICS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+#include "state_machine.hpp"
+
+namespace sexpr_parser {
+
+struct GameStatisticsOptions {
+  GameStatisticsOptions();
+  // 0 means the hardware concurrency
+  std::size_t num_threads;
+  // Playouts are started until this many seconds have passed, 0 means no
+  // limit. A playout already started is finished.
+  double time_limit;
+  std::size_t max_playouts;
+  // Playouts are cut off after this many steps
+  std::size_t max_length;
+  // Playout i chooses its moves with a generator seeded by seed + i, so
+  // that the results do not depend on the threads without a time limit
+  std::uint64_t seed;
+};
+
+// Sample mean with the half width of its 95% confidence interval by the
+// normal approximation, 0 for fewer than two samples
+struct Estimate {
+  Estimate();
+  double mean;
+  double margin;
+  std::size_t count;
+};
+
+struct RoleStatistics {
+  RoleStatistics();
+  std::string name;
+  // Legal moves in the states of a playout, one sample per playout
+  Estimate branching_factor;
+  // Over the complete playouts
+  Estimate goal;
+  // Complete playouts ending with each goal value, -1 for none
+  std::map<int, std::size_t> goal_counts;
+};
+
+struct GameStatistics {
+  GameStatistics();
+  // GetGameFingerprint() of the rules, so that stored statistics can be
+  // matched with the game
+  std::string fingerprint;
+  std::size_t playouts;
+  // Playouts cut off at max_length or reaching a state where a role has no
+  // legal move, which are left out of length and goals
+  std::size_t incomplete_playouts;
+  // Non-terminal states visited
+  std::size_t states;
+  // Steps of the complete playouts
+  Estimate length;
+  std::size_t min_length;
+  std::size_t max_length;
+  std::vector<RoleStatistics> roles;
+  // Joint moves, the product of the legal moves of the roles, one sample
+  // per playout
+  Estimate joint_branching_factor;
+  // Fraction of the visited states where more than one role has a choice
+  double simultaneous_fraction;
+  // Whether such a state was visited at all, as opposed to turn-taking
+  bool is_simultaneous;
+  double seconds;
+};
+
+using StateMachineFactory = std::function<std::unique_ptr<StateMachine>()>;
+
+// Order-independent hash of the clauses as hex digits
+std::string GetGameFingerprint(const std::vector<TreeNode>& clauses);
+
+// Estimates the statistics of a game by uniformly random playouts, run in
+// parallel with one state machine per thread.
+// The fingerprint is left to the caller.
+void SampleGameStatistics(const StateMachineFactory& factory, const GameStatisticsOptions& options, GameStatistics& statistics);
+// With DatalogStateMachine. False if the rules are not a valid game for it.
+bool SampleGameStatistics(const std::vector<TreeNode>& clauses, const GameStatisticsOptions& options, GameStatistics& statistics);
+
+// One JSON object, with goal_counts keyed by the goal values
+void WriteGameStatisticsJSON(std::ostream& o, const GameStatistics& statistics);
+
+}
+
+#endif /* GAME_STATISTICS_HPP_ */
@@ -0,0 +1,232 @@
+#include "gdl_generator.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace sexpr_parser {
+
+namespace {
+
+class GameWriter {
+public:
+  GameWriter(const GameGeneratorOptions& options) : options_(options), random_(options.seed), arities_(), o_() {
+  }
+  std::string Write() {
+    o_ << "; Synthetic game generated with seed " << options_.seed << '\n';
+    WriteFacts();
+    WriteRules();
+    for (std::size_t i = 0; i < options_.num_predicates; ++i) {
+      arities_.push_back(Choose(options_.max_arity + 1));
+      for (std::size_t j = 0; j < options_.rules_per_predicate; ++j) {
+        WriteViewRule(i);
+      }
+    }
+    return o_.str();
+  }
+private:
+  // std::mt19937 is portable, but the standard distributions are not
+  std::size_t Choose(const std::size_t n) {
+    return random_() % n;
+  }
+  std::string GetRole(const std::size_t index) const {
+    return "r" + std::to_string(index);
+  }
+  void WriteFacts() {
+    for (std::size_t i = 0; i < options_.num_roles; ++i) {
+      o_ << "(role " << GetRole(i) << ")\n";
+    }
+    for (std::size_t i = 0; i < options_.num_roles; ++i) {
+      o_ << "(nextrole " << GetRole(i) << ' ' << GetRole((i + 1) % options_.num_roles) << ")\n";
+    }
+    for (std::size_t i = 1; i <= options_.board_size; ++i) {
+      o_ << "(index " << i << ")\n";
+    }
+    for (std::size_t i = 1; i < options_.board_size; ++i) {
+      o_ << "(succ " << i << ' ' << i + 1 << ")\n";
+    }
+    for (std::size_t x = 1; x <= options_.board_size; ++x) {
+      for (std::size_t y = 1; y <= options_.board_size; ++y) {
+        o_ << "(init (cell " << x << ' ' << y << " b))\n";
+      }
+    }
+    o_ << "(init (control " << GetRole(0) << "))\n";
+  }
+  void WriteRules() {
+    o_ << "; Moves\n";
+    o_ << "(<= (legal ?r (mark ?x ?y)) (true (control ?r)) (true (cell ?x ?y b)))\n";
+    o_ << "(<= (legal ?r noop) (role ?r) (not (true (control ?r))))\n";
+    o_ << "(<= (next (cell ?x ?y ?r)) (does ?r (mark ?x ?y)))\n";
+    o_ << "(<= (next (cell ?x ?y ?c)) (true (cell ?x ?y ?c)) (not (marked ?x ?y)))\n";
+    o_ << "(<= (marked ?x ?y) (does ?r (mark ?x ?y)))\n";
+    o_ << "(<= (next (control ?n)) (true (control ?r)) (nextrole ?r ?n))\n";
+    o_ << "; Termination\n";
+    o_ << "(<= open (true (cell ?x ?y b)))\n";
+    o_ << "(<= terminal (not open))\n";
+    o_ << "(<= (goal ?r 100) (role ?r) (true (cell 1 1 ?r)))\n";
+    o_ << "(<= (goal ?r 0) (role ?r) (not (true (cell 1 1 ?r))))\n";
+    if (options_.recursion) {
+      o_ << "(<= (reach ?x ?y) (succ ?x ?y))\n";
+      o_ << "(<= (reach ?x ?z) (succ ?x ?y) (reach ?y ?z))\n";
+    }
+  }
+  std::string GetVariable(const std::size_t index) const {
+    return "?v" + std::to_string(index);
+  }
+  // Chooses a variable of the pool and marks it bound
+  std::string BindVariable(std::vector<bool>& bound) {
+    const auto index = Choose(bound.size());
+    bound[index] = true;
+    return GetVariable(index);
+  }
+  std::string ChooseBoundVariable(const std::vector<bool>& bound) {
+    std::vector<std::size_t> candidates;
+    for (std::size_t i = 0; i < bound.size(); ++i) {
+      if (bound[i]) {
+        candidates.push_back(i);
+      }
+    }
+    return GetVariable(candidates[Choose(candidates.size())]);
+  }
+  // Only views defined before index are used, so that there are no cycles
+  // and negation is stratified
+  void WriteViewLiteral(const std::size_t index, std::vector<bool>& bound, const bool binds) {
+    const auto arity = arities_[index];
+    if (arity == 0) {
+      o_ << "view" << index;
+      return;
+    }
+    o_ << "(view" << index;
+    for (std::size_t i = 0; i < arity; ++i) {
+      o_ << ' ' << (binds ? BindVariable(bound) : ChooseBoundVariable(bound));
+    }
+    o_ << ')';
+  }
+  // The first literal is never a view, which may have no arguments to bind
+  void WritePositiveLiteral(const std::size_t view_index, std::vector<bool>& bound, const bool is_first) {
+    const auto num_kinds = is_first ? 3 : 3 + (options_.recursion ? 1 : 0) + (view_index > 0 ? 1 : 0);
+    auto kind = Choose(num_kinds);
+    if (kind == 3 && !options_.recursion) {
+      kind = 4;
+    }
+    o_ << ' ';
+    switch (kind) {
+    case 0:
+      o_ << "(true (cell " << BindVariable(bound) << ' ' << BindVariable(bound) << ' ';
+      o_ << (Choose(2) == 0 ? std::string("b") : BindVariable(bound)) << "))";
+      break;
+    case 1:
+      o_ << "(index " << BindVariable(bound) << ')';
+      break;
+    case 2:
+      o_ << "(succ " << BindVariable(bound) << ' ' << BindVariable(bound) << ')';
+      break;
+    case 3:
+      o_ << "(reach " << BindVariable(bound) << ' ' << BindVariable(bound) << ')';
+      break;
+    default:
+      WriteViewLiteral(Choose(view_index), bound, true);
+      break;
+    }
+  }
+  // Variables in the head, in negations and in distinct always appear in a
+  // positive literal, as GDL requires
+  void WriteViewRule(const std::size_t index) {
+    std::vector<bool> bound(std::max<std::size_t>(2, options_.rule_width), false);
+    const auto width = std::max<std::size_t>(1, options_.rule_width);
+    const auto negates = index > 0 && width >= 2 && Choose(3) == 0;
+    const auto has_distinct = width >= 3 && Choose(3) == 0;
+    const auto num_positives = std::max<std::size_t>(1, width - (negates ? 1 : 0) - (has_distinct ? 1 : 0));
+    std::ostringstream body;
+    o_.swap(body);
+    for (std::size_t i = 0; i < num_positives; ++i) {
+      WritePositiveLiteral(index, bound, i == 0);
+    }
+    if (negates) {
+      o_ << " (not ";
+      WriteViewLiteral(Choose(index), bound, false);
+      o_ << ')';
+    }
+    if (has_distinct) {
+      const auto first = ChooseBoundVariable(bound);
+      auto second = ChooseBoundVariable(bound);
+      // A few tries for two different variables, which may not exist
+      for (auto i = 0; i < 4 && second == first; ++i) {
+        second = ChooseBoundVariable(bound);
+      }
+      o_ << " (distinct " << first << ' ' << second << ')';
+    }
+    o_.swap(body);
+    o_ << "(<= ";
+    if (arities_[index] == 0) {
+      o_ << "view" << index;
+    } else {
+      o_ << "(view" << index;
+      for (std::size_t i = 0; i < arities_[index]; ++i) {
+        o_ << ' ';
+        for (std::size_t j = 0; j < options_.nesting_depth; ++j) {
+          o_ << "(f ";
+        }
+        o_ << ChooseBoundVariable(bound) << std::string(options_.nesting_depth, ')');
+      }
+      o_ << ')';
+    }
+    o_ << body.str() << ")\n";
+  }
+  const GameGeneratorOptions& options_;
+  std::mt19937 random_;
+  std::vector<std::size_t> arities_;
+  std::ostringstream o_;
+};
+
+}
+
+GameGeneratorOptions::GameGeneratorOptions() :
+    num_roles(2),
+    board_size(3),
+    num_predicates(8),
+    max_arity(3),
+    rules_per_predicate(2),
+    rule_width(3),
+    recursion(true),
+    nesting_depth(0),
+    seed(1) {
+}
+
+std::string GenerateGame(const GameGeneratorOptions& options) {
+  return GameWriter(options).Write();
+}
+
+std::string GenerateDeeplyNestedTerm(const std::size_t depth) {
+  std::string sexpr;
+  sexpr.reserve(depth * 4 + 1);
+  for (std::size_t i = 0; i < depth; ++i) {
+    sexpr += "(f ";
+  }
+  sexpr += 'a';
+  sexpr.append(depth, ')');
+  return sexpr;
+}
+
+std::string GenerateWideRule(const std::size_t width) {
+  std::ostringstream o;
+  o << "(<= (wide ?x0 ?x" << width << ')';
+  for (std::size_t i = 0; i < width; ++i) {
+    o << " (succ ?x" << i << " ?x" << i + 1 << ')';
+  }
+  o << ')';
+  return o.str();
+}
+
+std::string GenerateRepeatedVariableRule(const std::size_t width) {
+  std::string rule = "(<= (h ?x) (p";
+  rule.reserve(rule.size() + width * 3 + 2);
+  for (std::size_t i = 0; i < width; ++i) {
+    rule += " ?x";
+  }
+  rule += "))";
+  return rule;
+}
+
+}
@@ -0,0 +1,44 @@
+#ifndef GDL_GENERATOR_HPP_
+#define GDL_GENERATOR_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace sexpr_parser {
+
+struct GameGeneratorOptions {
+  GameGeneratorOptions();
+  std::size_t num_roles;
+  // Cells of a board_size x board_size board are the fluents
+  std::size_t board_size;
+  // Additional view predicates view0, view1, ... of random arities
+  std::size_t num_predicates;
+  std::size_t max_arity;
+  std::size_t rules_per_predicate;
+  // Body literals per view rule
+  std::size_t rule_width;
+  // Adds the recursive reach/2 over the successor relation, used by views
+  bool recursion;
+  // View heads wrap their arguments in this many nested function terms
+  std::size_t nesting_depth;
+  unsigned seed;
+};
+
+// Returns the KIF of a valid game: roles, init, legal, next, terminal and
+// goal rules, safe and stratified view rules, and a few comments. The same
+// options always give the same text.
+// Players take turns marking empty cells; the game ends when the board is
+// full.
+std::string GenerateGame(const GameGeneratorOptions& options = GameGeneratorOptions());
+
+// Adversarial inputs: "(f (f ... (f a)))" with depth lists, one rule
+// whose body is a chain of width successor literals, and one rule with a
+// variable at width argument positions, whose same-domain argument pairs
+// grow quadratically
+std::string GenerateDeeplyNestedTerm(const std::size_t depth);
+std::string GenerateWideRule(const std::size_t width);
+std::string GenerateRepeatedVariableRule(const std::size_t width);
+
+}
+
+#endif /* GDL_GENERATOR_HPP_ */
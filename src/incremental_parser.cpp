@@ -0,0 +1,153 @@
+#include "incremental_parser.hpp"
+#include "sexpr_scanner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+namespace sexpr_parser {
+
+namespace {
+
+using scanner::MakeList;
+
+std::size_t SkipGap(const std::string& text, const std::size_t pos) {
+  return scanner::SkipGap(text.data(), pos, text.size());
+}
+
+// Also the end of a top-level ")" atom
+std::size_t SkipAtom(const std::string& text, const std::size_t pos) {
+  return scanner::SkipAtom(text.data(), pos, text.size());
+}
+
+}
+
+IncrementalParser::IncrementalParser(const std::string& text, const bool flatten_tuple_with_one_child) :
+    flatten_tuple_with_one_child_(flatten_tuple_with_one_child),
+    text_(text),
+    forms_(),
+    spans_(),
+    scanned_forms_(),
+    scanned_spans_() {
+  std::size_t pos = 0;
+  while (ScanForm(pos)) {
+  }
+  forms_.swap(scanned_forms_);
+  spans_.swap(scanned_spans_);
+}
+
+// Parses the next top-level form from pos, if any, and appends it to the
+// scanned forms
+bool IncrementalParser::ScanForm(std::size_t& pos) {
+  pos = SkipGap(text_, pos);
+  if (pos >= text_.size()) {
+    return false;
+  }
+  const auto begin = pos;
+  if (text_[pos] != '(') {
+    // Atom, or unmatched ")" which is a token as in Parse()
+    pos = SkipAtom(text_, pos);
+    scanned_forms_.push_back(TreeNode(text_.substr(begin, pos - begin)));
+    scanned_spans_.push_back(FormSpan{begin, pos});
+    return true;
+  }
+  std::vector<std::vector<TreeNode>> frames;
+  frames.emplace_back();
+  ++pos;
+  while (!frames.empty()) {
+    pos = SkipGap(text_, pos);
+    if (pos >= text_.size()) {
+      break;
+    }
+    if (text_[pos] == '(') {
+      frames.emplace_back();
+      ++pos;
+    } else if (text_[pos] == ')') {
+      auto children = std::move(frames.back());
+      frames.pop_back();
+      ++pos;
+      if (frames.empty()) {
+        scanned_forms_.push_back(MakeList(std::move(children), flatten_tuple_with_one_child_));
+      } else {
+        frames.back().push_back(MakeList(std::move(children), flatten_tuple_with_one_child_));
+      }
+    } else {
+      const auto token_begin = pos;
+      pos = SkipAtom(text_, pos);
+      frames.back().push_back(TreeNode(text_.substr(token_begin, pos - token_begin)));
+    }
+  }
+  // Close lists left open at the end of the text
+  while (!frames.empty()) {
+    auto children = std::move(frames.back());
+    frames.pop_back();
+    if (frames.empty()) {
+      scanned_forms_.push_back(MakeList(std::move(children), flatten_tuple_with_one_child_));
+    } else {
+      frames.back().push_back(MakeList(std::move(children), flatten_tuple_with_one_child_));
+    }
+  }
+  scanned_spans_.push_back(FormSpan{begin, pos});
+  return true;
+}
+
+FormChange IncrementalParser::Edit(const std::size_t offset, const std::size_t removed_length, const std::string& inserted) {
+  assert(offset + removed_length <= text_.size());
+  text_.replace(offset, removed_length, inserted);
+  const auto old_edit_end = offset + removed_length;
+  const auto new_edit_end = offset + inserted.size();
+  // Forms ending before the edit are kept. A form ending exactly at the edit
+  // is re-parsed, since its last token may be extended.
+  const auto first = static_cast<std::size_t>(std::distance(spans_.begin(),
+      std::lower_bound(spans_.begin(), spans_.end(), offset, [](const FormSpan& span, const std::size_t pos) {
+        return span.end < pos;
+      })));
+  // Text between forms is always outside lists and comments
+  auto pos = first > 0 ? spans_[first - 1].end : 0;
+  auto last = first;
+  scanned_forms_.clear();
+  scanned_spans_.clear();
+  for (;;) {
+    pos = SkipGap(text_, pos);
+    if (pos >= text_.size()) {
+      last = spans_.size();
+      break;
+    }
+    if (pos >= new_edit_end) {
+      // The rest is unchanged once a form after the edit starts where it did
+      while (last < spans_.size() && (spans_[last].begin < old_edit_end || spans_[last].begin - old_edit_end + new_edit_end < pos)) {
+        ++last;
+      }
+      if (last < spans_.size() && spans_[last].begin - old_edit_end + new_edit_end == pos) {
+        break;
+      }
+    }
+    ScanForm(pos);
+  }
+  // Shift the spans of the forms kept after the edit
+  for (auto i = last; i < spans_.size(); ++i) {
+    spans_[i].begin = spans_[i].begin - old_edit_end + new_edit_end;
+    spans_[i].end = spans_[i].end - old_edit_end + new_edit_end;
+  }
+  const FormChange change{first, last - first, scanned_forms_.size()};
+  forms_.erase(forms_.begin() + first, forms_.begin() + last);
+  forms_.insert(forms_.begin() + first, std::make_move_iterator(scanned_forms_.begin()), std::make_move_iterator(scanned_forms_.end()));
+  spans_.erase(spans_.begin() + first, spans_.begin() + last);
+  spans_.insert(spans_.begin() + first, scanned_spans_.begin(), scanned_spans_.end());
+  return change;
+}
+
+const std::string& IncrementalParser::GetText() const {
+  return text_;
+}
+
+const std::vector<TreeNode>& IncrementalParser::GetForms() const {
+  return forms_;
+}
+
+const std::vector<FormSpan>& IncrementalParser::GetSpans() const {
+  return spans_;
+}
+
+}
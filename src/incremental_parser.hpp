@@ -0,0 +1,53 @@
+#ifndef INCREMENTAL_PARSER_HPP_
+#define INCREMENTAL_PARSER_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Range of text occupied by a top-level form, from its first character to
+// one past its last
+struct FormSpan {
+  std::size_t begin;
+  std::size_t end;
+};
+
+// Forms [first_form, first_form + removed_count) before an edit were
+// replaced by forms [first_form, first_form + inserted_count) after it.
+// All other forms are unchanged.
+struct FormChange {
+  std::size_t first_form;
+  std::size_t removed_count;
+  std::size_t inserted_count;
+};
+
+// Keeps a text and its top-level forms up to date under edits.
+// An edit re-parses only from the end of the last form before it until the
+// first untouched form after it, and the other forms are kept as they are.
+// Comments and unbalanced parens are handled as in Parse(), except that
+// unclosed parens at the end of the text are closed implicitly.
+class IncrementalParser {
+public:
+  explicit IncrementalParser(const std::string& text = "", const bool flatten_tuple_with_one_child = false);
+  FormChange Edit(const std::size_t offset, const std::size_t removed_length, const std::string& inserted);
+  const std::string& GetText() const;
+  const std::vector<TreeNode>& GetForms() const;
+  const std::vector<FormSpan>& GetSpans() const;
+private:
+  bool ScanForm(std::size_t& pos);
+  const bool flatten_tuple_with_one_child_;
+  std::string text_;
+  std::vector<TreeNode> forms_;
+  std::vector<FormSpan> spans_;
+  // Output of ScanForm()
+  std::vector<TreeNode> scanned_forms_;
+  std::vector<FormSpan> scanned_spans_;
+};
+
+}
+
+#endif /* INCREMENTAL_PARSER_HPP_ */
@@ -0,0 +1,121 @@
+#include "message_parser.hpp"
+#include "sexpr_scanner.hpp"
+
+#include <cassert>
+
+namespace sexpr_parser {
+
+MessageParser::MessageParser() : text_(), nodes_(), child_indices_(), roots_(), open_lists_(), pending_children_() {
+}
+
+// clear() and assign() keep the capacity of the buffers
+void MessageParser::Parse(const char* data, const std::size_t size) {
+  text_.assign(data, size);
+  nodes_.clear();
+  child_indices_.clear();
+  roots_.clear();
+  open_lists_.clear();
+  pending_children_.clear();
+  std::size_t i = 0;
+  while (i < size) {
+    const auto c = text_[i];
+    if (scanner::IsSeparator(c) || c == ';') {
+      i = scanner::SkipGap(text_.data(), i, size);
+      continue;
+    }
+    if (c == '(') {
+      open_lists_.emplace_back(static_cast<NodeIndex>(nodes_.size()), pending_children_.size());
+      nodes_.push_back(Node{false, 0, 0});
+      ++i;
+      continue;
+    }
+    if (c == ')' && !open_lists_.empty()) {
+      CloseList();
+      ++i;
+      continue;
+    }
+    const auto begin = i;
+    i = scanner::SkipAtom(text_.data(), begin, size);
+    scanner::LowerReservedWord(&text_[begin], i - begin);
+    const auto index = static_cast<NodeIndex>(nodes_.size());
+    nodes_.push_back(Node{true, static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(i - begin)});
+    AddNode(index);
+  }
+  // Unclosed lists at the end of the message are closed implicitly
+  while (!open_lists_.empty()) {
+    CloseList();
+  }
+}
+
+void MessageParser::Parse(const std::string& message) {
+  Parse(message.data(), message.size());
+}
+
+std::size_t MessageParser::GetRootCount() const {
+  return roots_.size();
+}
+
+NodeIndex MessageParser::GetRoot(const std::size_t index) const {
+  assert(index < roots_.size());
+  return roots_[index];
+}
+
+std::size_t MessageParser::GetNodeCount() const {
+  return nodes_.size();
+}
+
+bool MessageParser::IsLeaf(const NodeIndex index) const {
+  assert(index < nodes_.size());
+  return nodes_[index].is_leaf;
+}
+
+std::size_t MessageParser::GetChildCount(const NodeIndex index) const {
+  assert(index < nodes_.size());
+  return nodes_[index].is_leaf ? 0 : nodes_[index].length;
+}
+
+NodeIndex MessageParser::GetChild(const NodeIndex index, const std::size_t child_index) const {
+  assert(child_index < GetChildCount(index));
+  return child_indices_[nodes_[index].offset + child_index];
+}
+
+const char* MessageParser::GetValue(const NodeIndex index) const {
+  assert(IsLeaf(index));
+  return text_.data() + nodes_[index].offset;
+}
+
+std::size_t MessageParser::GetValueLength(const NodeIndex index) const {
+  assert(IsLeaf(index));
+  return nodes_[index].length;
+}
+
+TreeNode MessageParser::ToTreeNode(const NodeIndex index) const {
+  if (IsLeaf(index)) {
+    return TreeNode(std::string(GetValue(index), GetValueLength(index)));
+  }
+  std::vector<TreeNode> children;
+  children.reserve(GetChildCount(index));
+  for (std::size_t i = 0; i < GetChildCount(index); ++i) {
+    children.push_back(ToTreeNode(GetChild(index, i)));
+  }
+  return TreeNode(std::move(children));
+}
+
+void MessageParser::AddNode(const NodeIndex index) {
+  (open_lists_.empty() ? roots_ : pending_children_).push_back(index);
+}
+
+// The children of a list are contiguous in child_indices_ as they are
+// copied there once the list is complete
+void MessageParser::CloseList() {
+  const auto list = open_lists_.back();
+  open_lists_.pop_back();
+  auto& node = nodes_[list.first];
+  node.offset = static_cast<std::uint32_t>(child_indices_.size());
+  node.length = static_cast<std::uint32_t>(pending_children_.size() - list.second);
+  child_indices_.insert(child_indices_.end(), pending_children_.begin() + list.second, pending_children_.end());
+  pending_children_.resize(list.second);
+  AddNode(list.first);
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef MESSAGE_PARSER_HPP_
+#define MESSAGE_PARSER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flat_document.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Parses messages one after another into buffers that are kept between
+// messages, e.g. the messages of a game server, so that a message no larger
+// than the earlier ones is parsed without allocating.
+// Nodes are numbered in pre-order as in FlatDocument, and values point
+// into a copy of the message, so they are not null-terminated. Reserved
+// words are lowered in the copy as in TreeNode, e.g. "ROLE" becomes "role".
+// Everything is replaced by the next Parse().
+class MessageParser {
+public:
+  MessageParser();
+  // Same trees as Parse() without flattening
+  void Parse(const char* data, const std::size_t size);
+  void Parse(const std::string& message);
+  std::size_t GetRootCount() const;
+  NodeIndex GetRoot(const std::size_t index) const;
+  std::size_t GetNodeCount() const;
+  bool IsLeaf(const NodeIndex index) const;
+  std::size_t GetChildCount(const NodeIndex index) const;
+  NodeIndex GetChild(const NodeIndex index, const std::size_t child_index) const;
+  const char* GetValue(const NodeIndex index) const;
+  std::size_t GetValueLength(const NodeIndex index) const;
+  TreeNode ToTreeNode(const NodeIndex index) const;
+private:
+  struct Node {
+    bool is_leaf;
+    // Of the value in text_ for leaves, and of the children in
+    // child_indices_ for lists
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+  void AddNode(const NodeIndex index);
+  void CloseList();
+  std::string text_;
+  std::vector<Node> nodes_;
+  std::vector<NodeIndex> child_indices_;
+  std::vector<NodeIndex> roots_;
+  // Lists being built with the position of their first child in
+  // pending_children_, innermost last
+  std::vector<std::pair<NodeIndex, std::size_t>> open_lists_;
+  std::vector<NodeIndex> pending_children_;
+};
+
+}
+
+#endif /* MESSAGE_PARSER_HPP_ */
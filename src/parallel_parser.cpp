@@ -0,0 +1,154 @@
+#include "parallel_parser.hpp"
+#include "sexpr_scanner.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace sexpr_parser {
+
+namespace {
+
+using scanner::MakeList;
+
+bool IsTokenBoundary(const char c) {
+  return scanner::IsSeparator(c) || c == '(' || c == ')';
+}
+
+// Chunk boundaries lie between tokens and outside comments, so that each
+// chunk can be tokenized independently
+std::vector<std::size_t> FindChunkBoundaries(const std::string& sexpr, const std::size_t num_chunks) {
+  std::vector<std::size_t> boundaries(1, 0);
+  const auto data = sexpr.data();
+  const auto size = sexpr.size();
+  for (std::size_t i = 1; i < num_chunks; ++i) {
+    auto boundary = std::max(size * i / num_chunks, boundaries.back());
+    while (boundary < size && !IsTokenBoundary(data[boundary])) {
+      ++boundary;
+    }
+    // The previous boundary is outside comments, so a comment containing
+    // this position starts after the last line end in between
+    auto line_begin = boundary;
+    while (line_begin > boundaries.back() && !scanner::IsLineEnd(data[line_begin - 1])) {
+      --line_begin;
+    }
+    if (std::memchr(data + line_begin, ';', boundary - line_begin)) {
+      while (boundary < size && !scanner::IsLineEnd(data[boundary])) {
+        ++boundary;
+      }
+    }
+    boundaries.push_back(boundary);
+  }
+  boundaries.push_back(size);
+  return boundaries;
+}
+
+// Result of one chunk: complete subtrees at the level where the chunk
+// starts, interleaved with parens that could not be matched in the chunk.
+// Unmatched ")" close lists opened by earlier chunks, and each unmatched
+// "(" is followed by the subtrees already built inside it.
+struct ChunkResult {
+  enum Item : char {
+    kNode,
+    kOpen,
+    kClose
+  };
+  std::vector<Item> items;
+  std::vector<TreeNode> nodes;
+};
+
+void ParseChunk(const char* begin, const char* end, const bool flatten_tuple_with_one_child, ChunkResult& result) {
+  std::vector<std::vector<TreeNode>> frames;
+  const auto add_node = [&](TreeNode&& node) {
+    if (frames.empty()) {
+      result.items.push_back(ChunkResult::kNode);
+      result.nodes.push_back(std::move(node));
+    } else {
+      frames.back().push_back(std::move(node));
+    }
+  };
+  const auto size = static_cast<std::size_t>(end - begin);
+  for (std::size_t i = 0; i < size;) {
+    const auto c = begin[i];
+    if (scanner::IsSeparator(c) || c == ';') {
+      i = scanner::SkipGap(begin, i, size);
+    } else if (c == '(') {
+      frames.emplace_back();
+      ++i;
+    } else if (c == ')') {
+      // Unmatched ")" may close a list of an earlier chunk, so whether it
+      // is an atom is decided when the chunks are stitched
+      if (frames.empty()) {
+        result.items.push_back(ChunkResult::kClose);
+      } else {
+        auto children = std::move(frames.back());
+        frames.pop_back();
+        add_node(MakeList(std::move(children), flatten_tuple_with_one_child));
+      }
+      ++i;
+    } else {
+      const auto token_begin = i;
+      i = scanner::SkipAtom(begin, i, size);
+      add_node(TreeNode(std::string(begin + token_begin, i - token_begin)));
+    }
+  }
+  for (auto& frame : frames) {
+    result.items.push_back(ChunkResult::kOpen);
+    for (auto& node : frame) {
+      result.items.push_back(ChunkResult::kNode);
+      result.nodes.push_back(std::move(node));
+    }
+  }
+}
+
+}
+
+std::vector<TreeNode> ParseParallel(const std::string& sexpr, std::size_t num_threads, const bool flatten_tuple_with_one_child) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const auto boundaries = FindChunkBoundaries(sexpr, num_threads);
+  std::vector<ChunkResult> chunks(num_threads);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(ParseChunk, sexpr.data() + boundaries[i], sexpr.data() + boundaries[i + 1], flatten_tuple_with_one_child, std::ref(chunks[i]));
+  }
+  ParseChunk(sexpr.data(), sexpr.data() + boundaries[1], flatten_tuple_with_one_child, chunks[0]);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // Stitch the chunks together in order
+  std::vector<TreeNode> results;
+  std::vector<std::vector<TreeNode>> frames;
+  for (auto& chunk : chunks) {
+    auto node = chunk.nodes.begin();
+    for (const auto item : chunk.items) {
+      if (item == ChunkResult::kNode) {
+        (frames.empty() ? results : frames.back()).push_back(std::move(*node));
+        ++node;
+      } else if (item == ChunkResult::kOpen) {
+        frames.emplace_back();
+      } else if (frames.empty()) {
+        // Unmatched ")" at top level is a token as in Parse()
+        results.push_back(TreeNode(")"));
+      } else {
+        auto children = std::move(frames.back());
+        frames.pop_back();
+        (frames.empty() ? results : frames.back()).push_back(MakeList(std::move(children), flatten_tuple_with_one_child));
+      }
+    }
+  }
+  while (!frames.empty()) {
+    auto children = std::move(frames.back());
+    frames.pop_back();
+    (frames.empty() ? results : frames.back()).push_back(MakeList(std::move(children), flatten_tuple_with_one_child));
+  }
+  return results;
+}
+
+std::vector<TreeNode> ParseKIFParallel(const std::string& kif, std::size_t num_threads) {
+  return ParseParallel(kif, num_threads, true);
+}
+
+}
@@ -0,0 +1,21 @@
+#ifndef PARALLEL_PARSER_HPP_
+#define PARALLEL_PARSER_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Same result as Parse(), but the input is split into num_threads chunks
+// that are tokenized and built in parallel, so a single huge form also
+// keeps all threads busy. 0 threads means the hardware concurrency.
+// Unclosed parens at the end of the input are closed implicitly.
+std::vector<TreeNode> ParseParallel(const std::string& sexpr, std::size_t num_threads = 0, const bool flatten_tuple_with_one_child = false);
+std::vector<TreeNode> ParseKIFParallel(const std::string& kif, std::size_t num_threads = 0);
+
+}
+
+#endif /* PARALLEL_PARSER_HPP_ */
@@ -0,0 +1,265 @@
+#include "parse_limits.hpp"
+#include "sexpr_scanner.hpp"
+#include "tree_cursor.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace sexpr_parser {
+
+namespace {
+
+bool Fail(LimitError& error, const LimitKind kind, const std::size_t limit, const std::size_t position) {
+  error.kind = kind;
+  error.limit = limit;
+  error.position = position;
+  return false;
+}
+
+const char* GetLimitName(const LimitKind kind) {
+  switch (kind) {
+  case LimitKind::kNone:
+    return "no";
+  case LimitKind::kDepth:
+    return "depth";
+  case LimitKind::kTokens:
+    return "token";
+  case LimitKind::kSymbolLength:
+    return "symbol length";
+  case LimitKind::kNodes:
+    return "node";
+  case LimitKind::kHelperPairs:
+    return "helper pair";
+  }
+  return "unknown";
+}
+
+// Ids of the variables, functors and argument positions of a rule, so that
+// argument positions are compared as integers rather than as ArgPos
+class ArgIds {
+public:
+  ArgIds() : symbol_ids_(), arg_ids_() {
+  }
+  std::uint32_t GetSymbolId(const std::string& symbol) {
+    const auto found = symbol_ids_.find(symbol);
+    if (found != symbol_ids_.end()) {
+      return found->second;
+    }
+    const auto id = static_cast<std::uint32_t>(symbol_ids_.size());
+    symbol_ids_.emplace(symbol, id);
+    return id;
+  }
+  std::uint32_t GetArgId(const std::uint32_t functor, const std::size_t position) {
+    const auto key = (static_cast<std::uint64_t>(functor) << 32) | position;
+    return arg_ids_.emplace(key, static_cast<std::uint32_t>(arg_ids_.size())).first->second;
+  }
+private:
+  std::unordered_map<std::string, std::uint32_t> symbol_ids_;
+  std::unordered_map<std::uint64_t, std::uint32_t> arg_ids_;
+};
+
+// Number of distinct argument positions of each variable in the terms
+// added, i.e. the sizes of the sets of TreeNode::CollectVariableArgs()
+// merged over the terms as TreeNode::CollectSameDomainArgsInBody() does,
+// along with the pairs of positions of the same variable
+class VariableArgCounts {
+public:
+  explicit VariableArgCounts(ArgIds& ids) : ids_(ids), seen_(), counts_(), pair_count_(0) {
+  }
+  // Stops and returns false as soon as there are more than max_pairs pairs
+  bool Add(const TreeNode& term, const std::size_t max_pairs = SIZE_MAX) {
+    for (TreeCursor cursor(term); cursor.IsValid(); cursor.Next()) {
+      if (cursor.GetDepth() == 0) {
+        continue;
+      }
+      if (cursor.GetIndex() == 0) {
+        // Functors are not arguments
+        cursor.SkipSubtree();
+        continue;
+      }
+      if (!cursor.GetNode()->IsVariable()) {
+        continue;
+      }
+      const auto variable = ids_.GetSymbolId(cursor.GetNode()->GetValue());
+      const auto functor = ids_.GetSymbolId(cursor.GetParent()->GetChildren().front().GetValue());
+      const auto arg = ids_.GetArgId(functor, cursor.GetIndex());
+      if (seen_.insert((static_cast<std::uint64_t>(variable) << 32) | arg).second) {
+        if (variable >= counts_.size()) {
+          counts_.resize(variable + 1, 0);
+        }
+        // One more pair with each position seen before
+        pair_count_ += counts_[variable]++;
+        if (pair_count_ > max_pairs) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  std::size_t Get(const std::uint32_t variable) const {
+    return variable < counts_.size() ? counts_[variable] : 0;
+  }
+  // By variable id
+  const std::vector<std::size_t>& GetCounts() const {
+    return counts_;
+  }
+  std::size_t GetPairCount() const {
+    return pair_count_;
+  }
+private:
+  ArgIds& ids_;
+  std::unordered_set<std::uint64_t> seen_;
+  std::vector<std::size_t> counts_;
+  std::size_t pair_count_;
+};
+
+// Stops early with a count above max_count, so that the body of a rule far
+// over the limit is not scanned to its end
+std::size_t CountHelperPairs(const TreeNode& rule, const std::size_t max_count) {
+  const auto& children = rule.GetChildren();
+  ArgIds ids;
+  VariableArgCounts body(ids);
+  for (auto i = children.begin() + 2; i != children.end(); ++i) {
+    if (!i->IsLeaf() && !body.Add(*i, max_count)) {
+      return body.GetPairCount();
+    }
+  }
+  auto count = body.GetPairCount();
+  const auto& head = children.at(1);
+  if (children.size() > 2 && !head.IsLeaf()) {
+    VariableArgCounts head_counts(ids);
+    head_counts.Add(head);
+    for (std::uint32_t variable = 0; variable < head_counts.GetCounts().size(); ++variable) {
+      count += head_counts.Get(variable) * body.Get(variable);
+    }
+  }
+  return count;
+}
+
+}
+
+ParseLimits::ParseLimits() :
+    max_depth(SIZE_MAX),
+    max_tokens(SIZE_MAX),
+    max_symbol_length(SIZE_MAX),
+    max_nodes(SIZE_MAX),
+    max_helper_pairs(SIZE_MAX) {
+}
+
+LimitError::LimitError() : kind(LimitKind::kNone), limit(0), position(0) {
+}
+
+std::string LimitError::ToString() const {
+  if (kind == LimitKind::kNone) {
+    return "no limit exceeded";
+  }
+  const auto where = (kind == LimitKind::kHelperPairs) ? " at rule " : " at offset ";
+  return std::string(GetLimitName(kind)) + " limit " + std::to_string(limit) + " exceeded" + where + std::to_string(position);
+}
+
+bool ParseWithLimits(const std::string& sexpr, const ParseLimits& limits, std::vector<TreeNode>& nodes, LimitError& error, const bool flatten_tuple_with_one_child) {
+  nodes.clear();
+  error = LimitError();
+  // Children of the lists being built, innermost last
+  std::vector<std::vector<TreeNode>> frames;
+  const auto add_node = [&](TreeNode&& node) {
+    (frames.empty() ? nodes : frames.back()).push_back(std::move(node));
+  };
+  const auto close_list = [&]() {
+    auto children = std::move(frames.back());
+    frames.pop_back();
+    add_node(scanner::MakeList(std::move(children), flatten_tuple_with_one_child));
+  };
+  // Forms parsed before the limit was exceeded are not returned
+  const auto fail = [&](const LimitKind kind, const std::size_t limit, const std::size_t position) -> bool {
+    nodes.clear();
+    return Fail(error, kind, limit, position);
+  };
+  const auto data = sexpr.data();
+  const auto size = sexpr.size();
+  std::size_t num_tokens = 0;
+  std::size_t num_nodes = 0;
+  std::size_t i = 0;
+  while (i < size) {
+    const auto c = data[i];
+    if (scanner::IsSeparator(c) || c == ';') {
+      i = scanner::SkipGap(data, i, size);
+      continue;
+    }
+    if (++num_tokens > limits.max_tokens) {
+      return fail(LimitKind::kTokens, limits.max_tokens, i);
+    }
+    if (c == '(') {
+      if (frames.size() >= limits.max_depth) {
+        return fail(LimitKind::kDepth, limits.max_depth, i);
+      }
+      if (++num_nodes > limits.max_nodes) {
+        return fail(LimitKind::kNodes, limits.max_nodes, i);
+      }
+      frames.emplace_back();
+      ++i;
+      continue;
+    }
+    if (c == ')' && !frames.empty()) {
+      close_list();
+      ++i;
+      continue;
+    }
+    // Stops scanning as soon as the symbol is too long
+    const auto begin = i;
+    i = scanner::SkipAtom(data, begin, size, limits.max_symbol_length);
+    if (i - begin > limits.max_symbol_length) {
+      return fail(LimitKind::kSymbolLength, limits.max_symbol_length, begin);
+    }
+    if (++num_nodes > limits.max_nodes) {
+      return fail(LimitKind::kNodes, limits.max_nodes, begin);
+    }
+    add_node(TreeNode(std::string(data + begin, i - begin)));
+  }
+  // Unclosed lists at the end of the input are closed implicitly
+  while (!frames.empty()) {
+    close_list();
+  }
+  return true;
+}
+
+bool ParseKIFWithLimits(const std::string& kif, const ParseLimits& limits, std::vector<TreeNode>& nodes, LimitError& error) {
+  return ParseWithLimits(kif, limits, nodes, error, true);
+}
+
+bool CheckHelperPairLimit(const std::vector<TreeNode>& nodes, const ParseLimits& limits, LimitError& error) {
+  error = LimitError();
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    const auto& node = nodes[i];
+    if (node.IsLeaf() || node.GetChildren().empty() || node.GetChildren().front().GetValue() != "<=") {
+      continue;
+    }
+    count += CountHelperPairs(node, limits.max_helper_pairs - count);
+    if (count > limits.max_helper_pairs) {
+      return Fail(error, LimitKind::kHelperPairs, limits.max_helper_pairs, i);
+    }
+  }
+  return true;
+}
+
+bool WritePrologWithLimits(
+    std::ostream& o,
+    const std::vector<TreeNode>& nodes,
+    const ParseLimits& limits,
+    LimitError& error,
+    const bool quotes_atoms,
+    const std::string& functor_prefix,
+    const std::string& atom_prefix,
+    const bool adds_helper_clauses) {
+  error = LimitError();
+  if (adds_helper_clauses && !CheckHelperPairLimit(nodes, limits, error)) {
+    return false;
+  }
+  WriteProlog(o, nodes, quotes_atoms, functor_prefix, atom_prefix, adds_helper_clauses);
+  return true;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef PARSE_LIMITS_HPP_
+#define PARSE_LIMITS_HPP_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Bounds on the work done for one input, e.g. a game description received
+// from an untrusted server. All of them are unlimited by default.
+struct ParseLimits {
+  ParseLimits();
+  // Nesting depth of lists, where top-level lists have depth 1
+  std::size_t max_depth;
+  // Atoms and parens
+  std::size_t max_tokens;
+  std::size_t max_symbol_length;
+  // Leaves and lists
+  std::size_t max_nodes;
+  // connected_args/4 and equivalent_args/4 pairs before deduplication
+  std::size_t max_helper_pairs;
+};
+
+enum class LimitKind {
+  kNone,
+  kDepth,
+  kTokens,
+  kSymbolLength,
+  kNodes,
+  kHelperPairs
+};
+
+// Which limit was exceeded and where.
+// The position is a byte offset in the input for parsing, and the index of
+// the rule for helper pairs.
+struct LimitError {
+  LimitError();
+  LimitKind kind;
+  std::size_t limit;
+  std::size_t position;
+  std::string ToString() const;
+};
+
+// Same result as Parse() and ParseKIF() within the limits. Otherwise
+// returns false with nodes empty and fills error as soon as a limit is
+// exceeded, after work proportional to the input consumed so far.
+// Lists are built with an explicit stack, so the call stack does not grow
+// with the nesting depth.
+bool ParseWithLimits(const std::string& sexpr, const ParseLimits& limits, std::vector<TreeNode>& nodes, LimitError& error, const bool flatten_tuple_with_one_child = false);
+bool ParseKIFWithLimits(const std::string& kif, const ParseLimits& limits, std::vector<TreeNode>& nodes, LimitError& error);
+
+// Counts the pairs the helper clauses of ToProlog() would be built from in
+// linear time, before the quadratic pair sets are built
+bool CheckHelperPairLimit(const std::vector<TreeNode>& nodes, const ParseLimits& limits, LimitError& error);
+
+// WriteProlog() that writes nothing when the helper pairs exceed the limit
+bool WritePrologWithLimits(
+    std::ostream& o,
+    const std::vector<TreeNode>& nodes,
+    const ParseLimits& limits,
+    LimitError& error,
+    const bool quotes_atoms,
+    const std::string& functor_prefix = "",
+    const std::string& atom_prefix = "",
+    const bool adds_helper_clauses = false);
+
+}
+
+#endif /* PARSE_LIMITS_HPP_ */
@@ -0,0 +1,139 @@
+#include "prolog_pipe.hpp"
+
+#include <cassert>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace sexpr_parser {
+
+FileDescriptorStreamBuffer::FileDescriptorStreamBuffer(const int fd, const std::size_t buffer_size) :
+    fd_(fd), buffer_(buffer_size) {
+  assert(buffer_size > 0);
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bool FileDescriptorStreamBuffer::Flush() {
+  auto begin = pbase();
+  const auto end = pptr();
+  while (begin != end) {
+    const auto written = ::write(fd_, begin, end - begin);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    begin += written;
+  }
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  return true;
+}
+
+FileDescriptorStreamBuffer::int_type FileDescriptorStreamBuffer::overflow(int_type c) {
+  if (!Flush()) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int FileDescriptorStreamBuffer::sync() {
+  return Flush() ? 0 : -1;
+}
+
+PrologPipe::PrologPipe(const std::string& command) :
+    fd_(-1), pid_(-1), buffer_(), stream_() {
+  int fds[2];
+  // Close-on-exec from the start, so that a child forked by another thread
+  // cannot inherit the write end and keep the reader from seeing EOF.
+  // dup2() clears the flag on the child's standard input.
+  if (::pipe2(fds, O_CLOEXEC) != 0) {
+    return;
+  }
+  const auto pid = ::fork();
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return;
+  }
+  if (pid == 0) {
+    // Child: read end of the pipe becomes standard input
+    ::dup2(fds[0], STDIN_FILENO);
+    ::close(fds[0]);
+    ::close(fds[1]);
+    ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+    ::_exit(127);
+  }
+  ::close(fds[0]);
+  fd_ = fds[1];
+  pid_ = pid;
+  buffer_.reset(new FileDescriptorStreamBuffer(fd_));
+  stream_.reset(new std::ostream(buffer_.get()));
+}
+
+PrologPipe::PrologPipe(const int fd) :
+    fd_(fd), pid_(-1), buffer_(), stream_() {
+  if (fd_ >= 0) {
+    buffer_.reset(new FileDescriptorStreamBuffer(fd_));
+    stream_.reset(new std::ostream(buffer_.get()));
+  }
+}
+
+PrologPipe::~PrologPipe() {
+  Close();
+}
+
+bool PrologPipe::IsOpen() const {
+  return fd_ >= 0;
+}
+
+std::ostream& PrologPipe::GetStream() {
+  assert(IsOpen());
+  return *stream_;
+}
+
+bool PrologPipe::Consult(
+    const std::vector<TreeNode>& nodes,
+    const bool quotes_atoms,
+    const std::string& functor_prefix,
+    const std::string& atom_prefix,
+    const bool adds_helper_clauses) {
+  if (!IsOpen()) {
+    return false;
+  }
+  WriteProlog(*stream_, nodes, quotes_atoms, functor_prefix, atom_prefix, adds_helper_clauses);
+  return stream_->flush().good();
+}
+
+int PrologPipe::Close() {
+  if (!IsOpen()) {
+    return -1;
+  }
+  auto status = buffer_->Flush() ? 0 : -1;
+  stream_.reset();
+  buffer_.reset();
+  ::close(fd_);
+  fd_ = -1;
+  if (pid_ > 0) {
+    int wait_status;
+    while (::waitpid(pid_, &wait_status, 0) < 0) {
+      if (errno != EINTR) {
+        pid_ = -1;
+        return -1;
+      }
+    }
+    pid_ = -1;
+    if (status == 0) {
+      status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : -1;
+    }
+  }
+  return status;
+}
+
+}
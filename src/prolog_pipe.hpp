@@ -0,0 +1,63 @@
+#ifndef PROLOG_PIPE_HPP_
+#define PROLOG_PIPE_HPP_
+
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Output stream buffer writing to a file descriptor.
+// Writes block while the reader is busy, which throttles the writer.
+class FileDescriptorStreamBuffer : public std::streambuf {
+public:
+  explicit FileDescriptorStreamBuffer(const int fd, const std::size_t buffer_size = 1 << 16);
+  bool Flush();
+protected:
+  int_type overflow(int_type c) override;
+  int sync() override;
+private:
+  const int fd_;
+  std::vector<char> buffer_;
+};
+
+// Streams clauses into the standard input of a Prolog process as they are
+// generated, so that the process consults while the rest is still being
+// written.
+// For SWI-Prolog, a command like
+//   swipl -q -g "load_files(kif, [stream(user_input)])" -t halt
+// consults everything until the pipe is closed.
+// Writes to a process that has exited raise SIGPIPE, so callers that do not
+// want to be terminated by it should ignore the signal.
+class PrologPipe {
+public:
+  // Launches the command through /bin/sh
+  explicit PrologPipe(const std::string& command);
+  // Attaches to a descriptor connected to an already running process and
+  // takes ownership of it
+  explicit PrologPipe(const int fd);
+  ~PrologPipe();
+  PrologPipe(const PrologPipe&) = delete;
+  PrologPipe& operator=(const PrologPipe&) = delete;
+  bool IsOpen() const;
+  std::ostream& GetStream();
+  bool Consult(const std::vector<TreeNode>& nodes, const bool quotes_atoms, const std::string& functor_prefix = "", const std::string& atom_prefix = "", const bool adds_helper_clauses = false);
+  // Flushes and closes the pipe, then waits for a launched process to exit.
+  // Returns its exit status, 0 for an attached descriptor or -1 on error.
+  int Close();
+private:
+  int fd_;
+  pid_t pid_;
+  std::unique_ptr<FileDescriptorStreamBuffer> buffer_;
+  std::unique_ptr<std::ostream> stream_;
+};
+
+}
+
+#endif /* PROLOG_PIPE_HPP_ */
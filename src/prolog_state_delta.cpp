@@ -0,0 +1,79 @@
+#include "prolog_state_delta.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+const std::uint8_t kInPrevious = 1;
+const std::uint8_t kInCurrent = 2;
+
+}
+
+PrologStateDeltaEmitter::PrologStateDeltaEmitter(const bool quotes_atoms, const std::string& functor_prefix, const std::string& atom_prefix) :
+    quotes_atoms_(quotes_atoms), functor_prefix_(functor_prefix), atom_prefix_(atom_prefix), terms_(), term_texts_(),
+    memberships_(), previous_terms_(), current_terms_() {
+}
+
+const std::string& PrologStateDeltaEmitter::GetTermText(const TreeNode& node) {
+  return GetTermText(terms_.Intern(node), node);
+}
+
+// Prolog terms are never empty, so an empty text is one not formatted yet
+const std::string& PrologStateDeltaEmitter::GetTermText(const TermId term, const TreeNode& node) {
+  if (term >= term_texts_.size()) {
+    term_texts_.resize(term + 1);
+  }
+  auto& text = term_texts_[term];
+  if (text.empty()) {
+    text = node.ToPrologTerm(quotes_atoms_, functor_prefix_, atom_prefix_);
+  }
+  return text;
+}
+
+std::string PrologStateDeltaEmitter::EmitDelta(const std::vector<TreeNode>& previous, const std::vector<TreeNode>& current) {
+  previous_terms_.clear();
+  for (const auto& node : previous) {
+    previous_terms_.push_back(terms_.Intern(node));
+  }
+  current_terms_.clear();
+  for (const auto& node : current) {
+    current_terms_.push_back(terms_.Intern(node));
+  }
+  for (const auto term : previous_terms_) {
+    if (term >= memberships_.size()) {
+      memberships_.resize(term + 1, 0);
+    }
+    memberships_[term] |= kInPrevious;
+  }
+  for (const auto term : current_terms_) {
+    if (term >= memberships_.size()) {
+      memberships_.resize(term + 1, 0);
+    }
+    memberships_[term] |= kInCurrent;
+  }
+  std::string o;
+  // Retract facts that no longer hold first
+  for (std::size_t i = 0; i < previous.size(); ++i) {
+    if (!(memberships_[previous_terms_[i]] & kInCurrent)) {
+      o += "retract(";
+      o += GetTermText(previous_terms_[i], previous[i]);
+      o += ").\n";
+    }
+  }
+  for (std::size_t i = 0; i < current.size(); ++i) {
+    if (!(memberships_[current_terms_[i]] & kInPrevious)) {
+      o += "assertz(";
+      o += GetTermText(current_terms_[i], current[i]);
+      o += ").\n";
+    }
+  }
+  for (const auto term : previous_terms_) {
+    memberships_[term] = 0;
+  }
+  for (const auto term : current_terms_) {
+    memberships_[term] = 0;
+  }
+  return o;
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef PROLOG_STATE_DELTA_HPP_
+#define PROLOG_STATE_DELTA_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+#include "term_store.hpp"
+
+namespace sexpr_parser {
+
+// Emits the difference between two sets of facts (e.g. "true" facts and
+// "does" moves of consecutive states) as retract/assertz goals.
+// Facts are interned once per state, so that states are compared by term
+// ids, and the Prolog text of each interned fact is formatted only once per
+// emitter, so one emitter should be kept for a whole match.
+class PrologStateDeltaEmitter {
+public:
+  PrologStateDeltaEmitter(const bool quotes_atoms, const std::string& functor_prefix = "", const std::string& atom_prefix = "");
+  std::string EmitDelta(const std::vector<TreeNode>& previous, const std::vector<TreeNode>& current);
+  const std::string& GetTermText(const TreeNode& node);
+private:
+  const std::string& GetTermText(const TermId term, const TreeNode& node);
+  const bool quotes_atoms_;
+  const std::string functor_prefix_;
+  const std::string atom_prefix_;
+  TermStore terms_;
+  // By term id, empty until formatted
+  std::vector<std::string> term_texts_;
+  // By term id, kInPrevious and kInCurrent of the states being compared
+  std::vector<std::uint8_t> memberships_;
+  std::vector<TermId> previous_terms_;
+  std::vector<TermId> current_terms_;
+};
+
+}
+
+#endif /* PROLOG_STATE_DELTA_HPP_ */
@@ -0,0 +1,44 @@
+#include "reachability.hpp"
+
+#include <cassert>
+
+#include "datalog.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+// Rules that connect the relaxed state and moves to the game's rules
+const char* const kBridgeRules =
+    "(<= (true ?x) (init ?x))"
+    "(<= (true ?x) (next ?x))"
+    "(<= (does ?r ?m) (legal ?r ?m))";
+
+}
+
+Reachability::Reachability() : bases(), inputs(), iterations(0), fact_count(0) {
+}
+
+bool AnalyzeReachability(const std::vector<TreeNode>& clauses, Reachability& reachability, const std::size_t max_facts, ClauseProfiler* profiler) {
+  assert(!profiler || profiler->GetClauseCount() == clauses.size());
+  DatalogEngine engine(true, max_facts, profiler);
+  for (const auto& rule : Parse(kBridgeRules)) {
+    engine.AddClause(rule);
+  }
+  for (std::size_t i = 0; i < clauses.size(); ++i) {
+    engine.AddClause(clauses[i], i);
+  }
+  // Without negation, all rules are in one stratum
+  engine.Stratify();
+  const auto completes = engine.Run();
+  reachability.iterations = engine.GetIterationCount();
+  reachability.fact_count = engine.GetFactCount();
+  if (!completes) {
+    return false;
+  }
+  reachability.bases = engine.ToClauses("true", 1, "base");
+  reachability.inputs = engine.ToClauses("does", 2, "input");
+  return true;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef REACHABILITY_HPP_
+#define REACHABILITY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "clause_profiler.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+struct Reachability {
+  Reachability();
+  // (base X) for each fluent X that may be true in a reachable state
+  std::vector<TreeNode> bases;
+  // (input R M) for each move M that role R may be able to make
+  std::vector<TreeNode> inputs;
+  // Fixpoint iterations until no new fact was derived
+  std::size_t iterations;
+  // Ground facts of all relations in the relaxed model
+  std::size_t fact_count;
+};
+
+// Over-approximates the fluents and moves of a game from its rules, for
+// games that omit base and input.
+// The rules are relaxed so that they become monotone: negative literals
+// are dropped, and "true" and "does" hold for everything that "init" or
+// "next" and "legal" derive at any time. The least model of the relaxed
+// rules is computed bottom-up by semi-naive iteration over interned ground
+// terms, so each rule is only joined against facts new in the previous
+// iteration. "distinct" is still checked and "or" is expanded.
+// Rules that are unsafe after the relaxation are ignored.
+// False when the model grows beyond max_facts, e.g. for rules building
+// unbounded terms. The profiler, if given, must be built from clauses.
+bool AnalyzeReachability(const std::vector<TreeNode>& clauses, Reachability& reachability, const std::size_t max_facts = SIZE_MAX, ClauseProfiler* profiler = nullptr);
+
+}
+
+#endif /* REACHABILITY_HPP_ */
@@ -0,0 +1,158 @@
+#include "rule_base.hpp"
+
+#include <cassert>
+#include <sstream>
+
+namespace sexpr_parser {
+
+namespace {
+
+template <class Key>
+void UpdateCount(std::unordered_map<Key, std::size_t>& counts, const Key& key, const bool adds) {
+  if (adds) {
+    ++counts[key];
+    return;
+  }
+  const auto found = counts.find(key);
+  assert(found != counts.end() && found->second > 0);
+  if (--found->second == 0) {
+    counts.erase(found);
+  }
+}
+
+template <class Key>
+std::unordered_set<Key> Keys(const std::unordered_map<Key, std::size_t>& counts) {
+  std::unordered_set<Key> keys(counts.size());
+  for (const auto& key_and_count : counts) {
+    keys.insert(key_and_count.first);
+  }
+  return keys;
+}
+
+}
+
+RuleBase::RuleBase() :
+    next_id_(0),
+    clauses_(),
+    atom_counts_(),
+    non_functor_atom_counts_(),
+    functor_arity_counts_(),
+    in_body_pair_counts_(),
+    between_head_and_body_pair_counts_() {
+}
+
+void RuleBase::Count(const ClauseEntry& entry, const bool adds) {
+  for (const auto& atom : entry.atoms) {
+    UpdateCount(atom_counts_, atom, adds);
+  }
+  for (const auto& atom : entry.non_functor_atoms) {
+    UpdateCount(non_functor_atom_counts_, atom, adds);
+  }
+  for (const auto& functor_arity_pair : entry.functors) {
+    auto& arity_counts = functor_arity_counts_[functor_arity_pair.first];
+    if (adds) {
+      ++arity_counts[functor_arity_pair.second];
+    } else {
+      const auto found = arity_counts.find(functor_arity_pair.second);
+      assert(found != arity_counts.end() && found->second > 0);
+      if (--found->second == 0) {
+        arity_counts.erase(found);
+      }
+    }
+    if (arity_counts.empty()) {
+      functor_arity_counts_.erase(functor_arity_pair.first);
+    }
+  }
+  for (const auto& pair : entry.same_domain_args_pairs_in_body) {
+    UpdateCount(in_body_pair_counts_, pair, adds);
+  }
+  for (const auto& pair : entry.same_domain_args_pairs_between_head_and_body) {
+    UpdateCount(between_head_and_body_pair_counts_, pair, adds);
+  }
+}
+
+ClauseId RuleBase::Add(const TreeNode& clause) {
+  const auto id = next_id_++;
+  ClauseEntry entry{clause, clause.CollectAtoms(), clause.CollectNonFunctorAtoms(), clause.CollectFunctorAtoms(), {}, {}};
+  if (!clause.IsLeaf() && clause.GetChildren().front().GetValue() == "<=") {
+    entry.same_domain_args_pairs_in_body = clause.CollectSameDomainArgsInBody();
+    entry.same_domain_args_pairs_between_head_and_body = clause.CollectSameDomainArgsBetweenHeadAndBody();
+  }
+  Count(entry, true);
+  clauses_.emplace(id, std::move(entry));
+  return id;
+}
+
+bool RuleBase::Remove(const ClauseId id) {
+  const auto found = clauses_.find(id);
+  if (found == clauses_.end()) {
+    return false;
+  }
+  Count(found->second, false);
+  clauses_.erase(found);
+  return true;
+}
+
+bool RuleBase::Contains(const ClauseId id) const {
+  return clauses_.count(id);
+}
+
+const TreeNode& RuleBase::GetClause(const ClauseId id) const {
+  return clauses_.at(id).clause;
+}
+
+std::size_t RuleBase::GetClauseCount() const {
+  return clauses_.size();
+}
+
+void RuleBase::ApplyFormChange(const std::vector<TreeNode>& forms, const FormChange& change, std::vector<ClauseId>& form_clause_ids) {
+  assert(change.first_form + change.removed_count <= form_clause_ids.size());
+  const auto first = form_clause_ids.begin() + change.first_form;
+  for (auto i = first; i != first + change.removed_count; ++i) {
+    const auto removes = Remove(*i);
+    assert(removes);
+    (void)removes;
+  }
+  std::vector<ClauseId> inserted_ids;
+  for (std::size_t i = 0; i < change.inserted_count; ++i) {
+    inserted_ids.push_back(Add(forms.at(change.first_form + i)));
+  }
+  form_clause_ids.erase(first, first + change.removed_count);
+  form_clause_ids.insert(form_clause_ids.begin() + change.first_form, inserted_ids.begin(), inserted_ids.end());
+}
+
+const std::unordered_map<std::string, std::size_t>& RuleBase::GetAtomCounts() const {
+  return atom_counts_;
+}
+
+const std::unordered_map<std::string, std::size_t>& RuleBase::GetNonFunctorAtomCounts() const {
+  return non_functor_atom_counts_;
+}
+
+const std::unordered_map<std::string, std::map<int, std::size_t>>& RuleBase::GetFunctorArityCounts() const {
+  return functor_arity_counts_;
+}
+
+std::unordered_set<std::string> RuleBase::CollectAtoms() const {
+  return Keys(atom_counts_);
+}
+
+std::unordered_set<std::string> RuleBase::CollectNonFunctorAtoms() const {
+  return Keys(non_functor_atom_counts_);
+}
+
+std::unordered_map<std::string, int> RuleBase::CollectFunctorAtoms() const {
+  std::unordered_map<std::string, int> functors(functor_arity_counts_.size());
+  for (const auto& functor_and_arity_counts : functor_arity_counts_) {
+    functors.emplace(functor_and_arity_counts.first, functor_and_arity_counts.second.begin()->first);
+  }
+  return functors;
+}
+
+std::string RuleBase::GeneratePrologHelperClauses(const bool quotes_atoms, const std::string& functor_prefix) const {
+  std::ostringstream o;
+  WritePrologHelperClauses(o, CollectFunctorAtoms(), Keys(in_body_pair_counts_), Keys(between_head_and_body_pair_counts_), quotes_atoms, functor_prefix);
+  return o.str();
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef RULE_BASE_HPP_
+#define RULE_BASE_HPP_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "incremental_parser.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+using ClauseId = std::size_t;
+
+// Set of clauses that keeps the statistics used by the Collect* functions
+// and the Prolog helper clauses as reference counts, so that adding or
+// removing a clause costs time proportional to that clause only.
+class RuleBase {
+public:
+  RuleBase();
+  ClauseId Add(const TreeNode& clause);
+  // False if there is no clause of the id
+  bool Remove(const ClauseId id);
+  bool Contains(const ClauseId id) const;
+  const TreeNode& GetClause(const ClauseId id) const;
+  std::size_t GetClauseCount() const;
+  // Replaces the clauses of the forms changed by IncrementalParser::Edit().
+  // form_clause_ids holds the id of the clause of each form and is updated.
+  void ApplyFormChange(const std::vector<TreeNode>& forms, const FormChange& change, std::vector<ClauseId>& form_clause_ids);
+  // Number of clauses using each value
+  const std::unordered_map<std::string, std::size_t>& GetAtomCounts() const;
+  const std::unordered_map<std::string, std::size_t>& GetNonFunctorAtomCounts() const;
+  const std::unordered_map<std::string, std::map<int, std::size_t>>& GetFunctorArityCounts() const;
+  std::unordered_set<std::string> CollectAtoms() const;
+  std::unordered_set<std::string> CollectNonFunctorAtoms() const;
+  // If a functor is used with several arities, the smallest one is returned
+  // as by the free CollectFunctorAtoms()
+  std::unordered_map<std::string, int> CollectFunctorAtoms() const;
+  std::string GeneratePrologHelperClauses(const bool quotes_atoms, const std::string& functor_prefix = "") const;
+private:
+  struct ClauseEntry {
+    TreeNode clause;
+    std::unordered_set<std::string> atoms;
+    std::unordered_set<std::string> non_functor_atoms;
+    std::unordered_map<std::string, int> functors;
+    std::unordered_set<ArgPosPair> same_domain_args_pairs_in_body;
+    std::unordered_set<ArgPosPair> same_domain_args_pairs_between_head_and_body;
+  };
+  void Count(const ClauseEntry& entry, const bool adds);
+  ClauseId next_id_;
+  std::unordered_map<ClauseId, ClauseEntry> clauses_;
+  std::unordered_map<std::string, std::size_t> atom_counts_;
+  std::unordered_map<std::string, std::size_t> non_functor_atom_counts_;
+  std::unordered_map<std::string, std::map<int, std::size_t>> functor_arity_counts_;
+  std::unordered_map<ArgPosPair, std::size_t> in_body_pair_counts_;
+  std::unordered_map<ArgPosPair, std::size_t> between_head_and_body_pair_counts_;
+};
+
+}
+
+#endif /* RULE_BASE_HPP_ */
@@ -1,30 +1,20 @@
 #include "sexpr_parser.hpp"
+#include "parse_limits.hpp"
+#include "sexpr_scanner.hpp"
+#include "tree_cursor.hpp"
 
 #include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <locale>
 #include <sstream>
+#include <utility>
 
 #include <boost/functional/hash.hpp>
 #include <boost/regex.hpp>
-#include <boost/tokenizer.hpp>
-
-namespace std
-{
-template <class T, class U>
-struct hash<pair<T, U>> {
-  size_t operator()(const pair<T, U>& a) const {
-    return boost::hash_value(a);
-  }
-};
-}
 
 namespace sexpr_parser {
 
-typedef boost::char_separator<char> Separator;
-typedef boost::tokenizer<Separator> Tokenizer;
-
 const std::unordered_set<std::string> reserved_words = {
   "role",
   "init",
@@ -56,6 +46,19 @@ std::string LowerReservedWords(const std::string& word) {
   }
 }
 
+// Without allocating, as reserved words fit in the small string buffer
+void scanner::LowerReservedWord(char* data, const std::size_t length) {
+  const std::size_t max_reserved_word_length = 8;
+  if (length > max_reserved_word_length) {
+    return;
+  }
+  std::string lowered(data, length);
+  std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+  if (reserved_words.count(lowered)) {
+    std::copy(lowered.begin(), lowered.end(), data);
+  }
+}
+
 TreeNode::TreeNode(const std::string& value) :
     is_leaf_(true), value_(LowerReservedWords(value)), children_() {
 }
@@ -64,6 +67,32 @@ TreeNode::TreeNode(const std::vector<TreeNode>& children) :
     is_leaf_(false), value_(), children_(children) {
 }
 
+TreeNode::TreeNode(std::vector<TreeNode>&& children) :
+    is_leaf_(false), value_(), children_(std::move(children)) {
+}
+
+// Lists of lists are taken apart with an explicit stack, and each node is
+// destroyed once its children have been moved out
+TreeNode::~TreeNode() {
+  const auto has_list_child = std::any_of(children_.begin(), children_.end(), [](const TreeNode& child) {
+    return !child.children_.empty();
+  });
+  if (!has_list_child) {
+    return;
+  }
+  std::vector<std::vector<TreeNode>> pending;
+  pending.push_back(std::move(children_));
+  while (!pending.empty()) {
+    auto children = std::move(pending.back());
+    pending.pop_back();
+    for (auto& child : children) {
+      if (!child.children_.empty()) {
+        pending.push_back(std::move(child.children_));
+      }
+    }
+  }
+}
+
 bool TreeNode::IsLeaf() const {
   return is_leaf_;
 }
@@ -80,46 +109,101 @@ const std::vector<TreeNode>& TreeNode::GetChildren() const {
   return children_;
 }
 
-std::string TreeNode::ToString() const {
-  if (is_leaf_) {
-    return "leaf:" + value_;
-  } else {
-    std::ostringstream o;
-    o << "non-leaf[" << children_.size() << "](";
-    for (const auto& child : children_) {
-      o << ' ' << child.ToString();
-    }
-    o << " )";
-    return o.str();
+const std::string ellipsis = "...";
+
+// Appends at most max_length characters in total to out.
+// Returns false when the output is cut, which stops the whole traversal,
+// so the cost is proportional to max_length rather than to the tree size.
+bool AppendBounded(std::string& out, const std::string& value, const std::size_t max_length) {
+  const auto rest = max_length - out.size();
+  if (value.size() > rest) {
+    out.append(value, 0, rest);
+    return false;
   }
+  out.append(value);
+  return true;
 }
 
-std::string TreeNode::ToSexpr() const {
-  if (is_leaf_) {
-    return value_;
-  } else {
-    std::ostringstream o;
-    o << '(';
-    for (auto i = children_.begin(); i != children_.end(); ++i) {
-      if (i != children_.begin()) {
-        o << ' ';
-      }
-      o << i->ToSexpr();
+bool AppendBounded(std::string& out, const char c, const std::size_t max_length) {
+  if (out.size() >= max_length) {
+    return false;
+  }
+  out.push_back(c);
+  return true;
+}
+
+bool AppendString(std::string& out, const TreeNode& node, const std::size_t max_length) {
+  if (node.IsLeaf()) {
+    return AppendBounded(out, "leaf:", max_length) && AppendBounded(out, node.GetValue(), max_length);
+  }
+  if (!AppendBounded(out, "non-leaf[" + std::to_string(node.GetChildren().size()) + "](", max_length)) {
+    return false;
+  }
+  for (const auto& child : node.GetChildren()) {
+    if (!AppendBounded(out, ' ', max_length) || !AppendString(out, child, max_length)) {
+      return false;
     }
-    o << ')';
-    return o.str();
   }
+  return AppendBounded(out, " )", max_length);
 }
 
-std::string TreeNode::ChildrenToSexpr() const {
-  std::ostringstream o;
-  for (auto i = children_.begin(); i != children_.end(); ++i) {
-    if (i != children_.begin()) {
-      o << ' ';
+bool AppendChildrenSexpr(std::string& out, const std::vector<TreeNode>& children, const std::size_t max_length);
+
+bool AppendSexpr(std::string& out, const TreeNode& node, const std::size_t max_length) {
+  if (node.IsLeaf()) {
+    return AppendBounded(out, node.GetValue(), max_length);
+  }
+  return AppendBounded(out, '(', max_length) &&
+      AppendChildrenSexpr(out, node.GetChildren(), max_length) &&
+      AppendBounded(out, ')', max_length);
+}
+
+bool AppendChildrenSexpr(std::string& out, const std::vector<TreeNode>& children, const std::size_t max_length) {
+  for (auto i = children.begin(); i != children.end(); ++i) {
+    if (i != children.begin() && !AppendBounded(out, ' ', max_length)) {
+      return false;
+    }
+    if (!AppendSexpr(out, *i, max_length)) {
+      return false;
     }
-    o << i->ToSexpr();
   }
-  return o.str();
+  return true;
+}
+
+std::string TreeNode::ToString() const {
+  std::string o;
+  AppendString(o, *this, std::string::npos);
+  return o;
+}
+
+// Output longer than max_length is cut and followed by "..."
+std::string TreeNode::ToString(const std::size_t max_length) const {
+  std::string o;
+  if (!AppendString(o, *this, max_length)) {
+    o.append(ellipsis);
+  }
+  return o;
+}
+
+std::string TreeNode::ToSexpr() const {
+  std::string o;
+  AppendSexpr(o, *this, std::string::npos);
+  return o;
+}
+
+// Output longer than max_length is cut and followed by "..."
+std::string TreeNode::ToSexpr(const std::size_t max_length) const {
+  std::string o;
+  if (!AppendSexpr(o, *this, max_length)) {
+    o.append(ellipsis);
+  }
+  return o;
+}
+
+std::string TreeNode::ChildrenToSexpr() const {
+  std::string o;
+  AppendChildrenSexpr(o, children_, std::string::npos);
+  return o;
 }
 
 std::string FilterVariableName(const std::string& base_name) {
@@ -224,103 +308,101 @@ std::string TreeNode::ToPrologClause(const bool quotes_atoms, const std::string&
   }
 }
 
-std::unordered_set<std::string> TreeNode::CollectAtoms() const {
-  if (is_leaf_) {
-    if (value_ == "<=" || value_.front() == '?') {
-      // Not atom
-      return std::unordered_set<std::string>();
-    } else {
-      // Atom
-      return std::unordered_set<std::string>({value_});
-    }
-  } else {
-    // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-    std::unordered_set<std::string> values;
-    for (const auto& child : children_) {
-      const auto& child_atoms = child.CollectAtoms();
-      values.insert(child_atoms.begin(), child_atoms.end());
+bool IsAtomValue(const std::string& value) {
+  return value != "<=" && value.front() != '?';
+}
+
+// The Collect* traversals below are written as loops over a cursor so that
+// they work for one node as well as for a whole vector of nodes
+
+void CollectAtoms(TreeCursor cursor, std::unordered_set<std::string>& values) {
+  for (; cursor.IsValid(); cursor.Next()) {
+    const auto& value = cursor.GetNode()->GetValue();
+    if (IsAtomValue(value)) {
+      values.insert(value);
     }
-    return values;
   }
 }
 
-std::unordered_set<std::string> TreeNode::CollectNonFunctorAtoms() const {
-  if (is_leaf_) {
-    if (value_ == "<=" || value_.front() == '?') {
-      // Not atom
-      return std::unordered_set<std::string>();
-    } else {
-      // Non-functor atom
-      return std::unordered_set<std::string>({value_});
+void CollectNonFunctorAtoms(TreeCursor cursor, std::unordered_set<std::string>& values) {
+  for (; cursor.IsValid(); cursor.Next()) {
+    if (cursor.GetDepth() > 0 && cursor.GetIndex() == 0) {
+      // Ignore functor and search non-functor arguments
+      cursor.SkipSubtree();
+      continue;
     }
-  } else {
-    // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-    std::unordered_set<std::string> values;
-    // Ignore functor and search non-functor arguments
-    for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
-      const auto& child_atoms = i->CollectNonFunctorAtoms();
-      values.insert(child_atoms.begin(), child_atoms.end());
+    if (cursor.IsLeaf()) {
+      const auto& value = cursor.GetNode()->GetValue();
+      if (IsAtomValue(value)) {
+        values.insert(value);
+      }
     }
-    return values;
   }
 }
 
-std::unordered_map<std::string, int> TreeNode::CollectFunctorAtoms() const {
-  if (is_leaf_) {
-    // Not compound term
-    return std::unordered_map<std::string, int>();
-  } else {
-    // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-    std::unordered_map<std::string, int> values;
-    // Functor
-    if (children_.front().GetValue() != "<=") {
-      values.emplace(children_.front().GetValue(), children_.size() - 1);
+void CollectFunctorAtoms(TreeCursor cursor, std::unordered_map<std::string, int>& values) {
+  for (; cursor.IsValid(); cursor.Next()) {
+    if (cursor.IsLeaf()) {
+      // Not compound term
+      continue;
     }
-    // Search compound term arguments
-    for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
-      if (!i->IsLeaf()) {
-        const auto& child_atoms = i->CollectFunctorAtoms();
-        values.insert(child_atoms.begin(), child_atoms.end());
+    if (cursor.GetDepth() > 0 && cursor.GetIndex() == 0) {
+      // Compound term in functor position
+      cursor.SkipSubtree();
+      continue;
+    }
+    const auto& children = cursor.GetNode()->GetChildren();
+    assert(children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+    assert(children.front().IsLeaf() && "Compound term must start with functor.");
+    if (!children.empty() && children.front().GetValue() != "<=") {
+      // The smallest arity wins, which does not depend on the order of the
+      // clauses, so that RuleBase gives the same
+      const auto arity = static_cast<int>(children.size() - 1);
+      const auto inserted = values.emplace(children.front().GetValue(), arity);
+      if (!inserted.second && arity < inserted.first->second) {
+        inserted.first->second = arity;
       }
     }
-    return values;
   }
 }
 
+std::unordered_set<std::string> TreeNode::CollectAtoms() const {
+  std::unordered_set<std::string> values;
+  sexpr_parser::CollectAtoms(TreeCursor(*this, TraversalOrder::kLeavesOnly), values);
+  return values;
+}
+
+std::unordered_set<std::string> TreeNode::CollectNonFunctorAtoms() const {
+  std::unordered_set<std::string> values;
+  sexpr_parser::CollectNonFunctorAtoms(TreeCursor(*this), values);
+  return values;
+}
+
+std::unordered_map<std::string, int> TreeNode::CollectFunctorAtoms() const {
+  std::unordered_map<std::string, int> values;
+  sexpr_parser::CollectFunctorAtoms(TreeCursor(*this), values);
+  return values;
+}
+
 std::unordered_map<std::string, std::unordered_set<ArgPos>> TreeNode::CollectVariableArgs() const {
   assert(!is_leaf_);
   // Compound term
   assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
   assert(children_.front().IsLeaf() && "Compound term must start with functor.");
   std::unordered_map<std::string, std::unordered_set<ArgPos>> values;
-  const auto functor = children_.front().GetValue();
-  // Ignore functor and search non-functor arguments
-  for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
-    if (i->IsLeaf()) {
-      if (i->IsVariable()) {
-        const auto variable_name = i->GetValue();
-        const auto pos = std::distance(children_.begin(), i);
-        if (values.count(i->GetValue())) {
-          values.at(variable_name).emplace(functor, pos);
-        } else {
-          values.emplace(variable_name, std::unordered_set<ArgPos>({ ArgPos(functor, pos) }));
-        }
-      }
-    } else {
-      const auto tmp = i->CollectVariableArgs();
-      for (const auto t : tmp) {
-        if (values.count(t.first)) {
-          values.at(t.first).insert(t.second.begin(), t.second.end());
-        } else {
-          values.insert(t);
-        }
-      }
+  for (TreeCursor cursor(*this); cursor.IsValid(); cursor.Next()) {
+    if (cursor.GetDepth() == 0) {
+      continue;
+    }
+    if (cursor.GetIndex() == 0) {
+      // Ignore functor and search non-functor arguments
+      cursor.SkipSubtree();
+      continue;
+    }
+    if (cursor.GetNode()->IsVariable()) {
+      const auto& functor = cursor.GetParent()->GetChildren().front().GetValue();
+      const auto pos = static_cast<int>(cursor.GetIndex());
+      values[cursor.GetNode()->GetValue()].emplace(functor, pos);
     }
   }
   return values;
@@ -437,7 +519,7 @@ TreeNode TreeNode::ReplaceAtoms(const std::string& before, const std::string& af
     for (const auto& child : children_) {
       new_children.push_back(child.ReplaceAtoms(before, after));
     }
-    return TreeNode(new_children);
+    return TreeNode(std::move(new_children));
   }
 }
 
@@ -462,40 +544,11 @@ std::string RemoveComments(const std::string& sexpr) {
   return boost::regex_replace(sexpr, comment, std::string());
 }
 
-// Argument iterator must point to the token next to "("
-// When this function returns, iterator will point to corresponding ")"
-TreeNode ParseTillRightParen(Tokenizer::iterator& i, const bool flatten_tuple_with_one_child) {
-  std::vector<TreeNode> children;
-  for (; *i != ")"; ++i) {
-    if (*i == "(") {
-      // Skip left paren and parse inside parens
-      ++i;
-      children.push_back(ParseTillRightParen(i, flatten_tuple_with_one_child));
-    } else {
-      children.push_back(TreeNode(*i));
-    }
-  }
-  if (flatten_tuple_with_one_child && children.size() == 1) {
-    return TreeNode(children.front());
-  }
-  // When this function returns, the iterator is always pointing to ")"
-  return TreeNode(children);
-}
-
+// Parsing without limits never fails
 std::vector<TreeNode> Parse(const std::string& sexpr, bool flatten_tuple_with_one_child) {
-  Separator sep(" \n\t\r", "()");
-  const auto sexpr_no_comments = RemoveComments(sexpr);
-  Tokenizer tokens(sexpr_no_comments, sep);
   std::vector<TreeNode> results;
-  for (auto i = tokens.begin(); i != tokens.end(); ++i) {
-    if (*i == "(") {
-      // Skip left paren and parse inside parens
-      ++i;
-      results.push_back(ParseTillRightParen(i, flatten_tuple_with_one_child));
-    } else {
-      results.push_back(TreeNode(*i));
-    }
-  }
+  LimitError error;
+  ParseWithLimits(sexpr, ParseLimits(), results, error, flatten_tuple_with_one_child);
   return results;
 }
 
@@ -503,14 +556,14 @@ std::vector<TreeNode> ParseKIF(const std::string& kif) {
   return Parse(kif, true);
 }
 
-std::string GeneratePrologHelperClauses(
-    const std::vector<TreeNode>& nodes,
+void WritePrologHelperClauses(
+    std::ostream& o,
+    const std::unordered_map<std::string, int>& functors,
+    const std::unordered_set<ArgPosPair>& same_domain_args_pairs_in_body,
+    const std::unordered_set<ArgPosPair>& same_domain_args_pairs_between_head_and_body,
     const bool quotes_atoms,
-    const std::string& functor_prefix,
-    const std::string& atom_prefix) {
-  std::ostringstream o;
+    const std::string& functor_prefix) {
   // User defined functors
-  const auto functors = CollectFunctorAtoms(nodes);
   for (const auto& functor_arity_pair : functors) {
     if (reserved_words.count(functor_arity_pair.first)) {
       continue;
@@ -519,16 +572,6 @@ std::string GeneratePrologHelperClauses(
     o << "user_defined_functor(" << functor_atom << ", " << functor_arity_pair.second << ")." << std::endl;
   }
   // Same domain args
-  std::unordered_set<ArgPosPair> same_domain_args_pairs_in_body;
-  std::unordered_set<ArgPosPair> same_domain_args_pairs_between_head_and_body;
-  for (const auto& node : nodes) {
-    if (!node.IsLeaf() && node.GetChildren().front().GetValue() == "<=") {
-      const auto in_body = node.CollectSameDomainArgsInBody();
-      same_domain_args_pairs_in_body.insert(in_body.begin(), in_body.end());
-      const auto between_head_and_body = node.CollectSameDomainArgsBetweenHeadAndBody();
-      same_domain_args_pairs_between_head_and_body.insert(between_head_and_body.begin(), between_head_and_body.end());
-    }
-  }
   for (const auto& same_domain_args_pair : same_domain_args_pairs_in_body) {
     if (same_domain_args_pairs_between_head_and_body.count(same_domain_args_pair)) {
       continue;
@@ -546,6 +589,26 @@ std::string GeneratePrologHelperClauses(
     const auto pos2 = same_domain_args_pair.second.second;
     o << "equivalent_args(" << functor_atom1 << ", " << pos1 << ", " << functor_atom2 << ", " << pos2 << ")." << std::endl;
   }
+}
+
+std::string GeneratePrologHelperClauses(
+    const std::vector<TreeNode>& nodes,
+    const bool quotes_atoms,
+    const std::string& functor_prefix,
+    const std::string& atom_prefix) {
+  std::ostringstream o;
+  const auto functors = CollectFunctorAtoms(nodes);
+  std::unordered_set<ArgPosPair> same_domain_args_pairs_in_body;
+  std::unordered_set<ArgPosPair> same_domain_args_pairs_between_head_and_body;
+  for (const auto& node : nodes) {
+    if (!node.IsLeaf() && node.GetChildren().front().GetValue() == "<=") {
+      const auto in_body = node.CollectSameDomainArgsInBody();
+      same_domain_args_pairs_in_body.insert(in_body.begin(), in_body.end());
+      const auto between_head_and_body = node.CollectSameDomainArgsBetweenHeadAndBody();
+      same_domain_args_pairs_between_head_and_body.insert(between_head_and_body.begin(), between_head_and_body.end());
+    }
+  }
+  WritePrologHelperClauses(o, functors, same_domain_args_pairs_in_body, same_domain_args_pairs_between_head_and_body, quotes_atoms, functor_prefix);
   return o.str();
 }
 
@@ -556,39 +619,42 @@ std::string ToProlog(
     const std::string& atom_prefix,
     const bool adds_helper_clauses) {
   std::ostringstream o;
+  WriteProlog(o, nodes, quotes_atoms, functor_prefix, atom_prefix, adds_helper_clauses);
+  return o.str();
+}
+
+// Clauses are written one by one, so a reader at the other end of the
+// stream can start consulting before all of them are generated
+void WriteProlog(
+    std::ostream& o,
+    const std::vector<TreeNode>& nodes,
+    const bool quotes_atoms,
+    const std::string& functor_prefix,
+    const std::string& atom_prefix,
+    const bool adds_helper_clauses) {
   for (const auto& node : nodes) {
-    o << node.ToPrologClause(quotes_atoms, functor_prefix, atom_prefix) << std::endl;
+    o << node.ToPrologClause(quotes_atoms, functor_prefix, atom_prefix) << '\n';
   }
   if (adds_helper_clauses) {
-    o << GeneratePrologHelperClauses(nodes, quotes_atoms, functor_prefix, atom_prefix) << std::endl;
+    o << GeneratePrologHelperClauses(nodes, quotes_atoms, functor_prefix, atom_prefix) << '\n';
   }
-  return o.str();
 }
 
 std::unordered_set<std::string> CollectAtoms(const std::vector<TreeNode>& nodes) {
   std::unordered_set<std::string> values;
-  for (const auto& node : nodes) {
-    const auto& node_values = node.CollectAtoms();
-    values.insert(node_values.begin(), node_values.end());
-  }
+  CollectAtoms(TreeCursor(nodes, TraversalOrder::kLeavesOnly), values);
   return values;
 }
 
 std::unordered_set<std::string> CollectNonFunctorAtoms(const std::vector<TreeNode>& nodes) {
   std::unordered_set<std::string> values;
-  for (const auto& node : nodes) {
-    const auto& node_values = node.CollectNonFunctorAtoms();
-    values.insert(node_values.begin(), node_values.end());
-  }
+  CollectNonFunctorAtoms(TreeCursor(nodes), values);
   return values;
 }
 
 std::unordered_map<std::string, int> CollectFunctorAtoms(const std::vector<TreeNode>& nodes) {
   std::unordered_map<std::string, int> values;
-  for (const auto& node : nodes) {
-    const auto& node_values = node.CollectFunctorAtoms();
-    values.insert(node_values.begin(), node_values.end());
-  }
+  CollectFunctorAtoms(TreeCursor(nodes), values);
   return values;
 }
 
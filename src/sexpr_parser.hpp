@@ -1,11 +1,25 @@
 #ifndef SEXPR_PARSER_HPP_
 #define SEXPR_PARSER_HPP_
 
+#include <ostream>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
 
+#include <boost/functional/hash.hpp>
+
+// Needed by the sets of ArgPos and ArgPosPair in the interface
+namespace std
+{
+template <class T, class U>
+struct hash<pair<T, U>> {
+  size_t operator()(const pair<T, U>& a) const {
+    return boost::hash_value(a);
+  }
+};
+}
+
 namespace sexpr_parser {
 
 using ArgPos = std::pair<std::string, int>;
@@ -15,12 +29,21 @@ class TreeNode {
 public:
   TreeNode(const std::string& value);
   TreeNode(const std::vector<TreeNode>& children);
+  TreeNode(std::vector<TreeNode>&& children);
+  TreeNode(const TreeNode&) = default;
+  TreeNode(TreeNode&&) = default;
+  TreeNode& operator=(const TreeNode&) = default;
+  TreeNode& operator=(TreeNode&&) = default;
+  // Does not recurse, so that trees of any depth can be destroyed
+  ~TreeNode();
   bool IsLeaf() const;
   bool IsVariable() const;
   const std::string& GetValue() const;
   const std::vector<TreeNode>& GetChildren() const;
   std::string ToString() const;
+  std::string ToString(const std::size_t max_length) const;
   std::string ToSexpr() const;
+  std::string ToSexpr(const std::size_t max_length) const;
   std::string ChildrenToSexpr() const;
   std::string ToPrologAtom(const bool quotes_atoms, const std::string& atom_prefix) const;
   std::string ToPrologFunctor(const bool quotes_atoms, const std::string& functor_prefix) const;
@@ -35,17 +58,29 @@ public:
   TreeNode ReplaceAtoms(const std::string& before, const std::string& after) const;
   bool operator==(const TreeNode& another) const;
 private:
-  const bool is_leaf_;
-  const std::string value_;
-  const std::vector<TreeNode> children_;
+  // Not const so that nodes are moved rather than copied in containers
+  bool is_leaf_;
+  std::string value_;
+  std::vector<TreeNode> children_;
 };
 
 std::string RemoveComments(const std::string& sexpr);
 std::vector<TreeNode> Parse(const std::string& sexpr, const bool flatten_tuple_with_one_child = false);
 std::vector<TreeNode> ParseKIF(const std::string& kif);
 std::string ToProlog(const std::vector<TreeNode>& nodes, const bool quotes_atoms, const std::string& functor_prefix = "", const std::string& atom_prefix = "", const bool adds_helper_clauses = false);
+void WriteProlog(std::ostream& o, const std::vector<TreeNode>& nodes, const bool quotes_atoms, const std::string& functor_prefix = "", const std::string& atom_prefix = "", const bool adds_helper_clauses = false);
+// Writes user_defined_functor/2, connected_args/4 and equivalent_args/4
+// facts as ToProlog() does with adds_helper_clauses
+void WritePrologHelperClauses(
+    std::ostream& o,
+    const std::unordered_map<std::string, int>& functors,
+    const std::unordered_set<ArgPosPair>& same_domain_args_pairs_in_body,
+    const std::unordered_set<ArgPosPair>& same_domain_args_pairs_between_head_and_body,
+    const bool quotes_atoms,
+    const std::string& functor_prefix);
 std::unordered_set<std::string> CollectAtoms(const std::vector<TreeNode>& nodes);
 std::unordered_set<std::string> CollectNonFunctorAtoms(const std::vector<TreeNode>& nodes);
+// If a functor is used with several arities, the smallest one is returned
 std::unordered_map<std::string, int> CollectFunctorAtoms(const std::vector<TreeNode>& nodes);
 std::vector<TreeNode> ReplaceAtoms(const std::vector<TreeNode>& nodes, const std::string& before, const std::string& after);
 
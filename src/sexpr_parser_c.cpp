@@ -0,0 +1,107 @@
+#include "sexpr_parser_c.h"
+
+#include "flat_document.hpp"
+
+namespace sp = sexpr_parser;
+
+struct sp_document {
+  explicit sp_document(const std::vector<sp::TreeNode>& roots) : document(roots) {
+  }
+  const sp::FlatDocument document;
+};
+
+namespace {
+
+const sp_string_view kNoString = {nullptr, 0};
+
+bool IsValidNode(const sp_document* document, const sp_node node) {
+  return document && node < document->document.GetNodeCount();
+}
+
+sp_document* ParseDocument(const char* buffer, size_t length, const bool flatten_tuple_with_one_child) {
+  if (!buffer && length > 0) {
+    return nullptr;
+  }
+  // Exceptions must not propagate to C callers
+  try {
+    return new sp_document(sp::Parse(std::string(buffer, length), flatten_tuple_with_one_child));
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+}
+
+sp_document* sp_parse(const char* buffer, size_t length) {
+  return ParseDocument(buffer, length, false);
+}
+
+sp_document* sp_parse_kif(const char* buffer, size_t length) {
+  return ParseDocument(buffer, length, true);
+}
+
+void sp_document_free(sp_document* document) {
+  delete document;
+}
+
+size_t sp_document_root_count(const sp_document* document) {
+  return document ? document->document.GetRootCount() : 0;
+}
+
+sp_node sp_document_root(const sp_document* document, size_t index) {
+  if (!document || index >= document->document.GetRootCount()) {
+    return SP_NO_NODE;
+  }
+  return document->document.GetRoot(index);
+}
+
+size_t sp_document_node_count(const sp_document* document) {
+  return document ? document->document.GetNodeCount() : 0;
+}
+
+size_t sp_document_symbol_count(const sp_document* document) {
+  return document ? document->document.GetSymbolCount() : 0;
+}
+
+sp_string_view sp_document_symbol(const sp_document* document, uint32_t symbol) {
+  if (!document || symbol >= document->document.GetSymbolCount()) {
+    return kNoString;
+  }
+  return sp_string_view{document->document.GetSymbol(symbol), document->document.GetSymbolLength(symbol)};
+}
+
+sp_node_kind sp_node_get_kind(const sp_document* document, sp_node node) {
+  if (!IsValidNode(document, node)) {
+    return SP_NODE_INVALID;
+  }
+  return document->document.IsLeaf(node) ? SP_NODE_LEAF : SP_NODE_LIST;
+}
+
+sp_string_view sp_node_get_value(const sp_document* document, sp_node node) {
+  if (!IsValidNode(document, node)) {
+    return kNoString;
+  }
+  const auto symbol = document->document.GetNode(node).symbol;
+  if (symbol == sp::kNoSymbol) {
+    return sp_string_view{"", 0};
+  }
+  return sp_document_symbol(document, symbol);
+}
+
+uint32_t sp_node_get_symbol(const sp_document* document, sp_node node) {
+  if (!IsValidNode(document, node)) {
+    return UINT32_MAX;
+  }
+  return document->document.GetNode(node).symbol;
+}
+
+size_t sp_node_child_count(const sp_document* document, sp_node node) {
+  return IsValidNode(document, node) ? document->document.GetChildCount(node) : 0;
+}
+
+sp_node sp_node_child(const sp_document* document, sp_node node, size_t index) {
+  if (!IsValidNode(document, node) || index >= document->document.GetChildCount(node)) {
+    return SP_NO_NODE;
+  }
+  return document->document.GetChild(node, index);
+}
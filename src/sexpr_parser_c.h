@@ -0,0 +1,63 @@
+#ifndef SEXPR_PARSER_C_H_
+#define SEXPR_PARSER_C_H_
+
+/*
+ * C API for foreign function interfaces.
+ *
+ * A parsed document owns all of its nodes and strings. Nodes are referred
+ * to by index, and strings returned by the accessors point into document
+ * memory: they are null-terminated, valid until sp_document_free() and must
+ * not be freed by callers.
+ *
+ * Indices and handles are checked even in release builds. With a NULL
+ * document or an index out of range, counts are 0, nodes are SP_NO_NODE,
+ * kinds are SP_NODE_INVALID and string views are {NULL, 0}.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sp_document sp_document;
+typedef uint32_t sp_node;
+
+#define SP_NO_NODE UINT32_MAX
+
+typedef enum {
+  SP_NODE_INVALID = -1,
+  SP_NODE_LEAF = 0,
+  SP_NODE_LIST = 1
+} sp_node_kind;
+
+typedef struct {
+  const char* data;
+  size_t length;
+} sp_string_view;
+
+/* Return NULL on failure, or for a NULL buffer with a nonzero length */
+sp_document* sp_parse(const char* buffer, size_t length);
+sp_document* sp_parse_kif(const char* buffer, size_t length);
+void sp_document_free(sp_document* document);
+
+size_t sp_document_root_count(const sp_document* document);
+sp_node sp_document_root(const sp_document* document, size_t index);
+size_t sp_document_node_count(const sp_document* document);
+size_t sp_document_symbol_count(const sp_document* document);
+sp_string_view sp_document_symbol(const sp_document* document, uint32_t symbol);
+
+sp_node_kind sp_node_get_kind(const sp_document* document, sp_node node);
+/* Empty view for lists */
+sp_string_view sp_node_get_value(const sp_document* document, sp_node node);
+/* UINT32_MAX for lists and invalid nodes */
+uint32_t sp_node_get_symbol(const sp_document* document, sp_node node);
+size_t sp_node_child_count(const sp_document* document, sp_node node);
+sp_node sp_node_child(const sp_document* document, sp_node node, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEXPR_PARSER_C_H_ */
@@ -0,0 +1,85 @@
+#ifndef SEXPR_SCANNER_HPP_
+#define SEXPR_SCANNER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Tokenization shared by the parsers that scan the text themselves, so that
+// they all split it as Parse() does:
+// - a comment starts at any ';', even in the middle of an atom, and ends at
+//   the line end,
+// - ")" without an open list is an atom by itself,
+// - lists still open at the end of the text are closed implicitly, with
+//   MakeList() as for any other list.
+// Not part of the public interface.
+namespace scanner {
+
+inline bool IsSeparator(const char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+inline bool IsLineEnd(const char c) {
+  return c == '\n' || c == '\r';
+}
+
+inline bool IsAtomEnd(const char c) {
+  return IsSeparator(c) || c == '(' || c == ')' || c == ';';
+}
+
+// From a ';' to the line end or the end of the text
+inline std::size_t SkipComment(const char* data, std::size_t i, const std::size_t size) {
+  while (i < size && !IsLineEnd(data[i])) {
+    ++i;
+  }
+  return i;
+}
+
+// Skips separators and comments
+inline std::size_t SkipGap(const char* data, std::size_t i, const std::size_t size) {
+  while (i < size) {
+    if (IsSeparator(data[i])) {
+      ++i;
+    } else if (data[i] == ';') {
+      i = SkipComment(data, i, size);
+    } else {
+      break;
+    }
+  }
+  return i;
+}
+
+// End of the atom starting at begin, at most max_length characters long
+// (plus one, so that an atom that is too long can be told apart).
+// For ")" this is the end of a top-level ")" atom.
+inline std::size_t SkipAtom(const char* data, const std::size_t begin, const std::size_t size, const std::size_t max_length = SIZE_MAX) {
+  if (data[begin] == ')') {
+    return begin + 1;
+  }
+  auto i = begin;
+  while (i < size && !IsAtomEnd(data[i]) && i - begin <= max_length) {
+    ++i;
+  }
+  return i;
+}
+
+// Lowers the atom in place if it is a reserved word, as TreeNode does
+void LowerReservedWord(char* data, const std::size_t length);
+
+inline TreeNode MakeList(std::vector<TreeNode>&& children, const bool flatten_tuple_with_one_child) {
+  if (flatten_tuple_with_one_child && children.size() == 1) {
+    return std::move(children.front());
+  }
+  return TreeNode(std::move(children));
+}
+
+}
+
+}
+
+#endif /* SEXPR_SCANNER_HPP_ */
@@ -0,0 +1,135 @@
+#include "state_machine.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace sexpr_parser {
+
+DatalogStateMachine::DatalogStateMachine(const std::vector<TreeNode>& clauses) :
+    engine_(false), is_valid_(false), true_(0), does_(0), init_(0), legal_(0), next_(0), goal_(0), terminal_(0),
+    true_functor_(kNoTerm), does_functor_(kNoTerm), terminal_atom_(kNoTerm), roles_(),
+    is_evaluated_(false), state_(), has_moves_(false), moves_() {
+  for (const auto& clause : clauses) {
+    engine_.AddClause(clause);
+  }
+  const auto role = engine_.GetRelation("role", 1);
+  true_ = engine_.GetRelation("true", 1);
+  does_ = engine_.GetRelation("does", 2);
+  init_ = engine_.GetRelation("init", 1);
+  legal_ = engine_.GetRelation("legal", 2);
+  next_ = engine_.GetRelation("next", 1);
+  goal_ = engine_.GetRelation("goal", 2);
+  terminal_ = engine_.GetRelation("terminal", 0);
+  auto& store = engine_.GetTermStore();
+  true_functor_ = store.InternAtom("true");
+  does_functor_ = store.InternAtom("does");
+  terminal_atom_ = store.InternAtom("terminal");
+  if (!engine_.Stratify()) {
+    return;
+  }
+  engine_.SetInputs(std::vector<std::size_t>{true_, does_});
+  // Relations that do not depend on the state
+  engine_.Run();
+  for (const auto fact : engine_.GetFacts(role)) {
+    roles_.push_back(store.GetChild(fact, 1));
+  }
+  is_valid_ = !roles_.empty();
+}
+
+bool DatalogStateMachine::IsValid() const {
+  return is_valid_;
+}
+
+std::size_t DatalogStateMachine::GetRoleCount() const {
+  return roles_.size();
+}
+
+std::string DatalogStateMachine::GetRoleName(const std::size_t role) const {
+  return engine_.GetTermStore().ToTreeNode(roles_[role]).ToSexpr();
+}
+
+GameState DatalogStateMachine::GetInitialState() {
+  return GetArguments(init_);
+}
+
+bool DatalogStateMachine::IsTerminal(const GameState& state) {
+  Evaluate(state, nullptr);
+  return engine_.HasFact(terminal_, terminal_atom_);
+}
+
+std::vector<GameMove> DatalogStateMachine::GetLegalMoves(const GameState& state, const std::size_t role) {
+  assert(role < roles_.size());
+  Evaluate(state, nullptr);
+  const auto& store = engine_.GetTermStore();
+  std::vector<GameMove> moves;
+  for (const auto fact : engine_.GetFacts(legal_)) {
+    if (store.GetChild(fact, 1) == roles_[role]) {
+      moves.push_back(store.GetChild(fact, 2));
+    }
+  }
+  std::sort(moves.begin(), moves.end());
+  return moves;
+}
+
+int DatalogStateMachine::GetGoal(const GameState& state, const std::size_t role) {
+  assert(role < roles_.size());
+  Evaluate(state, nullptr);
+  const auto& store = engine_.GetTermStore();
+  for (const auto fact : engine_.GetFacts(goal_)) {
+    if (store.GetChild(fact, 1) == roles_[role] && store.IsAtom(store.GetChild(fact, 2))) {
+      return std::atoi(store.GetValue(store.GetChild(fact, 2)).c_str());
+    }
+  }
+  return -1;
+}
+
+GameState DatalogStateMachine::GetNextState(const GameState& state, const std::vector<GameMove>& moves) {
+  assert(moves.size() == roles_.size());
+  Evaluate(state, &moves);
+  return GetArguments(next_);
+}
+
+TreeNode DatalogStateMachine::ToTreeNode(const GameMove move) const {
+  return engine_.GetTermStore().ToTreeNode(move);
+}
+
+// "legal", "goal" and "terminal" must not depend on "does", so they are
+// reused from an evaluation with moves
+void DatalogStateMachine::Evaluate(const GameState& state, const std::vector<GameMove>* moves) {
+  assert(is_valid_);
+  if (is_evaluated_ && state == state_ && (!moves || (has_moves_ && *moves == moves_))) {
+    return;
+  }
+  engine_.ClearInputs();
+  auto& store = engine_.GetTermStore();
+  for (const auto fluent : state) {
+    const TermId children[] = {true_functor_, fluent};
+    engine_.AddFact(true_, store.InternList(children, 2));
+  }
+  if (moves) {
+    for (std::size_t i = 0; i < roles_.size(); ++i) {
+      const TermId children[] = {does_functor_, roles_[i], (*moves)[i]};
+      engine_.AddFact(does_, store.InternList(children, 3));
+    }
+  }
+  engine_.Run();
+  is_evaluated_ = true;
+  state_ = state;
+  has_moves_ = moves != nullptr;
+  if (moves) {
+    moves_ = *moves;
+  }
+}
+
+GameState DatalogStateMachine::GetArguments(const std::size_t relation) const {
+  const auto& store = engine_.GetTermStore();
+  GameState arguments;
+  for (const auto fact : engine_.GetFacts(relation)) {
+    arguments.push_back(store.GetChild(fact, 1));
+  }
+  std::sort(arguments.begin(), arguments.end());
+  return arguments;
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef STATE_MACHINE_HPP_
+#define STATE_MACHINE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "datalog.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Ids of the true fluents in ascending order, and ids of moves, only
+// meaningful to the state machine that made them
+using GameState = std::vector<std::uint32_t>;
+using GameMove = std::uint32_t;
+
+// Game rules as transitions between states, so that a backend can be
+// swapped, e.g. for one running the rules in Prolog.
+// A state machine is used by one thread at a time.
+class StateMachine {
+public:
+  virtual ~StateMachine() {}
+  virtual std::size_t GetRoleCount() const = 0;
+  virtual std::string GetRoleName(const std::size_t role) const = 0;
+  virtual GameState GetInitialState() = 0;
+  virtual bool IsTerminal(const GameState& state) = 0;
+  // Empty if the role has no legal move in the state
+  virtual std::vector<GameMove> GetLegalMoves(const GameState& state, const std::size_t role) = 0;
+  // -1 if the role has no goal value in the state
+  virtual int GetGoal(const GameState& state, const std::size_t role) = 0;
+  // One move for each role
+  virtual GameState GetNextState(const GameState& state, const std::vector<GameMove>& moves) = 0;
+  virtual TreeNode ToTreeNode(const GameMove move) const = 0;
+};
+
+// Evaluates the rules bottom-up with DatalogEngine for each state, with
+// "true", and "does" for the next state, as its inputs. Relations that
+// depend on neither, such as "role" and "init", are only computed once.
+// The results for the last state are kept, so that asking for the legal
+// moves of each role, the goals and whether the state is terminal
+// evaluates the state once.
+class DatalogStateMachine : public StateMachine {
+public:
+  explicit DatalogStateMachine(const std::vector<TreeNode>& clauses);
+  // False if the rules recurse through negation or have no roles
+  bool IsValid() const;
+  std::size_t GetRoleCount() const override;
+  std::string GetRoleName(const std::size_t role) const override;
+  GameState GetInitialState() override;
+  bool IsTerminal(const GameState& state) override;
+  std::vector<GameMove> GetLegalMoves(const GameState& state, const std::size_t role) override;
+  int GetGoal(const GameState& state, const std::size_t role) override;
+  GameState GetNextState(const GameState& state, const std::vector<GameMove>& moves) override;
+  TreeNode ToTreeNode(const GameMove move) const override;
+private:
+  // Without moves, relations depending on "does" are left empty
+  void Evaluate(const GameState& state, const std::vector<GameMove>* moves);
+  // Sorted arguments of the facts of a relation of arity 1
+  GameState GetArguments(const std::size_t relation) const;
+  DatalogEngine engine_;
+  bool is_valid_;
+  std::size_t true_;
+  std::size_t does_;
+  std::size_t init_;
+  std::size_t legal_;
+  std::size_t next_;
+  std::size_t goal_;
+  std::size_t terminal_;
+  TermId true_functor_;
+  TermId does_functor_;
+  TermId terminal_atom_;
+  std::vector<TermId> roles_;
+  // Inputs of the last evaluation
+  bool is_evaluated_;
+  GameState state_;
+  bool has_moves_;
+  std::vector<GameMove> moves_;
+};
+
+}
+
+#endif /* STATE_MACHINE_HPP_ */
@@ -0,0 +1,693 @@
+#include "succinct_tree.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "tree_cursor.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+const std::size_t kSuperblockWords = 8;
+const std::size_t kSuperblockBits = kSuperblockWords * 64;
+const std::ptrdiff_t kBlockBits = 512;
+const std::ptrdiff_t kNotFound = -2;
+const char kMagic[8] = {'S', 'X', 'S', 'U', 'C', 'C', '0', '1'};
+
+// Excess changes over the 8 parentheses of a byte, from its lowest bit
+struct ByteExcessTable {
+  ByteExcessTable() {
+    for (auto byte = 0; byte < 256; ++byte) {
+      auto excess = 0;
+      auto min_prefix = INT_MAX;
+      for (auto bit = 0; bit < 8; ++bit) {
+        excess += (byte >> bit & 1) ? 1 : -1;
+        min_prefix = std::min(min_prefix, excess);
+      }
+      auto suffix = 0;
+      auto max_suffix = 0;
+      for (auto bit = 7; bit > 0; --bit) {
+        suffix += (byte >> bit & 1) ? 1 : -1;
+        max_suffix = std::max(max_suffix, suffix);
+      }
+      totals[byte] = static_cast<std::int8_t>(excess);
+      min_prefixes[byte] = static_cast<std::int8_t>(min_prefix);
+      max_suffixes[byte] = static_cast<std::int8_t>(max_suffix);
+    }
+  }
+  std::int8_t totals[256];
+  // Minimum excess after each of the bits
+  std::int8_t min_prefixes[256];
+  // Maximum change over the bits after each of the bits, which gives the
+  // minimum excess at each bit when the excess at the last bit is known
+  std::int8_t max_suffixes[256];
+};
+
+const ByteExcessTable& GetByteExcessTable() {
+  static const ByteExcessTable table;
+  return table;
+}
+
+template <class T>
+void WriteValue(std::ostream& o, const T value) {
+  o.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+bool ReadValue(std::istream& i, T& value) {
+  return static_cast<bool>(i.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void WriteWords(std::ostream& o, const std::vector<std::uint64_t>& words) {
+  WriteValue<std::uint64_t>(o, words.size());
+  o.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(std::uint64_t));
+}
+
+bool ReadWords(std::istream& i, const std::size_t expected_count, std::vector<std::uint64_t>& words) {
+  std::uint64_t count = 0;
+  if (!ReadValue(i, count) || count != expected_count) {
+    return false;
+  }
+  words.resize(count);
+  return static_cast<bool>(i.read(reinterpret_cast<char*>(words.data()), count * sizeof(std::uint64_t)));
+}
+
+std::size_t GetWordCount(const std::size_t bits) {
+  return (bits + 63) / 64;
+}
+
+}
+
+BitVector::BitVector() : words_(), size_(0), superblock_ranks_() {
+}
+
+void BitVector::PushBack(const bool bit) {
+  if (size_ % 64 == 0) {
+    words_.push_back(0);
+  }
+  if (bit) {
+    words_.back() |= std::uint64_t(1) << (size_ % 64);
+  }
+  ++size_;
+}
+
+void BitVector::BuildIndex() {
+  words_.shrink_to_fit();
+  superblock_ranks_.assign(words_.size() / kSuperblockWords + 1, 0);
+  std::uint64_t rank = 0;
+  for (std::size_t i = 0; i < words_.size(); ++i) {
+    if (i % kSuperblockWords == 0) {
+      superblock_ranks_[i / kSuperblockWords] = rank;
+    }
+    rank += __builtin_popcountll(words_[i]);
+  }
+  if (words_.size() % kSuperblockWords == 0) {
+    superblock_ranks_.back() = rank;
+  }
+}
+
+std::size_t BitVector::GetSize() const {
+  return size_;
+}
+
+bool BitVector::Get(const std::size_t position) const {
+  assert(position < size_);
+  return (words_[position / 64] >> (position % 64)) & 1;
+}
+
+std::size_t BitVector::Rank1(const std::size_t position) const {
+  assert(position <= size_);
+  const auto superblock = position / kSuperblockBits;
+  auto rank = superblock_ranks_[superblock];
+  for (auto i = superblock * kSuperblockWords; i < position / 64; ++i) {
+    rank += __builtin_popcountll(words_[i]);
+  }
+  if (position % 64 > 0) {
+    rank += __builtin_popcountll(words_[position / 64] & ((std::uint64_t(1) << (position % 64)) - 1));
+  }
+  return rank;
+}
+
+std::size_t BitVector::Select1(const std::size_t rank) const {
+  // The last superblock whose preceding ones are at most rank
+  const auto superblock = std::upper_bound(superblock_ranks_.begin(), superblock_ranks_.end(), rank) - superblock_ranks_.begin() - 1;
+  auto rest = rank - superblock_ranks_[superblock];
+  for (auto i = superblock * kSuperblockWords; i < words_.size(); ++i) {
+    const auto count = static_cast<std::size_t>(__builtin_popcountll(words_[i]));
+    if (rest < count) {
+      auto word = words_[i];
+      for (; rest > 0; --rest) {
+        word &= word - 1;
+      }
+      return i * 64 + __builtin_ctzll(word);
+    }
+    rest -= count;
+  }
+  assert(false && "Rank must be less than the number of ones.");
+  return size_;
+}
+
+const std::vector<std::uint64_t>& BitVector::GetWords() const {
+  return words_;
+}
+
+void BitVector::Assign(std::vector<std::uint64_t>&& words, const std::size_t size) {
+  assert(words.size() == GetWordCount(size));
+  words_ = std::move(words);
+  size_ = size;
+  // Bits past the size are zero, as PushBack() leaves them
+  if (size_ % 64 > 0) {
+    words_.back() &= (std::uint64_t(1) << (size_ % 64)) - 1;
+  }
+}
+
+std::size_t BitVector::GetMemoryUsage() const {
+  return words_.capacity() * sizeof(std::uint64_t) + superblock_ranks_.capacity() * sizeof(std::uint64_t);
+}
+
+PackedIntVector::PackedIntVector() : words_(), width_(1), size_(0) {
+}
+
+PackedIntVector::PackedIntVector(const std::size_t width, const std::size_t size) :
+    words_(GetWordCount(width * size)), width_(width), size_(size) {
+  assert(width > 0 && width <= 32);
+}
+
+std::size_t PackedIntVector::GetWidth() const {
+  return width_;
+}
+
+std::size_t PackedIntVector::GetSize() const {
+  return size_;
+}
+
+std::uint64_t PackedIntVector::Get(const std::size_t index) const {
+  assert(index < size_);
+  const auto bit = index * width_;
+  const auto offset = bit % 64;
+  auto value = words_[bit / 64] >> offset;
+  if (offset + width_ > 64) {
+    value |= words_[bit / 64 + 1] << (64 - offset);
+  }
+  return value & ((std::uint64_t(1) << width_) - 1);
+}
+
+void PackedIntVector::Set(const std::size_t index, const std::uint64_t value) {
+  assert(index < size_);
+  assert(value < (std::uint64_t(1) << width_));
+  const auto bit = index * width_;
+  const auto offset = bit % 64;
+  const auto mask = (std::uint64_t(1) << width_) - 1;
+  words_[bit / 64] = (words_[bit / 64] & ~(mask << offset)) | (value << offset);
+  if (offset + width_ > 64) {
+    const auto shift = 64 - offset;
+    words_[bit / 64 + 1] = (words_[bit / 64 + 1] & ~(mask >> shift)) | (value >> shift);
+  }
+}
+
+const std::vector<std::uint64_t>& PackedIntVector::GetWords() const {
+  return words_;
+}
+
+void PackedIntVector::Assign(std::vector<std::uint64_t>&& words, const std::size_t width, const std::size_t size) {
+  assert(width > 0 && width <= 32);
+  assert(words.size() == GetWordCount(width * size));
+  words_ = std::move(words);
+  width_ = width;
+  size_ = size;
+}
+
+std::size_t PackedIntVector::GetMemoryUsage() const {
+  return words_.capacity() * sizeof(std::uint64_t);
+}
+
+SuccinctTree::SuccinctTree() :
+    parentheses_(),
+    leaves_(),
+    leaf_symbols_(),
+    root_count_(0),
+    symbol_data_(),
+    symbol_offsets_(),
+    min_excesses_(),
+    min_excess_leaf_offset_(0) {
+  BuildIndex();
+}
+
+SuccinctTree::SuccinctTree(const std::vector<TreeNode>& roots) :
+    parentheses_(),
+    leaves_(),
+    leaf_symbols_(),
+    root_count_(0),
+    symbol_data_(),
+    symbol_offsets_(),
+    min_excesses_(),
+    min_excess_leaf_offset_(0) {
+  std::vector<SymbolId> leaf_symbols;
+  std::unordered_map<std::string, SymbolId> symbol_ids;
+  // Non-recursive pre-order walk, so that untrusted input of any depth
+  // can be archived. Nodes are closed before the next node as far as it is
+  // shallower, and the rest at the end.
+  std::size_t open_count = 0;
+  for (TreeCursor cursor(roots); cursor.IsValid(); cursor.Next()) {
+    for (; open_count > cursor.GetDepth(); --open_count) {
+      parentheses_.PushBack(false);
+    }
+    AddNode(*cursor.GetNode(), leaf_symbols, symbol_ids);
+    ++open_count;
+  }
+  for (; open_count > 0; --open_count) {
+    parentheses_.PushBack(false);
+  }
+  // Just enough bits for the largest symbol id
+  std::size_t width = 1;
+  while (width < 32 && (std::uint64_t(1) << width) < symbol_ids.size()) {
+    ++width;
+  }
+  leaf_symbols_ = PackedIntVector(width, leaf_symbols.size());
+  for (std::size_t i = 0; i < leaf_symbols.size(); ++i) {
+    leaf_symbols_.Set(i, leaf_symbols[i]);
+  }
+  symbol_data_.shrink_to_fit();
+  const auto balanced = BuildIndex();
+  assert(balanced);
+  (void)balanced;
+}
+
+void SuccinctTree::AddNode(const TreeNode& node, std::vector<SymbolId>& leaf_symbols, std::unordered_map<std::string, SymbolId>& symbol_ids) {
+  parentheses_.PushBack(true);
+  leaves_.PushBack(node.IsLeaf());
+  if (node.IsLeaf()) {
+    // Symbol ids in order of first appearance
+    const auto inserted = symbol_ids.emplace(node.GetValue(), static_cast<SymbolId>(symbol_ids.size()));
+    if (inserted.second) {
+      symbol_data_.append(node.GetValue());
+      symbol_data_.push_back('\0');
+    }
+    leaf_symbols.push_back(inserted.first->second);
+  }
+}
+
+bool SuccinctTree::BuildIndex() {
+  parentheses_.BuildIndex();
+  leaves_.BuildIndex();
+  const auto size = static_cast<std::ptrdiff_t>(parentheses_.GetSize());
+  if (size % 2 != 0 || leaves_.GetSize() != static_cast<std::size_t>(size / 2)) {
+    return false;
+  }
+  // Block minimums at the leaves, padded to a power of two
+  const auto block_count = static_cast<std::size_t>((size + kBlockBits - 1) / kBlockBits);
+  min_excess_leaf_offset_ = 1;
+  while (min_excess_leaf_offset_ < block_count) {
+    min_excess_leaf_offset_ *= 2;
+  }
+  min_excesses_.assign(min_excess_leaf_offset_ * 2, INT32_MAX);
+  std::ptrdiff_t excess = 0;
+  std::size_t preorder = 0;
+  root_count_ = 0;
+  for (std::ptrdiff_t i = 0; i < size; ++i) {
+    if (parentheses_.Get(i)) {
+      // Leaves must be written as "()"
+      if (leaves_.Get(preorder) && (i + 1 >= size || parentheses_.Get(i + 1))) {
+        return false;
+      }
+      ++preorder;
+      ++excess;
+    } else {
+      --excess;
+      if (excess < 0) {
+        return false;
+      }
+      if (excess == 0) {
+        ++root_count_;
+      }
+    }
+    auto& block_min = min_excesses_[min_excess_leaf_offset_ + i / kBlockBits];
+    block_min = std::min(block_min, static_cast<std::int32_t>(excess));
+  }
+  if (excess != 0) {
+    return false;
+  }
+  for (auto i = min_excess_leaf_offset_ - 1; i > 0; --i) {
+    min_excesses_[i] = std::min(min_excesses_[i * 2], min_excesses_[i * 2 + 1]);
+  }
+  // Symbols are null-terminated, so their offsets need not be stored
+  symbol_offsets_.clear();
+  symbol_offsets_.push_back(0);
+  for (std::size_t i = 0; i < symbol_data_.size(); ++i) {
+    if (symbol_data_[i] == '\0') {
+      symbol_offsets_.push_back(static_cast<std::uint32_t>(i + 1));
+    }
+  }
+  if (!symbol_data_.empty() && symbol_data_.back() != '\0') {
+    return false;
+  }
+  symbol_offsets_.shrink_to_fit();
+  if (leaf_symbols_.GetSize() != leaves_.Rank1(leaves_.GetSize())) {
+    return false;
+  }
+  for (std::size_t i = 0; i < leaf_symbols_.GetSize(); ++i) {
+    if (leaf_symbols_.Get(i) >= GetSymbolCount()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::ptrdiff_t SuccinctTree::GetExcess(const std::ptrdiff_t position) const {
+  if (position < 0) {
+    return 0;
+  }
+  return 2 * static_cast<std::ptrdiff_t>(parentheses_.Rank1(position + 1)) - (position + 1);
+}
+
+std::ptrdiff_t SuccinctTree::ScanForward(std::ptrdiff_t begin, const std::ptrdiff_t end, std::ptrdiff_t excess, const std::ptrdiff_t target) const {
+  const auto& table = GetByteExcessTable();
+  const auto& words = parentheses_.GetWords();
+  while (begin < end) {
+    if (begin % 8 == 0 && begin + 8 <= end) {
+      // Skips a whole byte that does not reach target
+      const auto byte = (words[begin / 64] >> (begin % 64)) & 0xff;
+      if (excess + table.min_prefixes[byte] > target) {
+        excess += table.totals[byte];
+        begin += 8;
+        continue;
+      }
+    }
+    excess += parentheses_.Get(begin) ? 1 : -1;
+    if (excess <= target) {
+      assert(excess == target);
+      return begin;
+    }
+    ++begin;
+  }
+  return kNotFound;
+}
+
+std::ptrdiff_t SuccinctTree::ScanBackward(std::ptrdiff_t last, const std::ptrdiff_t begin, std::ptrdiff_t excess, const std::ptrdiff_t target) const {
+  const auto& table = GetByteExcessTable();
+  const auto& words = parentheses_.GetWords();
+  while (last >= begin) {
+    if (last % 8 == 7 && last - 7 >= begin) {
+      const auto byte = (words[last / 64] >> (last % 64 - 7)) & 0xff;
+      if (excess - table.max_suffixes[byte] > target) {
+        excess -= table.totals[byte];
+        last -= 8;
+        continue;
+      }
+    }
+    if (excess <= target) {
+      assert(excess == target);
+      return last;
+    }
+    excess -= parentheses_.Get(last) ? 1 : -1;
+    --last;
+  }
+  return kNotFound;
+}
+
+std::ptrdiff_t SuccinctTree::FindBlockForward(const std::ptrdiff_t block, const std::ptrdiff_t target) const {
+  if (block >= static_cast<std::ptrdiff_t>(min_excess_leaf_offset_)) {
+    return kNotFound;
+  }
+  auto node = min_excess_leaf_offset_ + block;
+  if (min_excesses_[node] > target) {
+    // Climbs until a right sibling has it
+    for (;;) {
+      if (node == 1) {
+        return kNotFound;
+      }
+      if (node % 2 == 0 && min_excesses_[node + 1] <= target) {
+        node = node + 1;
+        break;
+      }
+      node /= 2;
+    }
+    // Descends to its leftmost block that has it
+    while (node < min_excess_leaf_offset_) {
+      node = min_excesses_[node * 2] <= target ? node * 2 : node * 2 + 1;
+    }
+  }
+  return node - min_excess_leaf_offset_;
+}
+
+std::ptrdiff_t SuccinctTree::FindBlockBackward(const std::ptrdiff_t block, const std::ptrdiff_t target) const {
+  if (block < 0) {
+    return kNotFound;
+  }
+  auto node = min_excess_leaf_offset_ + block;
+  if (min_excesses_[node] > target) {
+    for (;;) {
+      if (node == 1) {
+        return kNotFound;
+      }
+      if (node % 2 == 1 && min_excesses_[node - 1] <= target) {
+        node = node - 1;
+        break;
+      }
+      node /= 2;
+    }
+    while (node < min_excess_leaf_offset_) {
+      node = min_excesses_[node * 2 + 1] <= target ? node * 2 + 1 : node * 2;
+    }
+  }
+  return node - min_excess_leaf_offset_;
+}
+
+std::ptrdiff_t SuccinctTree::SearchForward(const std::ptrdiff_t position, const std::ptrdiff_t target) const {
+  const auto size = static_cast<std::ptrdiff_t>(parentheses_.GetSize());
+  const auto block = position / kBlockBits;
+  const auto found = ScanForward(position + 1, std::min(size, (block + 1) * kBlockBits), GetExcess(position), target);
+  if (found != kNotFound) {
+    return found;
+  }
+  const auto next_block = FindBlockForward(block + 1, target);
+  if (next_block == kNotFound) {
+    return kNotFound;
+  }
+  const auto begin = next_block * kBlockBits;
+  return ScanForward(begin, std::min(size, begin + kBlockBits), GetExcess(begin - 1), target);
+}
+
+std::ptrdiff_t SuccinctTree::SearchBackward(const std::ptrdiff_t position, const std::ptrdiff_t target) const {
+  const auto size = static_cast<std::ptrdiff_t>(parentheses_.GetSize());
+  const auto block = position / kBlockBits;
+  if (position > block * kBlockBits) {
+    const auto found = ScanBackward(position - 1, block * kBlockBits, GetExcess(position - 1), target);
+    if (found != kNotFound) {
+      return found;
+    }
+  }
+  const auto previous_block = FindBlockBackward(block - 1, target);
+  if (previous_block == kNotFound) {
+    return target == 0 ? -1 : kNotFound;
+  }
+  const auto last = std::min(size, (previous_block + 1) * kBlockBits) - 1;
+  return ScanBackward(last, previous_block * kBlockBits, GetExcess(last), target);
+}
+
+std::size_t SuccinctTree::FindClose(const SuccinctNode node) const {
+  const auto position = static_cast<std::ptrdiff_t>(node);
+  const auto close = SearchForward(position, GetExcess(position) - 1);
+  assert(close != kNotFound);
+  return close;
+}
+
+std::size_t SuccinctTree::GetNodeCount() const {
+  return parentheses_.GetSize() / 2;
+}
+
+std::size_t SuccinctTree::GetRootCount() const {
+  return root_count_;
+}
+
+SuccinctNode SuccinctTree::GetFirstRoot() const {
+  return parentheses_.GetSize() > 0 ? 0 : kNoSuccinctNode;
+}
+
+SuccinctNode SuccinctTree::GetNode(const std::size_t preorder) const {
+  assert(preorder < GetNodeCount());
+  return parentheses_.Select1(preorder);
+}
+
+std::size_t SuccinctTree::GetPreorder(const SuccinctNode node) const {
+  assert(parentheses_.Get(node));
+  return parentheses_.Rank1(node);
+}
+
+bool SuccinctTree::IsLeaf(const SuccinctNode node) const {
+  return leaves_.Get(GetPreorder(node));
+}
+
+std::size_t SuccinctTree::GetDepth(const SuccinctNode node) const {
+  assert(parentheses_.Get(node));
+  return GetExcess(node) - 1;
+}
+
+std::size_t SuccinctTree::GetSubtreeSize(const SuccinctNode node) const {
+  assert(parentheses_.Get(node));
+  return (FindClose(node) - node + 1) / 2;
+}
+
+SuccinctNode SuccinctTree::GetParent(const SuccinctNode node) const {
+  assert(parentheses_.Get(node));
+  const auto position = static_cast<std::ptrdiff_t>(node);
+  const auto excess = GetExcess(position);
+  if (excess == 1) {
+    return kNoSuccinctNode;
+  }
+  // The parenthesis before the parent's opening one has the excess of the
+  // parent's parent
+  const auto before_parent = SearchBackward(position, excess - 2);
+  assert(before_parent != kNotFound);
+  return before_parent + 1;
+}
+
+SuccinctNode SuccinctTree::GetFirstChild(const SuccinctNode node) const {
+  assert(parentheses_.Get(node));
+  return parentheses_.Get(node + 1) ? node + 1 : kNoSuccinctNode;
+}
+
+SuccinctNode SuccinctTree::GetNextSibling(const SuccinctNode node) const {
+  const auto next = FindClose(node) + 1;
+  return next < parentheses_.GetSize() && parentheses_.Get(next) ? next : kNoSuccinctNode;
+}
+
+std::size_t SuccinctTree::GetChildCount(const SuccinctNode node) const {
+  std::size_t count = 0;
+  for (auto child = GetFirstChild(node); child != kNoSuccinctNode; child = GetNextSibling(child)) {
+    ++count;
+  }
+  return count;
+}
+
+SuccinctNode SuccinctTree::GetChild(const SuccinctNode node, const std::size_t index) const {
+  auto child = GetFirstChild(node);
+  for (std::size_t i = 0; i < index; ++i) {
+    assert(child != kNoSuccinctNode);
+    child = GetNextSibling(child);
+  }
+  assert(child != kNoSuccinctNode);
+  return child;
+}
+
+SymbolId SuccinctTree::GetSymbolId(const SuccinctNode node) const {
+  const auto preorder = GetPreorder(node);
+  assert(leaves_.Get(preorder));
+  return static_cast<SymbolId>(leaf_symbols_.Get(leaves_.Rank1(preorder)));
+}
+
+std::size_t SuccinctTree::GetSymbolCount() const {
+  return symbol_offsets_.size() - 1;
+}
+
+const char* SuccinctTree::GetSymbol(const SymbolId symbol) const {
+  assert(symbol < GetSymbolCount());
+  return symbol_data_.data() + symbol_offsets_[symbol];
+}
+
+std::size_t SuccinctTree::GetSymbolLength(const SymbolId symbol) const {
+  assert(symbol < GetSymbolCount());
+  return symbol_offsets_[symbol + 1] - symbol_offsets_[symbol] - 1;
+}
+
+// Scans the parentheses of the subtree once, with the lists being rebuilt
+// on an explicit stack
+TreeNode SuccinctTree::ToTreeNode(const SuccinctNode node) const {
+  const auto end = FindClose(node) + 1;
+  auto preorder = GetPreorder(node);
+  auto leaf_rank = leaves_.Rank1(preorder);
+  // Complete subtrees, the children built so far of each open list last
+  std::vector<TreeNode> subtrees;
+  // Position in subtrees of the first child of each open list
+  std::vector<std::size_t> open_lists;
+  for (auto i = node; i < end; ++i) {
+    if (!parentheses_.Get(i)) {
+      const auto first_child = subtrees.begin() + open_lists.back();
+      open_lists.pop_back();
+      std::vector<TreeNode> children(std::make_move_iterator(first_child), std::make_move_iterator(subtrees.end()));
+      subtrees.erase(first_child, subtrees.end());
+      subtrees.push_back(TreeNode(std::move(children)));
+    } else if (leaves_.Get(preorder++)) {
+      const auto symbol = static_cast<SymbolId>(leaf_symbols_.Get(leaf_rank++));
+      subtrees.push_back(TreeNode(std::string(GetSymbol(symbol), GetSymbolLength(symbol))));
+      // The leaf's own close
+      ++i;
+    } else {
+      open_lists.push_back(subtrees.size());
+    }
+  }
+  return std::move(subtrees.back());
+}
+
+std::vector<TreeNode> SuccinctTree::ToTreeNodes() const {
+  std::vector<TreeNode> roots;
+  roots.reserve(root_count_);
+  for (auto root = GetFirstRoot(); root != kNoSuccinctNode; root = GetNextSibling(root)) {
+    roots.push_back(ToTreeNode(root));
+  }
+  return roots;
+}
+
+std::size_t SuccinctTree::GetMemoryUsage() const {
+  return parentheses_.GetMemoryUsage() +
+      leaves_.GetMemoryUsage() +
+      leaf_symbols_.GetMemoryUsage() +
+      symbol_data_.capacity() +
+      symbol_offsets_.capacity() * sizeof(std::uint32_t) +
+      min_excesses_.capacity() * sizeof(std::int32_t);
+}
+
+void SuccinctTree::Write(std::ostream& o) const {
+  o.write(kMagic, sizeof(kMagic));
+  WriteValue<std::uint64_t>(o, parentheses_.GetSize());
+  WriteWords(o, parentheses_.GetWords());
+  WriteWords(o, leaves_.GetWords());
+  WriteValue<std::uint64_t>(o, leaf_symbols_.GetWidth());
+  WriteValue<std::uint64_t>(o, leaf_symbols_.GetSize());
+  WriteWords(o, leaf_symbols_.GetWords());
+  WriteValue<std::uint64_t>(o, symbol_data_.size());
+  o.write(symbol_data_.data(), symbol_data_.size());
+}
+
+bool SuccinctTree::Read(std::istream& i) {
+  char magic[sizeof(kMagic)];
+  if (!i.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  std::uint64_t size = 0;
+  std::vector<std::uint64_t> parentheses;
+  std::vector<std::uint64_t> leaves;
+  std::uint64_t width = 0;
+  std::uint64_t leaf_count = 0;
+  std::vector<std::uint64_t> leaf_symbols;
+  std::uint64_t symbol_data_size = 0;
+  if (!ReadValue(i, size) ||
+      !ReadWords(i, GetWordCount(size), parentheses) ||
+      !ReadWords(i, GetWordCount(size / 2), leaves) ||
+      !ReadValue(i, width) || width == 0 || width > 32 ||
+      !ReadValue(i, leaf_count) || leaf_count > size / 2 ||
+      !ReadWords(i, GetWordCount(width * leaf_count), leaf_symbols) ||
+      !ReadValue(i, symbol_data_size)) {
+    return false;
+  }
+  std::string symbol_data(symbol_data_size, '\0');
+  if (!i.read(&symbol_data[0], symbol_data_size)) {
+    return false;
+  }
+  parentheses_.Assign(std::move(parentheses), size);
+  leaves_.Assign(std::move(leaves), size / 2);
+  leaf_symbols_.Assign(std::move(leaf_symbols), width, leaf_count);
+  symbol_data_ = std::move(symbol_data);
+  if (!BuildIndex()) {
+    *this = SuccinctTree();
+    return false;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,153 @@
+#ifndef SUCCINCT_TREE_HPP_
+#define SUCCINCT_TREE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+#include "symbol_table.hpp"
+
+namespace sexpr_parser {
+
+// Bits with rank and select.
+// The cumulative count of ones is stored every 512 bits, which is 1/8 bit
+// per bit, and the rest is counted by popcount.
+class BitVector {
+public:
+  BitVector();
+  void PushBack(const bool bit);
+  // Must be called after the last PushBack() and before Rank1()/Select1()
+  void BuildIndex();
+  std::size_t GetSize() const;
+  bool Get(const std::size_t position) const;
+  // Number of ones in [0, position)
+  std::size_t Rank1(const std::size_t position) const;
+  // Position of the rank-th one counted from 0
+  std::size_t Select1(const std::size_t rank) const;
+  const std::vector<std::uint64_t>& GetWords() const;
+  // Replaces the bits, after which BuildIndex() must be called
+  void Assign(std::vector<std::uint64_t>&& words, const std::size_t size);
+  std::size_t GetMemoryUsage() const;
+private:
+  std::vector<std::uint64_t> words_;
+  std::size_t size_;
+  std::vector<std::uint64_t> superblock_ranks_;
+};
+
+// Unsigned integers packed at a fixed number of bits each
+class PackedIntVector {
+public:
+  PackedIntVector();
+  PackedIntVector(const std::size_t width, const std::size_t size);
+  std::size_t GetWidth() const;
+  std::size_t GetSize() const;
+  std::uint64_t Get(const std::size_t index) const;
+  void Set(const std::size_t index, const std::uint64_t value);
+  const std::vector<std::uint64_t>& GetWords() const;
+  void Assign(std::vector<std::uint64_t>&& words, const std::size_t width, const std::size_t size);
+  std::size_t GetMemoryUsage() const;
+private:
+  std::vector<std::uint64_t> words_;
+  std::size_t width_;
+  std::size_t size_;
+};
+
+// Position of the opening parenthesis of a node
+using SuccinctNode = std::size_t;
+
+const SuccinctNode kNoSuccinctNode = SIZE_MAX;
+
+// Immutable forest in a few bits per node, for archives of many trees.
+// The shape is a balanced parentheses sequence of 2 bits per node in
+// pre-order, a second bitvector tells leaves from empty lists, and leaves
+// have their symbol ids packed at just enough bits for the symbol count.
+// Navigation runs on the sequence itself with a range min-max tree over
+// blocks of 512 parentheses, so it takes O(log n) block lookups and a scan
+// of at most two blocks, without decompressing anything.
+// Together with the rank directories, the shape takes about 3.6 bits per
+// node.
+class SuccinctTree {
+public:
+  SuccinctTree();
+  explicit SuccinctTree(const std::vector<TreeNode>& roots);
+  std::size_t GetNodeCount() const;
+  std::size_t GetRootCount() const;
+  // kNoSuccinctNode for an empty forest
+  SuccinctNode GetFirstRoot() const;
+  // Node of the given pre-order number
+  SuccinctNode GetNode(const std::size_t preorder) const;
+  std::size_t GetPreorder(const SuccinctNode node) const;
+  bool IsLeaf(const SuccinctNode node) const;
+  // 0 for roots
+  std::size_t GetDepth(const SuccinctNode node) const;
+  // Number of nodes in the subtree including the node itself
+  std::size_t GetSubtreeSize(const SuccinctNode node) const;
+  // kNoSuccinctNode for roots
+  SuccinctNode GetParent(const SuccinctNode node) const;
+  // kNoSuccinctNode for leaves and empty lists
+  SuccinctNode GetFirstChild(const SuccinctNode node) const;
+  // Roots are siblings of each other. kNoSuccinctNode for the last one.
+  SuccinctNode GetNextSibling(const SuccinctNode node) const;
+  // Linear in the number of children
+  std::size_t GetChildCount(const SuccinctNode node) const;
+  SuccinctNode GetChild(const SuccinctNode node, const std::size_t index) const;
+  // Only for leaves
+  SymbolId GetSymbolId(const SuccinctNode node) const;
+  std::size_t GetSymbolCount() const;
+  const char* GetSymbol(const SymbolId symbol) const;
+  std::size_t GetSymbolLength(const SymbolId symbol) const;
+  TreeNode ToTreeNode(const SuccinctNode node) const;
+  std::vector<TreeNode> ToTreeNodes() const;
+  // Bytes of all the arrays including the navigation indices
+  std::size_t GetMemoryUsage() const;
+  // Only the parentheses, leaf flags, symbol ids and symbols are written,
+  // and the indices are rebuilt by Read(). Words are in host byte order.
+  void Write(std::ostream& o) const;
+  // False for a stream that was not written by Write() or is truncated
+  bool Read(std::istream& i);
+private:
+  // Opens the node, which is closed by the caller
+  void AddNode(const TreeNode& node, std::vector<SymbolId>& leaf_symbols, std::unordered_map<std::string, SymbolId>& symbol_ids);
+  // Builds the rank directories and the range min-max tree, and rebuilds
+  // the symbol offsets. False if the parentheses are not balanced.
+  bool BuildIndex();
+  // Open minus close parentheses in [0, position], where -1 gives 0
+  std::ptrdiff_t GetExcess(const std::ptrdiff_t position) const;
+  // Smallest position after the given one whose excess is target, which
+  // must be below the excess of the given position
+  std::ptrdiff_t SearchForward(const std::ptrdiff_t position, const std::ptrdiff_t target) const;
+  // Largest position before the given one whose excess is target, which
+  // must be below the excess of the given position. -1 for target 0 when
+  // only the start of the sequence has it.
+  std::ptrdiff_t SearchBackward(const std::ptrdiff_t position, const std::ptrdiff_t target) const;
+  // Scans [begin, end) forward and [begin, last] backward for the first
+  // excess at most target, given the excess before begin or at last
+  std::ptrdiff_t ScanForward(std::ptrdiff_t begin, const std::ptrdiff_t end, std::ptrdiff_t excess, const std::ptrdiff_t target) const;
+  std::ptrdiff_t ScanBackward(std::ptrdiff_t last, const std::ptrdiff_t begin, std::ptrdiff_t excess, const std::ptrdiff_t target) const;
+  // Nearest block from the given one, in the direction of the search,
+  // whose minimum excess is at most target
+  std::ptrdiff_t FindBlockForward(const std::ptrdiff_t block, const std::ptrdiff_t target) const;
+  std::ptrdiff_t FindBlockBackward(const std::ptrdiff_t block, const std::ptrdiff_t target) const;
+  std::size_t FindClose(const SuccinctNode node) const;
+  BitVector parentheses_;
+  // Indexed by pre-order number
+  BitVector leaves_;
+  // Indexed by leaf rank
+  PackedIntVector leaf_symbols_;
+  std::size_t root_count_;
+  std::string symbol_data_;
+  std::vector<std::uint32_t> symbol_offsets_;
+  // Minimum excess of each block, as a complete binary tree in an array
+  // with the root at 1
+  std::vector<std::int32_t> min_excesses_;
+  std::size_t min_excess_leaf_offset_;
+};
+
+}
+
+#endif /* SUCCINCT_TREE_HPP_ */
@@ -0,0 +1,128 @@
+#ifdef SEXPR_PARSER_WITH_SWIPL
+
+#include "swipl_loader.hpp"
+
+#include <cassert>
+
+namespace sexpr_parser {
+
+SwiPrologLoader::SwiPrologLoader(const std::string& functor_prefix, const std::string& atom_prefix, const std::string& module) :
+    functor_prefix_(functor_prefix),
+    atom_prefix_(atom_prefix),
+    module_(PL_new_module(PL_new_atom(module.c_str()))),
+    assertz_(PL_predicate("assertz", 1, "system")),
+    rule_functor_(PL_new_functor(PL_new_atom(":-"), 2)),
+    conjunction_functor_(PL_new_functor(PL_new_atom(","), 2)),
+    atoms_(),
+    functor_names_(),
+    functors_() {
+}
+
+atom_t SwiPrologLoader::GetCachedAtom(std::unordered_map<std::string, atom_t>& cache, const std::string& prefix, const std::string& value) {
+  const auto found = cache.find(value);
+  if (found != cache.end()) {
+    return found->second;
+  }
+  // The reference returned by PL_new_atom() keeps the atom alive while cached
+  const auto atom = PL_new_atom((prefix + value).c_str());
+  cache.emplace(value, atom);
+  return atom;
+}
+
+functor_t SwiPrologLoader::GetFunctor(const std::string& value, const int arity) {
+  const auto name = GetCachedAtom(functor_names_, functor_prefix_, value);
+  const auto key = std::make_pair(name, arity);
+  const auto found = functors_.find(key);
+  if (found != functors_.end()) {
+    return found->second;
+  }
+  const auto functor = PL_new_functor(name, arity);
+  functors_.emplace(key, functor);
+  return functor;
+}
+
+bool SwiPrologLoader::PutTerm(const TreeNode& node, VariableMap& variables, const term_t t) {
+  if (node.IsLeaf()) {
+    if (node.IsVariable()) {
+      // Variables with the same name share one term reference in a clause
+      const auto found = variables.find(node.GetValue());
+      if (found != variables.end()) {
+        return PL_put_term(t, found->second);
+      }
+      const auto variable = PL_new_term_ref();
+      variables.emplace(node.GetValue(), variable);
+      return PL_put_term(t, variable);
+    } else {
+      // Non-functor atom term
+      return PL_put_atom(t, GetCachedAtom(atoms_, atom_prefix_, node.GetValue()));
+    }
+  } else {
+    // Compound term
+    const auto& children = node.GetChildren();
+    assert(children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+    assert(children.front().IsLeaf() && "Compound term must start with functor.");
+    const auto arity = static_cast<int>(children.size() - 1);
+    const auto args = PL_new_term_refs(arity);
+    for (auto i = 0; i < arity; ++i) {
+      if (!PutTerm(children[i + 1], variables, args + i)) {
+        return false;
+      }
+    }
+    return PL_cons_functor_v(t, GetFunctor(children.front().GetValue(), arity), args);
+  }
+}
+
+bool SwiPrologLoader::PutConjunction(
+    std::vector<TreeNode>::const_iterator begin,
+    std::vector<TreeNode>::const_iterator end,
+    VariableMap& variables,
+    const term_t t) {
+  assert(begin != end);
+  if (begin + 1 == end) {
+    return PutTerm(*begin, variables, t);
+  }
+  // (A, B, C) is ','(A, ','(B, C))
+  const auto args = PL_new_term_refs(2);
+  return PutTerm(*begin, variables, args) &&
+      PutConjunction(begin + 1, end, variables, args + 1) &&
+      PL_cons_functor_v(t, conjunction_functor_, args);
+}
+
+bool SwiPrologLoader::AssertClause(const TreeNode& node) {
+  const auto frame = PL_open_foreign_frame();
+  const auto clause = PL_new_term_ref();
+  VariableMap variables;
+  auto ok = false;
+  if (!node.IsLeaf() && !node.GetChildren().empty() && node.GetChildren().front().GetValue() == "<=") {
+    // Rule clause
+    const auto& children = node.GetChildren();
+    assert(children.size() >= 2 && "Rule clause must have head.");
+    if (children.size() == 2) {
+      ok = PutTerm(children.at(1), variables, clause);
+    } else {
+      const auto args = PL_new_term_refs(2);
+      ok = PutTerm(children.at(1), variables, args) &&
+          PutConjunction(children.begin() + 2, children.end(), variables, args + 1) &&
+          PL_cons_functor_v(clause, rule_functor_, args);
+    }
+  } else {
+    // Fact clause
+    ok = PutTerm(node, variables, clause);
+  }
+  ok = ok && PL_call_predicate(module_, PL_Q_NODEBUG | PL_Q_CATCH_EXCEPTION, assertz_, clause);
+  PL_discard_foreign_frame(frame);
+  return ok;
+}
+
+bool SwiPrologLoader::AssertClauses(const std::vector<TreeNode>& nodes) {
+  for (const auto& node : nodes) {
+    if (!AssertClause(node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+#endif /* SEXPR_PARSER_WITH_SWIPL */
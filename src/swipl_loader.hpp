@@ -0,0 +1,49 @@
+#ifndef SWIPL_LOADER_HPP_
+#define SWIPL_LOADER_HPP_
+
+#ifdef SEXPR_PARSER_WITH_SWIPL
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <SWI-Prolog.h>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Loads clauses into an embedded SWI-Prolog engine by constructing terms
+// through the foreign interface instead of formatting and re-reading text.
+// Atoms are always created as atoms, which corresponds to ToProlog() with
+// quotes_atoms == true.
+// The engine must already be initialized by PL_initialise().
+class SwiPrologLoader {
+public:
+  SwiPrologLoader(const std::string& functor_prefix = "", const std::string& atom_prefix = "", const std::string& module = "user");
+  bool AssertClause(const TreeNode& node);
+  bool AssertClauses(const std::vector<TreeNode>& nodes);
+private:
+  using VariableMap = std::unordered_map<std::string, term_t>;
+  atom_t GetCachedAtom(std::unordered_map<std::string, atom_t>& cache, const std::string& prefix, const std::string& value);
+  functor_t GetFunctor(const std::string& value, const int arity);
+  bool PutTerm(const TreeNode& node, VariableMap& variables, const term_t t);
+  bool PutConjunction(std::vector<TreeNode>::const_iterator begin, std::vector<TreeNode>::const_iterator end, VariableMap& variables, const term_t t);
+  const std::string functor_prefix_;
+  const std::string atom_prefix_;
+  const module_t module_;
+  const predicate_t assertz_;
+  const functor_t rule_functor_;
+  const functor_t conjunction_functor_;
+  std::unordered_map<std::string, atom_t> atoms_;
+  std::unordered_map<std::string, atom_t> functor_names_;
+  std::map<std::pair<atom_t, int>, functor_t> functors_;
+};
+
+}
+
+#endif /* SEXPR_PARSER_WITH_SWIPL */
+
+#endif /* SWIPL_LOADER_HPP_ */
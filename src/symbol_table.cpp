@@ -0,0 +1,251 @@
+#include "symbol_table.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace sexpr_parser {
+
+struct SymbolTable::Entry {
+  std::uint64_t hash;
+  SymbolId id;
+  std::uint32_t length;
+  // Null-terminated, allocated with the entry
+  char data[1];
+};
+
+namespace {
+
+const std::size_t kShardBits = 6;
+const std::size_t kFirstSegmentSize = 1024;
+const std::size_t kStorageChunkSize = 64 * 1024;
+
+// FNV-1a
+std::uint64_t Hash(const char* data, const std::size_t length) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Open addressing table, replaced by a twice larger one when half full
+struct HashTable {
+  explicit HashTable(const std::size_t capacity) : mask(capacity - 1), size(0), slots(new std::atomic<const void*>[capacity]) {
+    for (std::size_t i = 0; i < capacity; ++i) {
+      slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  std::size_t mask;
+  std::size_t size;
+  std::unique_ptr<std::atomic<const void*>[]> slots;
+};
+
+// Direct-mapped cache of the calling thread's recent entries of one table
+struct ThreadCache {
+  std::uint64_t serial;
+  const void* entries[256];
+};
+
+thread_local ThreadCache thread_cache = {0, {}};
+
+std::atomic<std::uint64_t> next_serial(1);
+
+std::size_t GetSegment(const SymbolId symbol, std::size_t& offset) {
+  const auto x = symbol / kFirstSegmentSize + 1;
+  std::size_t segment = 0;
+  while ((x >> (segment + 1)) != 0) {
+    ++segment;
+  }
+  offset = symbol - kFirstSegmentSize * ((std::size_t(1) << segment) - 1);
+  return segment;
+}
+
+}
+
+struct SymbolTable::Shard {
+  Shard() : mutex(), table(), retired_tables(), chunks(), chunk_rest(0), chunk_next(nullptr) {
+    auto initial = new HashTable(64);
+    table.store(initial, std::memory_order_relaxed);
+  }
+  ~Shard() {
+    delete table.load(std::memory_order_relaxed);
+  }
+  // Entries are allocated in chunks that are never moved or released
+  // before the table
+  Entry* AllocateEntry(const std::size_t length) {
+    const auto size = (offsetof(Entry, data) + length + 1 + 7) / 8 * 8;
+    if (size > chunk_rest) {
+      const auto chunk_size = std::max(size, kStorageChunkSize);
+      chunks.emplace_back(new std::uint64_t[chunk_size / 8]);
+      chunk_next = reinterpret_cast<char*>(chunks.back().get());
+      chunk_rest = chunk_size;
+    }
+    const auto entry = reinterpret_cast<Entry*>(chunk_next);
+    chunk_next += size;
+    chunk_rest -= size;
+    return entry;
+  }
+  // Called with the mutex held
+  void Insert(const Entry* entry) {
+    auto current = static_cast<HashTable*>(table.load(std::memory_order_relaxed));
+    if ((current->size + 1) * 2 > current->mask + 1) {
+      auto grown = new HashTable((current->mask + 1) * 2);
+      for (std::size_t i = 0; i <= current->mask; ++i) {
+        const auto old_entry = current->slots[i].load(std::memory_order_relaxed);
+        if (old_entry) {
+          PutSlot(*grown, static_cast<const Entry*>(old_entry));
+        }
+      }
+      grown->size = current->size;
+      table.store(grown, std::memory_order_release);
+      // Readers may still probe the old table, so it is kept until the end
+      retired_tables.emplace_back(current);
+      current = grown;
+    }
+    PutSlot(*current, entry);
+    ++current->size;
+  }
+  static void PutSlot(HashTable& hash_table, const Entry* entry) {
+    auto i = entry->hash & hash_table.mask;
+    while (hash_table.slots[i].load(std::memory_order_relaxed)) {
+      i = (i + 1) & hash_table.mask;
+    }
+    hash_table.slots[i].store(entry, std::memory_order_release);
+  }
+  std::mutex mutex;
+  std::atomic<HashTable*> table;
+  std::vector<std::unique_ptr<HashTable>> retired_tables;
+  std::vector<std::unique_ptr<std::uint64_t[]>> chunks;
+  std::size_t chunk_rest;
+  char* chunk_next;
+};
+
+SymbolTable::SymbolTable() :
+    serial_(next_serial.fetch_add(1)),
+    shards_(new Shard[std::size_t(1) << kShardBits]),
+    next_id_(0),
+    segments_() {
+  for (auto& segment : segments_) {
+    segment.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+SymbolTable::~SymbolTable() {
+  for (auto& segment : segments_) {
+    delete[] segment.load(std::memory_order_relaxed);
+  }
+}
+
+const SymbolTable::Entry* SymbolTable::FindEntry(const Shard& shard, const std::uint64_t hash, const char* data, const std::size_t length) const {
+  const auto hash_table = shard.table.load(std::memory_order_acquire);
+  for (auto i = hash & hash_table->mask; ; i = (i + 1) & hash_table->mask) {
+    const auto entry = static_cast<const Entry*>(hash_table->slots[i].load(std::memory_order_acquire));
+    if (!entry) {
+      return nullptr;
+    }
+    if (entry->hash == hash && entry->length == length && std::memcmp(entry->data, data, length) == 0) {
+      return entry;
+    }
+  }
+}
+
+SymbolId SymbolTable::Intern(const char* data, const std::size_t length) {
+  const auto hash = Hash(data, length);
+  auto& cache = thread_cache;
+  if (cache.serial != serial_) {
+    cache.serial = serial_;
+    std::fill(std::begin(cache.entries), std::end(cache.entries), nullptr);
+  }
+  auto& cached = cache.entries[hash & 255];
+  const auto cached_entry = static_cast<const Entry*>(cached);
+  if (cached_entry && cached_entry->hash == hash && cached_entry->length == length && std::memcmp(cached_entry->data, data, length) == 0) {
+    return cached_entry->id;
+  }
+  auto& shard = shards_[hash >> (64 - kShardBits)];
+  auto entry = FindEntry(shard, hash, data, length);
+  if (!entry) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Another thread may have inserted it after the lock-free lookup
+    entry = FindEntry(shard, hash, data, length);
+    if (!entry) {
+      const auto new_entry = shard.AllocateEntry(length);
+      new_entry->hash = hash;
+      new_entry->id = next_id_.fetch_add(1);
+      assert(new_entry->id != kNoSymbol);
+      new_entry->length = static_cast<std::uint32_t>(length);
+      std::memcpy(new_entry->data, data, length);
+      new_entry->data[length] = '\0';
+      // Reachable by id before by value, so that any id handed out works
+      Publish(new_entry);
+      shard.Insert(new_entry);
+      entry = new_entry;
+    }
+  }
+  cached = entry;
+  return entry->id;
+}
+
+SymbolId SymbolTable::Intern(const std::string& value) {
+  return Intern(value.data(), value.size());
+}
+
+SymbolId SymbolTable::Find(const char* data, const std::size_t length) const {
+  const auto hash = Hash(data, length);
+  const auto entry = FindEntry(shards_[hash >> (64 - kShardBits)], hash, data, length);
+  return entry ? entry->id : kNoSymbol;
+}
+
+SymbolId SymbolTable::Find(const std::string& value) const {
+  return Find(value.data(), value.size());
+}
+
+void SymbolTable::Publish(const Entry* entry) {
+  std::size_t offset = 0;
+  const auto segment_index = GetSegment(entry->id, offset);
+  auto& segment = segments_[segment_index];
+  auto entries = segment.load(std::memory_order_acquire);
+  if (!entries) {
+    // Shards race for a new segment, and the losers discard theirs
+    const auto size = kFirstSegmentSize << segment_index;
+    auto new_entries = new std::atomic<const Entry*>[size];
+    for (std::size_t i = 0; i < size; ++i) {
+      new_entries[i].store(nullptr, std::memory_order_relaxed);
+    }
+    if (segment.compare_exchange_strong(entries, new_entries, std::memory_order_acq_rel)) {
+      entries = new_entries;
+    } else {
+      delete[] new_entries;
+    }
+  }
+  entries[offset].store(entry, std::memory_order_release);
+}
+
+const SymbolTable::Entry* SymbolTable::GetEntry(const SymbolId symbol) const {
+  std::size_t offset = 0;
+  const auto segment_index = GetSegment(symbol, offset);
+  const auto entries = segments_[segment_index].load(std::memory_order_acquire);
+  assert(entries);
+  const auto entry = entries[offset].load(std::memory_order_acquire);
+  assert(entry);
+  return entry;
+}
+
+std::size_t SymbolTable::GetSymbolCount() const {
+  return next_id_.load(std::memory_order_acquire);
+}
+
+const char* SymbolTable::GetSymbol(const SymbolId symbol) const {
+  return GetEntry(symbol)->data;
+}
+
+std::size_t SymbolTable::GetSymbolLength(const SymbolId symbol) const {
+  return GetEntry(symbol)->length;
+}
+
+}
@@ -0,0 +1,56 @@
+#ifndef SYMBOL_TABLE_HPP_
+#define SYMBOL_TABLE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace sexpr_parser {
+
+using SymbolId = std::uint32_t;
+
+const SymbolId kNoSymbol = UINT32_MAX;
+
+// Symbol table shared by threads, so that symbol ids of documents built in
+// parallel or for different matches can be compared.
+// Ids are dense and stable, and symbol strings are null-terminated and
+// never moved while the table lives.
+// Lookups are lock-free, and each thread first checks a small cache of its
+// recent symbols. Insertions lock one of 64 shards chosen by hash.
+class SymbolTable {
+public:
+  SymbolTable();
+  ~SymbolTable();
+  SymbolTable(const SymbolTable&) = delete;
+  SymbolTable& operator=(const SymbolTable&) = delete;
+  SymbolId Intern(const char* data, const std::size_t length);
+  SymbolId Intern(const std::string& value);
+  // kNoSymbol when not interned yet
+  SymbolId Find(const char* data, const std::size_t length) const;
+  SymbolId Find(const std::string& value) const;
+  // Symbols being inserted by other threads may or may not be counted
+  std::size_t GetSymbolCount() const;
+  // Only for ids returned by Intern() or Find()
+  const char* GetSymbol(const SymbolId symbol) const;
+  std::size_t GetSymbolLength(const SymbolId symbol) const;
+private:
+  struct Entry;
+  struct Shard;
+  const Entry* FindEntry(const Shard& shard, const std::uint64_t hash, const char* data, const std::size_t length) const;
+  const Entry* GetEntry(const SymbolId symbol) const;
+  void Publish(const Entry* entry);
+  // Process-wide serial number that tells thread caches of tables apart,
+  // even when a table is allocated at the address of a destroyed one
+  const std::uint64_t serial_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<SymbolId> next_id_;
+  // Segment k holds the entries of 1024 << k ids, so entries are never
+  // moved as the table grows
+  std::atomic<std::atomic<const Entry*>*> segments_[32];
+};
+
+}
+
+#endif /* SYMBOL_TABLE_HPP_ */
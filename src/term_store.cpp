@@ -0,0 +1,128 @@
+#include "term_store.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace sexpr_parser {
+
+namespace {
+
+std::size_t HashChildren(const TermId* children, const std::size_t count) {
+  std::uint64_t hash = count;
+  for (std::size_t i = 0; i < count; ++i) {
+    hash = (hash ^ children[i]) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 29;
+  }
+  return static_cast<std::size_t>(hash);
+}
+
+}
+
+TermStore::TermStore() : symbols_(), terms_(), children_(), atoms_(), slots_(64, kNoTerm), list_count_(0), intern_stack_() {
+}
+
+TermId TermStore::InternAtom(const std::string& value) {
+  const auto symbol = symbols_.Intern(value);
+  const auto found = atoms_.find(symbol);
+  if (found != atoms_.end()) {
+    return found->second;
+  }
+  const auto term = static_cast<TermId>(terms_.size());
+  terms_.push_back(Term{symbol, 0, 0});
+  atoms_.emplace(symbol, term);
+  return term;
+}
+
+TermId TermStore::InternList(const TermId* children, const std::size_t count) {
+  const auto slot = FindSlot(children, count);
+  if (slots_[slot] != kNoTerm) {
+    return slots_[slot];
+  }
+  const auto term = static_cast<TermId>(terms_.size());
+  terms_.push_back(Term{kNoSymbol, static_cast<std::uint32_t>(children_.size()), static_cast<std::uint32_t>(count)});
+  children_.insert(children_.end(), children, children + count);
+  slots_[slot] = term;
+  if (++list_count_ * 2 > slots_.size()) {
+    Rehash();
+  }
+  return term;
+}
+
+TermId TermStore::FindList(const TermId* children, const std::size_t count) const {
+  return slots_[FindSlot(children, count)];
+}
+
+// Each list pushes its children above those of the lists it is nested in
+// and pops them once interned
+TermId TermStore::Intern(const TreeNode& node) {
+  if (node.IsLeaf()) {
+    return InternAtom(node.GetValue());
+  }
+  const auto begin = intern_stack_.size();
+  for (const auto& child : node.GetChildren()) {
+    const auto term = Intern(child);
+    intern_stack_.push_back(term);
+  }
+  const auto term = InternList(intern_stack_.data() + begin, intern_stack_.size() - begin);
+  intern_stack_.resize(begin);
+  return term;
+}
+
+bool TermStore::IsAtom(const TermId term) const {
+  return terms_[term].symbol != kNoSymbol;
+}
+
+std::string TermStore::GetValue(const TermId term) const {
+  assert(IsAtom(term));
+  const auto symbol = terms_[term].symbol;
+  return std::string(symbols_.GetSymbol(symbol), symbols_.GetSymbolLength(symbol));
+}
+
+std::size_t TermStore::GetChildCount(const TermId term) const {
+  return terms_[term].child_count;
+}
+
+TermId TermStore::GetChild(const TermId term, const std::size_t index) const {
+  assert(index < terms_[term].child_count);
+  return children_[terms_[term].child_offset + index];
+}
+
+TreeNode TermStore::ToTreeNode(const TermId term) const {
+  const auto& entry = terms_[term];
+  if (entry.symbol != kNoSymbol) {
+    return TreeNode(GetValue(term));
+  }
+  std::vector<TreeNode> children;
+  children.reserve(entry.child_count);
+  for (std::size_t i = 0; i < entry.child_count; ++i) {
+    children.push_back(ToTreeNode(GetChild(term, i)));
+  }
+  return TreeNode(std::move(children));
+}
+
+std::size_t TermStore::FindSlot(const TermId* children, const std::size_t count) const {
+  const auto mask = slots_.size() - 1;
+  for (auto slot = HashChildren(children, count) & mask; ; slot = (slot + 1) & mask) {
+    const auto term = slots_[slot];
+    if (term == kNoTerm) {
+      return slot;
+    }
+    const auto& entry = terms_[term];
+    if (entry.child_count == count && std::equal(children, children + count, children_.data() + entry.child_offset)) {
+      return slot;
+    }
+  }
+}
+
+void TermStore::Rehash() {
+  std::vector<TermId> old_slots(slots_.size() * 2, kNoTerm);
+  old_slots.swap(slots_);
+  for (const auto term : old_slots) {
+    if (term != kNoTerm) {
+      const auto& entry = terms_[term];
+      slots_[FindSlot(children_.data() + entry.child_offset, entry.child_count)] = term;
+    }
+  }
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef TERM_STORE_HPP_
+#define TERM_STORE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+#include "symbol_table.hpp"
+
+namespace sexpr_parser {
+
+using TermId = std::uint32_t;
+
+const TermId kNoTerm = UINT32_MAX;
+
+// Hash-consed ground terms. A term is an atom or a list of terms, so that
+// (cell 1 1 b) is the list of the atoms cell, 1, 1 and b, and equal terms
+// have equal ids.
+class TermStore {
+public:
+  TermStore();
+  TermStore(const TermStore&) = delete;
+  TermStore& operator=(const TermStore&) = delete;
+  TermId InternAtom(const std::string& value);
+  // Copies the children, so that they may be a temporary array
+  TermId InternList(const TermId* children, const std::size_t count);
+  // kNoTerm if not interned
+  TermId FindList(const TermId* children, const std::size_t count) const;
+  // Allocates nothing for terms interned before
+  TermId Intern(const TreeNode& node);
+  bool IsAtom(const TermId term) const;
+  // Value of an atom
+  std::string GetValue(const TermId term) const;
+  std::size_t GetChildCount(const TermId term) const;
+  TermId GetChild(const TermId term, const std::size_t index) const;
+  TreeNode ToTreeNode(const TermId term) const;
+private:
+  struct Term {
+    // kNoSymbol for lists
+    SymbolId symbol;
+    std::uint32_t child_offset;
+    std::uint32_t child_count;
+  };
+  // Slot of the list, or the empty slot to insert it in
+  std::size_t FindSlot(const TermId* children, const std::size_t count) const;
+  void Rehash();
+  SymbolTable symbols_;
+  std::vector<Term> terms_;
+  std::vector<TermId> children_;
+  std::unordered_map<SymbolId, TermId> atoms_;
+  // Open addressing over list terms
+  std::vector<TermId> slots_;
+  std::size_t list_count_;
+  // Children of the lists being interned by Intern()
+  std::vector<TermId> intern_stack_;
+};
+
+}
+
+#endif /* TERM_STORE_HPP_ */
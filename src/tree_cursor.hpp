@@ -0,0 +1,195 @@
+#ifndef TREE_CURSOR_HPP_
+#define TREE_CURSOR_HPP_
+
+#include <cassert>
+#include <vector>
+
+#include "flat_document.hpp"
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+enum class TraversalOrder {
+  kPreOrder,
+  kPostOrder,
+  kLeavesOnly
+};
+
+// Adapters give BasicTreeCursor uniform access to a forest.
+// They refer to the nodes, which must outlive them.
+class TreeNodeAdapter {
+public:
+  using Node = const TreeNode*;
+  TreeNodeAdapter(const std::vector<TreeNode>& roots) : roots_(roots.data()), root_count_(roots.size()) {
+  }
+  TreeNodeAdapter(const TreeNode& root) : roots_(&root), root_count_(1) {
+  }
+  std::size_t GetRootCount() const {
+    return root_count_;
+  }
+  Node GetRoot(const std::size_t index) const {
+    return roots_ + index;
+  }
+  bool IsLeaf(const Node node) const {
+    return node->IsLeaf();
+  }
+  std::size_t GetChildCount(const Node node) const {
+    return node->GetChildren().size();
+  }
+  Node GetChild(const Node node, const std::size_t index) const {
+    return &node->GetChildren()[index];
+  }
+private:
+  const TreeNode* roots_;
+  std::size_t root_count_;
+};
+
+class FlatDocumentAdapter {
+public:
+  using Node = NodeIndex;
+  FlatDocumentAdapter(const FlatDocument& document) : document_(&document) {
+  }
+  std::size_t GetRootCount() const {
+    return document_->GetRootCount();
+  }
+  Node GetRoot(const std::size_t index) const {
+    return document_->GetRoot(index);
+  }
+  bool IsLeaf(const Node node) const {
+    return document_->IsLeaf(node);
+  }
+  std::size_t GetChildCount(const Node node) const {
+    return document_->GetChildCount(node);
+  }
+  Node GetChild(const Node node, const std::size_t index) const {
+    return document_->GetChild(node, index);
+  }
+private:
+  const FlatDocument* document_;
+};
+
+// Non-recursive traversal of a forest.
+// The cursor keeps the current node together with its ancestors and their
+// child positions, so depth, path and parent are available in O(1).
+//   for (TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next()) {
+//     ... cursor.GetNode() ...
+//   }
+template <class Adapter>
+class BasicTreeCursor {
+public:
+  using Node = typename Adapter::Node;
+  BasicTreeCursor(const Adapter& adapter, const TraversalOrder order = TraversalOrder::kPreOrder) :
+      adapter_(adapter), order_(order), nodes_(), path_(), exiting_(false), skips_children_(false) {
+    // One allocation per stack for usual depths
+    nodes_.reserve(16);
+    path_.reserve(16);
+    if (adapter_.GetRootCount() > 0) {
+      Push(adapter_.GetRoot(0), 0);
+      Settle();
+    }
+  }
+  bool IsValid() const {
+    return !nodes_.empty();
+  }
+  void Next() {
+    assert(IsValid());
+    Step();
+    Settle();
+  }
+  // In pre-order traversal, the following Next() does not enter the
+  // children of the current node
+  void SkipSubtree() {
+    skips_children_ = true;
+  }
+  Node GetNode() const {
+    assert(IsValid());
+    return nodes_.back();
+  }
+  bool IsLeaf() const {
+    return adapter_.IsLeaf(GetNode());
+  }
+  // 0 for roots
+  std::size_t GetDepth() const {
+    assert(IsValid());
+    return nodes_.size() - 1;
+  }
+  // Index among the siblings, or among the roots for roots
+  std::size_t GetIndex() const {
+    assert(IsValid());
+    return path_.back();
+  }
+  // Root index followed by child indices from the root to the current node
+  const std::vector<std::size_t>& GetPath() const {
+    return path_;
+  }
+  Node GetParent() const {
+    assert(GetDepth() > 0);
+    return nodes_[nodes_.size() - 2];
+  }
+  const Adapter& GetAdapter() const {
+    return adapter_;
+  }
+private:
+  void Push(const Node node, const std::size_t index) {
+    nodes_.push_back(node);
+    path_.push_back(index);
+    exiting_ = false;
+  }
+  // Advances by one enter or exit event
+  void Step() {
+    if (!exiting_) {
+      const auto node = nodes_.back();
+      if (!skips_children_ && !adapter_.IsLeaf(node) && adapter_.GetChildCount(node) > 0) {
+        Push(adapter_.GetChild(node, 0), 0);
+      } else {
+        exiting_ = true;
+      }
+      skips_children_ = false;
+      return;
+    }
+    const auto next_index = path_.back() + 1;
+    nodes_.pop_back();
+    path_.pop_back();
+    if (nodes_.empty()) {
+      if (next_index < adapter_.GetRootCount()) {
+        Push(adapter_.GetRoot(next_index), next_index);
+      }
+      return;
+    }
+    const auto parent = nodes_.back();
+    if (next_index < adapter_.GetChildCount(parent)) {
+      Push(adapter_.GetChild(parent, next_index), next_index);
+    }
+    // Otherwise the parent is exited next
+  }
+  // Advances until an event that the traversal order stops at
+  void Settle() {
+    while (IsValid() && !StopsAtCurrent()) {
+      Step();
+    }
+  }
+  bool StopsAtCurrent() const {
+    switch (order_) {
+    case TraversalOrder::kPreOrder:
+      return !exiting_;
+    case TraversalOrder::kPostOrder:
+      return exiting_;
+    case TraversalOrder::kLeavesOnly:
+      return !exiting_ && adapter_.IsLeaf(nodes_.back());
+    }
+    return false;
+  }
+  const Adapter adapter_;
+  const TraversalOrder order_;
+  std::vector<Node> nodes_;
+  std::vector<std::size_t> path_;
+  bool exiting_;
+  bool skips_children_;
+};
+
+using TreeCursor = BasicTreeCursor<TreeNodeAdapter>;
+using FlatTreeCursor = BasicTreeCursor<FlatDocumentAdapter>;
+
+}
+
+#endif /* TREE_CURSOR_HPP_ */
@@ -0,0 +1,216 @@
+#include "tree_writers.hpp"
+
+#include <cstdint>
+
+namespace sexpr_parser {
+
+namespace {
+
+void WriteJSONString(std::ostream& o, const std::string& value) {
+  static const char hex_digits[] = "0123456789abcdef";
+  o.put('"');
+  // Unescaped runs are written at once
+  auto run_begin = value.data();
+  const auto end = value.data() + value.size();
+  for (auto i = run_begin; i != end; ++i) {
+    const auto c = static_cast<unsigned char>(*i);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    o.write(run_begin, i - run_begin);
+    run_begin = i + 1;
+    switch (c) {
+    case '"':
+      o.write("\\\"", 2);
+      break;
+    case '\\':
+      o.write("\\\\", 2);
+      break;
+    case '\n':
+      o.write("\\n", 2);
+      break;
+    case '\t':
+      o.write("\\t", 2);
+      break;
+    case '\r':
+      o.write("\\r", 2);
+      break;
+    default:
+      const char escaped[] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xf]};
+      o.write(escaped, sizeof(escaped));
+      break;
+    }
+  }
+  o.write(run_begin, end - run_begin);
+  o.put('"');
+}
+
+// MessagePack integers are big-endian
+void WriteBigEndian(std::ostream& o, const std::uint8_t type, const std::uint32_t value, const int num_bytes) {
+  char bytes[5];
+  bytes[0] = static_cast<char>(type);
+  for (auto i = 0; i < num_bytes; ++i) {
+    bytes[1 + i] = static_cast<char>(value >> (8 * (num_bytes - 1 - i)));
+  }
+  o.write(bytes, 1 + num_bytes);
+}
+
+void WriteMessagePackString(std::ostream& o, const std::string& value) {
+  const auto size = static_cast<std::uint32_t>(value.size());
+  if (size < 32) {
+    o.put(static_cast<char>(0xa0 | size));
+  } else if (size <= UINT8_MAX) {
+    WriteBigEndian(o, 0xd9, size, 1);
+  } else if (size <= UINT16_MAX) {
+    WriteBigEndian(o, 0xda, size, 2);
+  } else {
+    WriteBigEndian(o, 0xdb, size, 4);
+  }
+  o.write(value.data(), value.size());
+}
+
+// Returns whether the one-line form of the node fits in budget characters.
+// Stops as soon as it does not, so the cost is bounded by the budget.
+bool FitsOnLine(const TreeNode& node, std::size_t& budget) {
+  if (node.IsLeaf()) {
+    if (node.GetValue().size() > budget) {
+      return false;
+    }
+    budget -= node.GetValue().size();
+    return true;
+  }
+  const auto& children = node.GetChildren();
+  // Parens and separators
+  const auto punctuation = children.empty() ? 2 : children.size() + 1;
+  if (punctuation > budget) {
+    return false;
+  }
+  budget -= punctuation;
+  for (const auto& child : children) {
+    if (!FitsOnLine(child, budget)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void WriteOneLine(std::ostream& o, const TreeNode& node) {
+  if (node.IsLeaf()) {
+    o << node.GetValue();
+    return;
+  }
+  o.put('(');
+  const auto& children = node.GetChildren();
+  for (auto i = children.begin(); i != children.end(); ++i) {
+    if (i != children.begin()) {
+      o.put(' ');
+    }
+    WriteOneLine(o, *i);
+  }
+  o.put(')');
+}
+
+void WriteNewLine(std::ostream& o, const std::size_t column) {
+  o.put('\n');
+  for (std::size_t i = 0; i < column; ++i) {
+    o.put(' ');
+  }
+}
+
+// Writes the node starting at the given column
+void WritePretty(std::ostream& o, const TreeNode& node, const std::size_t column, const PrettyPrintOptions& options) {
+  if (node.IsLeaf()) {
+    o << node.GetValue();
+    return;
+  }
+  const auto& children = node.GetChildren();
+  if (children.empty()) {
+    o.write("()", 2);
+    return;
+  }
+  const auto is_rule = children.size() >= 3 && children.front().IsLeaf() && children.front().GetValue() == "<=";
+  if (!(is_rule && options.breaks_rules)) {
+    auto budget = options.width > column ? options.width - column : 0;
+    if (FitsOnLine(node, budget)) {
+      WriteOneLine(o, node);
+      return;
+    }
+  }
+  const auto child_column = column + options.indent;
+  o.put('(');
+  WritePretty(o, children.front(), column + 1, options);
+  auto i = children.begin() + 1;
+  if (is_rule) {
+    // Head stays on the line of "<="
+    o.put(' ');
+    WritePretty(o, *i, column + 4, options);
+    ++i;
+  }
+  for (; i != children.end(); ++i) {
+    WriteNewLine(o, child_column);
+    WritePretty(o, *i, child_column, options);
+  }
+  o.put(')');
+}
+
+void WriteMessagePackArrayHeader(std::ostream& o, const std::size_t size) {
+  if (size < 16) {
+    o.put(static_cast<char>(0x90 | size));
+  } else if (size <= UINT16_MAX) {
+    WriteBigEndian(o, 0xdc, size, 2);
+  } else {
+    WriteBigEndian(o, 0xdd, size, 4);
+  }
+}
+
+}
+
+void WriteJSON(std::ostream& o, const TreeNode& node) {
+  if (node.IsLeaf()) {
+    WriteJSONString(o, node.GetValue());
+  } else {
+    WriteJSON(o, node.GetChildren());
+  }
+}
+
+void WriteJSON(std::ostream& o, const std::vector<TreeNode>& nodes) {
+  o.put('[');
+  for (auto i = nodes.begin(); i != nodes.end(); ++i) {
+    if (i != nodes.begin()) {
+      o.put(',');
+    }
+    WriteJSON(o, *i);
+  }
+  o.put(']');
+}
+
+void WriteMessagePack(std::ostream& o, const TreeNode& node) {
+  if (node.IsLeaf()) {
+    WriteMessagePackString(o, node.GetValue());
+  } else {
+    WriteMessagePack(o, node.GetChildren());
+  }
+}
+
+void WriteMessagePack(std::ostream& o, const std::vector<TreeNode>& nodes) {
+  WriteMessagePackArrayHeader(o, nodes.size());
+  for (const auto& node : nodes) {
+    WriteMessagePack(o, node);
+  }
+}
+
+PrettyPrintOptions::PrettyPrintOptions() : width(80), indent(2), breaks_rules(true) {
+}
+
+void WritePrettySexpr(std::ostream& o, const TreeNode& node, const PrettyPrintOptions& options) {
+  WritePretty(o, node, 0, options);
+}
+
+void WritePrettySexpr(std::ostream& o, const std::vector<TreeNode>& nodes, const PrettyPrintOptions& options) {
+  for (const auto& node : nodes) {
+    WritePretty(o, node, 0, options);
+    o.put('\n');
+  }
+}
+
+}
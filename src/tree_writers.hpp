@@ -0,0 +1,36 @@
+#ifndef TREE_WRITERS_HPP_
+#define TREE_WRITERS_HPP_
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+// Leaves are written as strings and non-leaves as arrays.
+// A vector of nodes is written as one array.
+void WriteJSON(std::ostream& o, const TreeNode& node);
+void WriteJSON(std::ostream& o, const std::vector<TreeNode>& nodes);
+void WriteMessagePack(std::ostream& o, const TreeNode& node);
+void WriteMessagePack(std::ostream& o, const std::vector<TreeNode>& nodes);
+
+struct PrettyPrintOptions {
+  PrettyPrintOptions();
+  // Lists that fit in the rest of the line are written on one line
+  std::size_t width;
+  std::size_t indent;
+  // Writes each body literal of "<=" rules on its own line
+  bool breaks_rules;
+};
+
+// Lists that do not fit are written with their first element on the opening
+// line and each other element on its own indented line.
+// A vector of nodes is written one node per line.
+void WritePrettySexpr(std::ostream& o, const TreeNode& node, const PrettyPrintOptions& options = PrettyPrintOptions());
+void WritePrettySexpr(std::ostream& o, const std::vector<TreeNode>& nodes, const PrettyPrintOptions& options = PrettyPrintOptions());
+
+}
+
+#endif /* TREE_WRITERS_HPP_ */
@@ -0,0 +1,17 @@
+#ifndef ALLOCATION_COUNTER_HPP_
+#define ALLOCATION_COUNTER_HPP_
+
+#include <cstddef>
+
+// Counts heap allocations made by any thread while an instance is alive.
+// The test binary interposes malloc, calloc and realloc on glibc, which
+// also covers operator new, and replaces operator new elsewhere.
+class AllocationCounter {
+public:
+  AllocationCounter();
+  std::size_t GetCount() const;
+private:
+  const std::size_t start_;
+};
+
+#endif /* ALLOCATION_COUNTER_HPP_ */
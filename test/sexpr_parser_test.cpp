@@ -1,7 +1,37 @@
 #include "gtest/gtest.h"
+#include "allocation_counter.hpp"
 #include "sexpr_parser.hpp"
+#include "sexpr_parser_c.h"
+#include "arena.hpp"
+#include "arrow_writer.hpp"
+#include "clause_profiler.hpp"
+#include "corpus_loader.hpp"
+#include "flat_document.hpp"
+#include "game_statistics.hpp"
+#include "gdl_generator.hpp"
+#include "incremental_parser.hpp"
+#include "message_parser.hpp"
+#include "parallel_parser.hpp"
+#include "parse_limits.hpp"
+#include "prolog_pipe.hpp"
+#include "prolog_state_delta.hpp"
+#include "reachability.hpp"
+#include "rule_base.hpp"
+#include "state_machine.hpp"
+#include "succinct_tree.hpp"
+#include "symbol_table.hpp"
+#include "tree_cursor.hpp"
+#include "tree_writers.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
 
 namespace sp = sexpr_parser;
 
@@ -152,3 +182,1112 @@ TEST(ReplaceAtoms, Test) {
   ASSERT_TRUE(nodes_replaced[3].ToPrologClause(false, "", "") == "rule1 :- fact3.");
   ASSERT_TRUE(nodes_replaced[4].ToPrologClause(false, "", "") == "rule2(_x) :- fact3, fact2(_x).");
 }
+
+TEST(PrologStateDeltaEmitter, Test) {
+  sp::PrologStateDeltaEmitter emitter(false);
+  const auto previous = sp::Parse("(true (cell 1 b)) (true (control x)) (does x (mark 1))");
+  const auto current = sp::Parse("(true (cell 1 x)) (true (control x)) (does x noop)");
+  const std::string answer =
+      "retract(true(cell(1, b))).\n"
+      "retract(does(x, mark(1))).\n"
+      "assertz(true(cell(1, x))).\n"
+      "assertz(does(x, noop)).\n";
+  ASSERT_TRUE(emitter.EmitDelta(previous, current) == answer);
+  ASSERT_TRUE(emitter.EmitDelta(current, current).empty());
+  ASSERT_TRUE(emitter.GetTermText(current[1]) == "true(control(x))");
+}
+
+TEST(PrologPipe, Consult) {
+  const auto nodes = sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
+  char path[] = "/tmp/sexpr_parser_testXXXXXX";
+  const auto fd = mkstemp(path);
+  ASSERT_TRUE(fd >= 0);
+  close(fd);
+  sp::PrologPipe pipe("cat > " + std::string(path));
+  ASSERT_TRUE(pipe.IsOpen());
+  ASSERT_TRUE(pipe.Consult(nodes, false));
+  ASSERT_TRUE(pipe.Close() == 0);
+  std::ifstream written(path);
+  std::stringstream buffer;
+  buffer << written.rdbuf();
+  std::remove(path);
+  ASSERT_TRUE(buffer.str() == sp::ToProlog(nodes, false));
+}
+
+TEST(FlatDocument, Test) {
+  const auto nodes = sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) ()");
+  const sp::FlatDocument document(nodes);
+  ASSERT_TRUE(document.GetRootCount() == 5);
+  ASSERT_TRUE(document.GetNodeCount() == 12);
+  ASSERT_TRUE(document.GetSymbolCount() == 7); // role, player, fact1, fact2, 1, <=, rule1
+  const auto rule = document.GetRoot(3);
+  ASSERT_TRUE(!document.IsLeaf(rule));
+  ASSERT_TRUE(document.GetChildCount(rule) == 3);
+  const auto fact1 = document.GetNode(document.GetChild(rule, 2)).symbol;
+  ASSERT_TRUE(fact1 == document.GetNode(document.GetRoot(1)).symbol);
+  ASSERT_TRUE(std::string(document.GetSymbol(fact1)) == "fact1");
+  ASSERT_TRUE(document.GetSymbolLength(fact1) == 5);
+  const auto tree_nodes = document.ToTreeNodes();
+  ASSERT_TRUE(std::equal(nodes.begin(), nodes.end(), tree_nodes.begin()));
+}
+
+TEST(FlatDocument, Arena) {
+  const auto nodes = sp::ParseKIF(sp::GenerateGame());
+  sp::ArenaOptions options;
+  options.uses_huge_pages = true;
+  options.numa_node = sp::kLocalNumaNode;
+  const sp::FlatDocument document(nodes, options);
+  ASSERT_TRUE(document.GetArena() != nullptr);
+  // Falls back to transparent huge pages without a hugetlbfs pool
+  ASSERT_TRUE(document.GetArena()->GetMappedBytes() == 2 << 20);
+  ASSERT_TRUE(document.GetArena()->GetNumaNode() == sp::GetCurrentNumaNode());
+  ASSERT_TRUE(document.ToTreeNodes() == nodes);
+  ASSERT_TRUE(sp::FlatDocument(nodes).GetArena() == nullptr);
+}
+
+TEST(SymbolTable, Intern) {
+  sp::SymbolTable table;
+  ASSERT_TRUE(table.Find("cell") == sp::kNoSymbol);
+  const auto cell = table.Intern("cell");
+  const auto cell_text = table.GetSymbol(cell);
+  ASSERT_TRUE(table.Intern(std::string("b")) == cell + 1);
+  ASSERT_TRUE(table.Intern("cell", 4) == cell);
+  ASSERT_TRUE(table.Find("cell") == cell);
+  for (auto i = 0; i < 100000; ++i) {
+    table.Intern(std::to_string(i));
+  }
+  ASSERT_TRUE(table.GetSymbolCount() == 100002);
+  // Never moved
+  ASSERT_TRUE(table.GetSymbol(cell) == cell_text);
+  ASSERT_TRUE(std::string(table.GetSymbol(table.Find("99999"))) == "99999");
+  ASSERT_TRUE(table.GetSymbolLength(table.Find("99999")) == 5);
+  ASSERT_TRUE(table.Intern("") == 100002);
+}
+
+TEST(SymbolTable, Concurrent) {
+  sp::SymbolTable table;
+  std::vector<std::vector<sp::SymbolId>> ids(4);
+  std::vector<std::thread> threads;
+  for (auto i = 0; i < 4; ++i) {
+    threads.emplace_back([&table, &ids, i]() {
+      // Each thread interns the same symbols in a different order
+      const int steps[] = {1, 3, 7, 9};
+      for (auto j = 0; j < 20000; ++j) {
+        const auto symbol = (j * steps[i]) % 20000;
+        ids[i].push_back(table.Intern("s" + std::to_string(symbol)));
+      }
+      std::vector<sp::SymbolId> sorted(20000);
+      for (auto j = 0; j < 20000; ++j) {
+        sorted[(j * steps[i]) % 20000] = ids[i][j];
+      }
+      ids[i].swap(sorted);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_TRUE(table.GetSymbolCount() == 20000);
+  for (auto i = 1; i < 4; ++i) {
+    ASSERT_TRUE(ids[i] == ids[0]);
+  }
+  for (auto j = 0; j < 20000; ++j) {
+    ASSERT_TRUE(table.GetSymbol(ids[0][j]) == "s" + std::to_string(j));
+  }
+}
+
+TEST(FlatDocument, SharedSymbolTable) {
+  sp::SymbolTable table;
+  const auto nodes1 = sp::Parse("(cell 1 1 b) (control white)");
+  const auto nodes2 = sp::Parse("(control black) (cell 1 1 x)");
+  const sp::FlatDocument document1(nodes1, table);
+  const sp::FlatDocument document2(nodes2, table, sp::ArenaOptions());
+  ASSERT_TRUE(document1.GetSymbolTable() == &table);
+  const auto control1 = document1.GetNode(document1.GetChild(document1.GetRoot(1), 0)).symbol;
+  const auto control2 = document2.GetNode(document2.GetChild(document2.GetRoot(0), 0)).symbol;
+  ASSERT_TRUE(control1 == control2);
+  ASSERT_TRUE(document2.GetSymbolCount() == 7);
+  ASSERT_TRUE(std::string(document2.GetSymbol(control2)) == "control");
+  ASSERT_TRUE(document1.ToTreeNodes() == nodes1);
+  ASSERT_TRUE(document2.ToTreeNodes() == nodes2);
+}
+
+TEST(FlatDocument, DeepNesting) {
+  // Deeper than recursion over the nesting would survive
+  const auto sexpr = sp::GenerateDeeplyNestedTerm(200000);
+  const auto nodes = sp::Parse(sexpr);
+  const sp::FlatDocument document(nodes);
+  ASSERT_TRUE(document.GetNodeCount() == 400001);
+  auto node = document.GetRoot(0);
+  for (auto i = 0; i < 200000; ++i) {
+    ASSERT_TRUE(document.GetChildCount(node) == 2);
+    node = document.GetChild(node, 1);
+  }
+  ASSERT_TRUE(std::string(document.GetSymbol(document.GetNode(node).symbol)) == "a");
+  // Compared through a document of the result, since comparing trees
+  // recurses
+  const sp::FlatDocument rebuilt(document.ToTreeNodes());
+  ASSERT_TRUE(rebuilt.GetNodeCount() == document.GetNodeCount());
+  for (sp::NodeIndex i = 0; i < document.GetNodeCount(); ++i) {
+    ASSERT_TRUE(rebuilt.GetNode(i).symbol == document.GetNode(i).symbol);
+    ASSERT_TRUE(rebuilt.GetNode(i).child_count == document.GetNode(i).child_count);
+  }
+  ASSERT_TRUE(rebuilt.GetChildIndices() == document.GetChildIndices());
+  auto c_document = sp_parse(sexpr.data(), sexpr.size());
+  ASSERT_TRUE(c_document != nullptr);
+  ASSERT_TRUE(sp_document_node_count(c_document) == 400001);
+  sp_document_free(c_document);
+}
+
+TEST(SuccinctTree, Test) {
+  const auto nodes = sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) ()");
+  const sp::SuccinctTree tree(nodes);
+  ASSERT_TRUE(tree.GetRootCount() == 5);
+  ASSERT_TRUE(tree.GetNodeCount() == 12);
+  ASSERT_TRUE(tree.GetSymbolCount() == 7);
+  const auto rule = tree.GetNode(7);
+  ASSERT_TRUE(tree.GetPreorder(rule) == 7);
+  ASSERT_TRUE(!tree.IsLeaf(rule));
+  ASSERT_TRUE(tree.GetChildCount(rule) == 3);
+  ASSERT_TRUE(tree.GetSubtreeSize(rule) == 4);
+  const auto fact1 = tree.GetChild(rule, 2);
+  ASSERT_TRUE(tree.GetParent(fact1) == rule);
+  ASSERT_TRUE(tree.GetDepth(fact1) == 1);
+  ASSERT_TRUE(tree.GetSymbolId(fact1) == tree.GetSymbolId(tree.GetNode(3)));
+  ASSERT_TRUE(std::string(tree.GetSymbol(tree.GetSymbolId(fact1))) == "fact1");
+  ASSERT_TRUE(tree.GetSymbolLength(tree.GetSymbolId(fact1)) == 5);
+  ASSERT_TRUE(tree.GetParent(rule) == sp::kNoSuccinctNode);
+  // The empty list is not a leaf
+  const auto empty = tree.GetNode(11);
+  ASSERT_TRUE(!tree.IsLeaf(empty));
+  ASSERT_TRUE(tree.GetFirstChild(empty) == sp::kNoSuccinctNode);
+  ASSERT_TRUE(tree.GetNextSibling(empty) == sp::kNoSuccinctNode);
+  ASSERT_TRUE(tree.ToTreeNodes() == nodes);
+  ASSERT_TRUE(sp::SuccinctTree().ToTreeNodes().empty());
+}
+
+TEST(SuccinctTree, Navigation) {
+  // Spans many blocks, and nesting deeper than a block
+  auto nodes = sp::ParseKIF(sp::GenerateGame());
+  for (const auto& node : sp::Parse(sp::GenerateDeeplyNestedTerm(2000))) {
+    nodes.push_back(node);
+  }
+  const sp::SuccinctTree tree(nodes);
+  ASSERT_TRUE(tree.ToTreeNodes() == nodes);
+  std::unordered_map<const sp::TreeNode*, std::size_t> preorders;
+  std::size_t preorder = 0;
+  for (sp::TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next()) {
+    preorders.emplace(cursor.GetNode(), preorder++);
+  }
+  ASSERT_TRUE(tree.GetNodeCount() == preorder);
+  preorder = 0;
+  for (sp::TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next(), ++preorder) {
+    const auto& expected = *cursor.GetNode();
+    const auto node = tree.GetNode(preorder);
+    ASSERT_TRUE(tree.GetPreorder(node) == preorder);
+    ASSERT_TRUE(tree.GetDepth(node) == cursor.GetDepth());
+    ASSERT_TRUE(tree.IsLeaf(node) == expected.IsLeaf());
+    if (cursor.GetDepth() == 0) {
+      ASSERT_TRUE(tree.GetParent(node) == sp::kNoSuccinctNode);
+    } else {
+      ASSERT_TRUE(tree.GetPreorder(tree.GetParent(node)) == preorders.at(cursor.GetParent()));
+    }
+    if (expected.IsLeaf()) {
+      ASSERT_TRUE(tree.GetSubtreeSize(node) == 1);
+      ASSERT_TRUE(tree.GetSymbol(tree.GetSymbolId(node)) == expected.GetValue());
+      continue;
+    }
+    const auto& children = expected.GetChildren();
+    ASSERT_TRUE(tree.GetChildCount(node) == children.size());
+    std::size_t subtree_size = 1;
+    for (std::size_t i = 0; i < children.size(); ++i) {
+      const auto child = tree.GetChild(node, i);
+      ASSERT_TRUE(tree.GetPreorder(child) == preorders.at(&children[i]));
+      subtree_size += tree.GetSubtreeSize(child);
+    }
+    ASSERT_TRUE(tree.GetSubtreeSize(node) == subtree_size);
+  }
+  // A few bits per node besides the symbols
+  ASSERT_TRUE(tree.GetMemoryUsage() * 8 < tree.GetNodeCount() * 16);
+}
+
+TEST(SuccinctTree, ReadWrite) {
+  const auto nodes = sp::ParseKIF(sp::GenerateGame());
+  std::stringstream stream;
+  sp::SuccinctTree(nodes).Write(stream);
+  const auto data = stream.str();
+  sp::SuccinctTree tree;
+  std::istringstream input(data);
+  ASSERT_TRUE(tree.Read(input));
+  ASSERT_TRUE(tree.ToTreeNodes() == nodes);
+  std::istringstream truncated(data.substr(0, data.size() - 1));
+  ASSERT_TRUE(!tree.Read(truncated));
+  std::istringstream garbage("(role white)");
+  ASSERT_TRUE(!tree.Read(garbage));
+  // Unbalanced parentheses
+  auto unbalanced = data;
+  unbalanced[24] = static_cast<char>(unbalanced[24] ^ 2);
+  std::istringstream unbalanced_input(unbalanced);
+  ASSERT_TRUE(!tree.Read(unbalanced_input));
+  ASSERT_TRUE(tree.GetNodeCount() == 0);
+}
+
+TEST(SuccinctTree, DeepNesting) {
+  const auto nodes = sp::Parse(sp::GenerateDeeplyNestedTerm(200000));
+  std::stringstream stream;
+  sp::SuccinctTree(nodes).Write(stream);
+  sp::SuccinctTree tree;
+  ASSERT_TRUE(tree.Read(stream));
+  ASSERT_TRUE(tree.GetNodeCount() == 400001);
+  auto node = tree.GetFirstRoot();
+  for (auto i = 0; i < 200000; ++i) {
+    node = tree.GetChild(node, 1);
+  }
+  ASSERT_TRUE(tree.GetDepth(node) == 200000);
+  // Compared through flat documents, since comparing trees recurses
+  const sp::FlatDocument expected(nodes);
+  const sp::FlatDocument actual(tree.ToTreeNodes());
+  ASSERT_TRUE(actual.GetNodeCount() == expected.GetNodeCount());
+  for (sp::NodeIndex i = 0; i < expected.GetNodeCount(); ++i) {
+    ASSERT_TRUE(actual.GetNode(i).symbol == expected.GetNode(i).symbol);
+  }
+  ASSERT_TRUE(actual.GetChildIndices() == expected.GetChildIndices());
+}
+
+TEST(Arena, Allocate) {
+  sp::ArenaOptions options;
+  options.block_size = 4096;
+  sp::Arena arena(options);
+  const auto c = static_cast<char*>(arena.Allocate(3, 1));
+  const auto d = static_cast<char*>(arena.Allocate(8, 8));
+  ASSERT_TRUE(reinterpret_cast<std::uintptr_t>(d) % 8 == 0);
+  ASSERT_TRUE(d >= c + 3 && d < c + 16);
+  ASSERT_TRUE(arena.GetMappedBytes() == 4096);
+  // Larger than a block
+  arena.Allocate(10000, 64);
+  ASSERT_TRUE(arena.GetMappedBytes() >= 4096 + 10000);
+  std::vector<int, sp::ArenaAllocator<int>> values(&arena);
+  values.assign(100, 1);
+  ASSERT_TRUE(values.get_allocator().GetArena() == &arena);
+  const auto copy = values;
+  ASSERT_TRUE(copy.get_allocator().GetArena() == nullptr);
+}
+
+TEST(CAPI, Test) {
+  const auto kif = std::string("(role player) ((fact2 1))");
+  auto document = sp_parse_kif(kif.data(), kif.size());
+  ASSERT_TRUE(document != nullptr);
+  ASSERT_TRUE(sp_document_root_count(document) == 2);
+  const auto fact2 = sp_document_root(document, 1);
+  ASSERT_TRUE(sp_node_get_kind(document, fact2) == SP_NODE_LIST);
+  ASSERT_TRUE(sp_node_get_value(document, fact2).length == 0);
+  ASSERT_TRUE(sp_node_child_count(document, fact2) == 2);
+  const auto one = sp_node_child(document, fact2, 1);
+  ASSERT_TRUE(sp_node_get_kind(document, one) == SP_NODE_LEAF);
+  const auto value = sp_node_get_value(document, one);
+  ASSERT_TRUE(std::string(value.data, value.length) == "1");
+  ASSERT_TRUE(value.data[value.length] == '\0');
+  const auto symbol = sp_document_symbol(document, sp_node_get_symbol(document, one));
+  ASSERT_TRUE(symbol.data == value.data);
+  // Out of range, also with NDEBUG
+  const auto node_count = static_cast<sp_node>(sp_document_node_count(document));
+  ASSERT_TRUE(sp_document_root(document, 2) == SP_NO_NODE);
+  ASSERT_TRUE(sp_node_get_kind(document, node_count) == SP_NODE_INVALID);
+  ASSERT_TRUE(sp_node_get_value(document, node_count).data == nullptr);
+  ASSERT_TRUE(sp_node_get_symbol(document, SP_NO_NODE) == UINT32_MAX);
+  ASSERT_TRUE(sp_node_child_count(document, node_count) == 0);
+  ASSERT_TRUE(sp_node_child(document, fact2, 2) == SP_NO_NODE);
+  ASSERT_TRUE(sp_node_child(document, one, 0) == SP_NO_NODE);
+  ASSERT_TRUE(sp_document_symbol(document, static_cast<uint32_t>(sp_document_symbol_count(document))).data == nullptr);
+  ASSERT_TRUE(sp_document_root_count(nullptr) == 0);
+  ASSERT_TRUE(sp_node_get_kind(nullptr, 0) == SP_NODE_INVALID);
+  ASSERT_TRUE(sp_parse(nullptr, 1) == nullptr);
+  sp_document_free(document);
+}
+
+TEST(WriteJSON, Test) {
+  const auto nodes = sp::Parse("(role player) fact1 (a () \"b\\c)");
+  std::ostringstream o;
+  sp::WriteJSON(o, nodes);
+  ASSERT_TRUE(o.str() == "[[\"role\",\"player\"],\"fact1\",[\"a\",[],\"\\\"b\\\\c\"]]");
+}
+
+TEST(WriteMessagePack, Test) {
+  const auto nodes = sp::Parse("(role player) (a ())");
+  std::ostringstream o;
+  sp::WriteMessagePack(o, nodes);
+  const std::string answer(
+      "\x92"
+      "\x92" "\xa4" "role" "\xa6" "player"
+      "\x92" "\xa1" "a" "\x90");
+  ASSERT_TRUE(o.str() == answer);
+  const auto long_value = std::string(40, 'x');
+  std::ostringstream long_o;
+  sp::WriteMessagePack(long_o, sp::TreeNode(long_value));
+  ASSERT_TRUE(long_o.str() == "\xd9\x28" + long_value);
+}
+
+TEST(ArrowWriter, Test) {
+  std::ostringstream o;
+  sp::ArrowWriter writer(o, 8);
+  writer.WriteRecord(7, sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) ()"));
+  writer.WriteRecord(8, sp::Parse("(role player)"));
+  ASSERT_TRUE(writer.Close());
+  ASSERT_TRUE(writer.GetRowCount() == 15);
+  ASSERT_TRUE(writer.GetBatchCount() == 2);
+  ASSERT_TRUE(writer.GetSymbolCount() == 7);
+  const auto data = o.str();
+  ASSERT_TRUE(data.compare(0, 8, std::string("ARROW1\0\0", 8)) == 0);
+  ASSERT_TRUE(data.compare(8, 4, "\xff\xff\xff\xff") == 0);
+  ASSERT_TRUE(data.compare(data.size() - 6, 6, "ARROW1") == 0);
+  // The footer follows the end-of-stream marker
+  std::int32_t footer_size = 0;
+  std::memcpy(&footer_size, &data[data.size() - 10], 4);
+  const auto end_of_stream = data.size() - 10 - footer_size - 8;
+  ASSERT_TRUE(data.compare(end_of_stream, 8, std::string("\xff\xff\xff\xff\0\0\0\0", 8)) == 0);
+  // Node ids of the first batch
+  const std::int32_t node_ids[] = {0, 1, 2, 3, 4, 5, 6, 7};
+  ASSERT_TRUE(data.find(std::string(reinterpret_cast<const char*>(node_ids), sizeof(node_ids))) != std::string::npos);
+}
+
+TEST(TreeNode, BoundedToSexpr) {
+  const auto node = sp::Parse("(a (b (c) d) e)").front();
+  ASSERT_TRUE(node.ToSexpr(100) == "(a (b (c) d) e)");
+  ASSERT_TRUE(node.ToSexpr(15) == "(a (b (c) d) e)");
+  ASSERT_TRUE(node.ToSexpr(14) == "(a (b (c) d) e...");
+  ASSERT_TRUE(node.ToSexpr(6) == "(a (b ...");
+  ASSERT_TRUE(node.ToSexpr(0) == "...");
+  ASSERT_TRUE(node.ToString() == "non-leaf[3]( leaf:a non-leaf[3]( leaf:b non-leaf[1]( leaf:c ) leaf:d ) leaf:e )");
+  ASSERT_TRUE(node.ToString(20) == "non-leaf[3]( leaf:a ...");
+}
+
+TEST(TreeCursor, Orders) {
+  const auto nodes = sp::Parse("(a (b c)) d");
+  std::vector<std::string> pre_order;
+  std::vector<std::size_t> depths;
+  for (sp::TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next()) {
+    pre_order.push_back(cursor.GetNode()->ToSexpr());
+    depths.push_back(cursor.GetDepth());
+  }
+  ASSERT_TRUE(pre_order == std::vector<std::string>({"(a (b c))", "a", "(b c)", "b", "c", "d"}));
+  ASSERT_TRUE(depths == std::vector<std::size_t>({0, 1, 1, 2, 2, 0}));
+  std::vector<std::string> post_order;
+  for (sp::TreeCursor cursor(nodes, sp::TraversalOrder::kPostOrder); cursor.IsValid(); cursor.Next()) {
+    post_order.push_back(cursor.GetNode()->ToSexpr());
+  }
+  ASSERT_TRUE(post_order == std::vector<std::string>({"a", "b", "c", "(b c)", "(a (b c))", "d"}));
+  const sp::FlatDocument document(nodes);
+  std::vector<std::string> leaves;
+  for (sp::FlatTreeCursor cursor(document, sp::TraversalOrder::kLeavesOnly); cursor.IsValid(); cursor.Next()) {
+    leaves.push_back(document.GetSymbol(document.GetNode(cursor.GetNode()).symbol));
+  }
+  ASSERT_TRUE(leaves == std::vector<std::string>({"a", "b", "c", "d"}));
+}
+
+TEST(TreeCursor, SkipSubtreeAndPath) {
+  const auto nodes = sp::Parse("(a (b c) (d (e)))");
+  std::vector<std::string> visited;
+  for (sp::TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next()) {
+    visited.push_back(cursor.GetNode()->ToSexpr());
+    if (cursor.GetNode()->ToSexpr() == "(b c)") {
+      cursor.SkipSubtree();
+    }
+    if (cursor.GetNode()->ToSexpr() == "e") {
+      ASSERT_TRUE(cursor.GetPath() == std::vector<std::size_t>({0, 2, 1, 0}));
+      ASSERT_TRUE(cursor.GetParent()->ToSexpr() == "(e)");
+    }
+  }
+  ASSERT_TRUE(visited == std::vector<std::string>({"(a (b c) (d (e)))", "a", "(b c)", "(d (e))", "d", "(e)", "e"}));
+  ASSERT_TRUE(!sp::TreeCursor(std::vector<sp::TreeNode>()).IsValid());
+}
+
+TEST(CollectVariableArgs, Test) {
+  const auto node = sp::Parse("(<= (rule2 ?x ?y) (fact2 ?x (f ?y)) (not (fact3 ?x)))").front();
+  const auto args = node.GetChildren()[2].CollectVariableArgs();
+  ASSERT_TRUE(args.size() == 2);
+  ASSERT_TRUE(args.at("?x") == std::unordered_set<sp::ArgPos>({sp::ArgPos("fact2", 1)}));
+  ASSERT_TRUE(args.at("?y") == std::unordered_set<sp::ArgPos>({sp::ArgPos("f", 1)}));
+  const auto nested = node.GetChildren()[3].CollectVariableArgs();
+  ASSERT_TRUE(nested.at("?x") == std::unordered_set<sp::ArgPos>({sp::ArgPos("fact3", 1)}));
+}
+
+TEST(WritePrettySexpr, Test) {
+  const auto nodes = sp::Parse("(role player) (<= (next (cell ?x ?y o)) (does oplayer (mark ?x ?y)) (true (cell ?x ?y b))) ()");
+  sp::PrettyPrintOptions options;
+  options.width = 30;
+  std::ostringstream o;
+  sp::WritePrettySexpr(o, nodes, options);
+  const std::string answer =
+      "(role player)\n"
+      "(<= (next (cell ?x ?y o))\n"
+      "  (does oplayer (mark ?x ?y))\n"
+      "  (true (cell ?x ?y b)))\n"
+      "()\n";
+  ASSERT_TRUE(o.str() == answer);
+  options.width = 20;
+  options.indent = 4;
+  options.breaks_rules = false;
+  std::ostringstream narrow;
+  sp::WritePrettySexpr(narrow, nodes[1], options);
+  const std::string narrow_answer =
+      "(<= (next\n"
+      "        (cell\n"
+      "            ?x\n"
+      "            ?y\n"
+      "            o))\n"
+      "    (does\n"
+      "        oplayer\n"
+      "        (mark ?x ?y))\n"
+      "    (true\n"
+      "        (cell\n"
+      "            ?x\n"
+      "            ?y\n"
+      "            b)))";
+  ASSERT_TRUE(narrow.str() == narrow_answer);
+}
+
+TEST(ParseParallel, SameAsParse) {
+  const std::vector<std::string> inputs = {
+    "",
+    "a",
+    "(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))",
+    "(init (cell 1 1 b) (cell 1 2 b) (cell 1 3 b) (cell 2 1 b) (cell 2 2 b) (cell 2 3 b) ((((x)))))",
+    "; comment (a b\n(a ; comment ) (\n(b c) d)\r\n\t(e (f (g () h) i) j) ;; end",
+    "(a;b\n c) )"
+  };
+  for (const auto& input : inputs) {
+    for (const auto flatten : {false, true}) {
+      const auto answer = sp::Parse(input, flatten);
+      for (std::size_t num_threads = 1; num_threads <= 8; ++num_threads) {
+        const auto nodes = sp::ParseParallel(input, num_threads, flatten);
+        ASSERT_TRUE(nodes.size() == answer.size());
+        ASSERT_TRUE(std::equal(nodes.begin(), nodes.end(), answer.begin()));
+      }
+    }
+  }
+}
+
+TEST(IncrementalParser, Edit) {
+  sp::IncrementalParser parser("(role player) fact1 (fact2 1)\n(<= rule1 fact1)");
+  ASSERT_TRUE(parser.GetForms().size() == 4);
+  // Changing one form replaces only that form
+  const auto change = parser.Edit(21, 5, "fact3");
+  ASSERT_TRUE(change.first_form == 2);
+  ASSERT_TRUE(change.removed_count == 1);
+  ASSERT_TRUE(change.inserted_count == 1);
+  ASSERT_TRUE(parser.GetForms()[2].ToSexpr() == "(fact3 1)");
+  ASSERT_TRUE(parser.GetSpans()[3].begin == 30);
+  // A comment hides the rest of the line
+  const auto comment_change = parser.Edit(14, 0, ";");
+  ASSERT_TRUE(comment_change.first_form == 1);
+  ASSERT_TRUE(comment_change.removed_count == 2);
+  ASSERT_TRUE(comment_change.inserted_count == 0);
+  ASSERT_TRUE(parser.GetForms().size() == 2);
+}
+
+TEST(IncrementalParser, SameAsParse) {
+  const std::string pieces[] = {"(", ")", " ", "\n", ";", "a", "role", "?x", "(b c)", "(<= (r ?x) (f ?x))"};
+  for (const auto flatten : {false, true}) {
+    std::string text = "(role player) fact1 (fact2 1) (<= rule1 fact1) ; c\n(<= (rule2 ?x) fact1 (fact2 ?x))";
+    sp::IncrementalParser parser(text, flatten);
+    unsigned int random = 12345;
+    for (auto step = 0; step < 2000; ++step) {
+      random = random * 1103515245 + 12345;
+      const auto offset = (random >> 8) % (text.size() + 1);
+      const auto removed = std::min<std::size_t>((random >> 20) % 4, text.size() - offset);
+      const auto& inserted = pieces[(random >> 24) % 10];
+      const auto old_forms = parser.GetForms();
+      const auto change = parser.Edit(offset, removed, inserted);
+      text.replace(offset, removed, inserted);
+      ASSERT_TRUE(parser.GetText() == text);
+      // Unclosed parens are closed implicitly, so compare against the whole
+      // text with the missing parens added
+      const auto text_no_comments = sp::RemoveComments(text);
+      std::size_t depth = 0;
+      for (const auto c : text_no_comments) {
+        if (c == '(') {
+          ++depth;
+        } else if (c == ')' && depth > 0) {
+          --depth;
+        }
+      }
+      const auto answer = sp::Parse(text_no_comments + std::string(depth, ')'), flatten);
+      ASSERT_TRUE(parser.GetForms().size() == answer.size());
+      ASSERT_TRUE(std::equal(answer.begin(), answer.end(), parser.GetForms().begin()));
+      ASSERT_TRUE(std::equal(old_forms.begin(), old_forms.begin() + change.first_form, parser.GetForms().begin()));
+      ASSERT_TRUE(old_forms.size() - change.removed_count + change.inserted_count == answer.size());
+    }
+  }
+}
+
+TEST(RuleBase, AddAndRemove) {
+  const auto nodes = sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
+  sp::RuleBase rule_base;
+  std::vector<sp::ClauseId> ids;
+  for (const auto& node : nodes) {
+    ids.push_back(rule_base.Add(node));
+  }
+  ASSERT_TRUE(rule_base.CollectAtoms() == sp::CollectAtoms(nodes));
+  ASSERT_TRUE(rule_base.CollectNonFunctorAtoms() == sp::CollectNonFunctorAtoms(nodes));
+  ASSERT_TRUE(rule_base.CollectFunctorAtoms() == sp::CollectFunctorAtoms(nodes));
+  ASSERT_TRUE(rule_base.GetAtomCounts().at("fact1") == 3);
+  const auto helper_clauses = rule_base.GeneratePrologHelperClauses(false);
+  ASSERT_TRUE(helper_clauses.find("user_defined_functor(rule2, 1).") != std::string::npos);
+  ASSERT_TRUE(helper_clauses.find("equivalent_args(rule2, 1, fact2, 1).") != std::string::npos);
+  rule_base.Remove(ids[4]);
+  ASSERT_TRUE(rule_base.GetClauseCount() == 4);
+  ASSERT_TRUE(rule_base.GetAtomCounts().at("fact1") == 2);
+  ASSERT_TRUE(!rule_base.CollectAtoms().count("rule2"));
+  ASSERT_TRUE(!rule_base.CollectFunctorAtoms().count("rule2"));
+  ASSERT_TRUE(rule_base.GeneratePrologHelperClauses(false).find("equivalent_args") == std::string::npos);
+  const std::vector<sp::TreeNode> remaining(nodes.begin(), nodes.begin() + 4);
+  ASSERT_TRUE(rule_base.CollectAtoms() == sp::CollectAtoms(remaining));
+  ASSERT_TRUE(!rule_base.Remove(ids[4]));
+  ASSERT_TRUE(!rule_base.Remove(100));
+  ASSERT_TRUE(rule_base.GetClauseCount() == 4);
+}
+
+TEST(RuleBase, SeveralArities) {
+  const auto nodes = sp::Parse("(<= (f ?x ?y) (g ?x) (g ?x ?y)) (f 1) (h (g 1 2 3))");
+  sp::RuleBase rule_base;
+  for (const auto& node : nodes) {
+    rule_base.Add(node);
+  }
+  ASSERT_TRUE(rule_base.CollectFunctorAtoms() == sp::CollectFunctorAtoms(nodes));
+  ASSERT_TRUE(rule_base.CollectFunctorAtoms().at("f") == 1);
+  ASSERT_TRUE(rule_base.CollectFunctorAtoms().at("g") == 1);
+  // Helper clauses as in ToProlog()
+  std::ostringstream o;
+  for (const auto& node : nodes) {
+    o << node.ToPrologClause(false, "", "") << std::endl;
+  }
+  const auto prolog = sp::ToProlog(nodes, false, "", "", true);
+  ASSERT_TRUE(prolog.compare(0, o.str().size(), o.str()) == 0);
+  // In any order
+  const auto sorted_lines = [](const std::string& text) -> std::vector<std::string> {
+    std::istringstream stream(text);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(stream, line);) {
+      if (!line.empty()) {
+        lines.push_back(line);
+      }
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+  };
+  const auto helper_clauses = sorted_lines(prolog.substr(o.str().size()));
+  ASSERT_TRUE(helper_clauses == sorted_lines(rule_base.GeneratePrologHelperClauses(false)));
+  ASSERT_TRUE(std::count(helper_clauses.begin(), helper_clauses.end(), "user_defined_functor(f, 1).") == 1);
+}
+
+TEST(RuleBase, ApplyFormChange) {
+  sp::IncrementalParser parser("(role player) fact1 (fact2 1)");
+  sp::RuleBase rule_base;
+  std::vector<sp::ClauseId> ids;
+  rule_base.ApplyFormChange(parser.GetForms(), sp::FormChange{0, 0, parser.GetForms().size()}, ids);
+  ASSERT_TRUE(ids.size() == 3);
+  const auto change = parser.Edit(21, 5, "fact3");
+  rule_base.ApplyFormChange(parser.GetForms(), change, ids);
+  ASSERT_TRUE(rule_base.GetClauseCount() == 3);
+  ASSERT_TRUE(rule_base.GetClause(ids[2]).ToSexpr() == "(fact3 1)");
+  ASSERT_TRUE(rule_base.CollectAtoms() == sp::CollectAtoms(parser.GetForms()));
+}
+
+TEST(ParseLimits, SameAsParse) {
+  sp::GameGeneratorOptions options;
+  options.nesting_depth = 3;
+  const auto kif = sp::GenerateGame(options) + " (unclosed (list";
+  std::vector<sp::TreeNode> nodes;
+  sp::LimitError error;
+  ASSERT_TRUE(sp::ParseKIFWithLimits(kif, sp::ParseLimits(), nodes, error));
+  ASSERT_TRUE(error.kind == sp::LimitKind::kNone);
+  ASSERT_TRUE(nodes == sp::ParseKIF(kif));
+  ASSERT_TRUE(nodes.back().ToSexpr() == "(unclosed list)");
+}
+
+TEST(ParseLimits, Exceeded) {
+  std::vector<sp::TreeNode> nodes;
+  sp::LimitError error;
+  sp::ParseLimits limits;
+  limits.max_depth = 100;
+  ASSERT_TRUE(sp::ParseWithLimits(sp::GenerateDeeplyNestedTerm(100), limits, nodes, error));
+  // Forms before the limit is exceeded are not returned either
+  ASSERT_TRUE(!sp::ParseWithLimits("a " + sp::GenerateDeeplyNestedTerm(101), limits, nodes, error));
+  ASSERT_TRUE(nodes.empty());
+  ASSERT_TRUE(error.kind == sp::LimitKind::kDepth);
+  ASSERT_TRUE(error.limit == 100);
+  ASSERT_TRUE(error.position == 302);
+  ASSERT_TRUE(error.ToString() == "depth limit 100 exceeded at offset 302");
+  limits = sp::ParseLimits();
+  limits.max_tokens = 4;
+  ASSERT_TRUE(sp::ParseWithLimits("(a b) ; c d", limits, nodes, error));
+  ASSERT_TRUE(!sp::ParseWithLimits("(a b) c", limits, nodes, error));
+  ASSERT_TRUE(nodes.empty());
+  ASSERT_TRUE(error.kind == sp::LimitKind::kTokens && error.position == 6);
+  limits = sp::ParseLimits();
+  limits.max_symbol_length = 3;
+  ASSERT_TRUE(!sp::ParseWithLimits("x (abc abcd)", limits, nodes, error));
+  ASSERT_TRUE(nodes.empty());
+  ASSERT_TRUE(error.kind == sp::LimitKind::kSymbolLength && error.position == 7);
+  limits = sp::ParseLimits();
+  limits.max_nodes = 3;
+  ASSERT_TRUE(!sp::ParseWithLimits("(a (b))", limits, nodes, error));
+  ASSERT_TRUE(nodes.empty());
+  ASSERT_TRUE(error.kind == sp::LimitKind::kNodes && error.position == 4);
+  ASSERT_TRUE(!sp::ParseWithLimits("a (b (c))", limits, nodes, error));
+  ASSERT_TRUE(nodes.empty());
+  ASSERT_TRUE(error.kind == sp::LimitKind::kNodes && error.position == 5);
+}
+
+TEST(ParseLimits, HelperPairs) {
+  const auto nodes = sp::Parse("(p 1) " + sp::GenerateRepeatedVariableRule(100));
+  sp::ParseLimits limits;
+  // Pairs within the body, and between (h ?x) and the body
+  limits.max_helper_pairs = 100 * 99 / 2 + 100;
+  sp::LimitError error;
+  ASSERT_TRUE(sp::CheckHelperPairLimit(nodes, limits, error));
+  limits.max_helper_pairs -= 1;
+  std::ostringstream o;
+  ASSERT_TRUE(sp::WritePrologWithLimits(o, nodes, limits, error, false));
+  ASSERT_TRUE(!sp::WritePrologWithLimits(o, nodes, limits, error, false, "", "", true));
+  ASSERT_TRUE(error.kind == sp::LimitKind::kHelperPairs && error.position == 1);
+  ASSERT_TRUE(o.str() == sp::ToProlog(nodes, false));
+  // ?x at (p 1), (q 1) and (p 2), and ?y at (p 2), (f 1) and (p 1) in the
+  // body, each once in the head
+  const auto rule = sp::Parse("(<= (h ?x ?y) (p ?x ?y) (q ?x (f ?y)) (p ?x ?z) (not (p ?y ?x)))");
+  limits.max_helper_pairs = 3 + 3 + 3 + 3;
+  ASSERT_TRUE(sp::CheckHelperPairLimit(rule, limits, error));
+  limits.max_helper_pairs -= 1;
+  ASSERT_TRUE(!sp::CheckHelperPairLimit(rule, limits, error));
+}
+
+// Random mutations of a game never crash the parser, and either parse
+// within the limits or report one
+TEST(ParseLimits, Fuzz) {
+  const auto kif = sp::GenerateGame();
+  const char alphabet[] = "();\n ?ab";
+  sp::ParseLimits limits;
+  limits.max_depth = 8;
+  limits.max_tokens = 2000;
+  limits.max_symbol_length = 16;
+  limits.max_nodes = 1500;
+  std::srand(1);
+  for (auto i = 0; i < 200; ++i) {
+    auto mutated = kif;
+    for (auto j = 0; j < 20; ++j) {
+      mutated[std::rand() % mutated.size()] = alphabet[std::rand() % (sizeof(alphabet) - 1)];
+    }
+    std::vector<sp::TreeNode> nodes;
+    sp::LimitError error;
+    const auto ok = sp::ParseKIFWithLimits(mutated, limits, nodes, error);
+    ASSERT_TRUE(ok == (error.kind == sp::LimitKind::kNone));
+  }
+}
+
+TEST(GenerateGame, Valid) {
+  sp::GameGeneratorOptions options;
+  options.num_predicates = 20;
+  options.nesting_depth = 2;
+  const auto kif = sp::GenerateGame(options);
+  ASSERT_TRUE(kif == sp::GenerateGame(options));
+  const auto nodes = sp::ParseKIF(kif);
+  const auto functors = sp::CollectFunctorAtoms(nodes);
+  for (const auto& name : {"role", "init", "legal", "next", "goal", "true", "does", "view19"}) {
+    ASSERT_TRUE(functors.count(name) == 1);
+  }
+  ASSERT_TRUE(sp::CollectNonFunctorAtoms(nodes).count("terminal") == 1);
+  const auto num_view_rules = std::count_if(nodes.begin(), nodes.end(), [](const sp::TreeNode& node) {
+    if (node.IsLeaf() || node.GetChildren().front().GetValue() != "<=") {
+      return false;
+    }
+    const auto& head = node.GetChildren().at(1);
+    const auto& name = head.IsLeaf() ? head.GetValue() : head.GetChildren().front().GetValue();
+    return name.compare(0, 4, "view") == 0;
+  });
+  ASSERT_TRUE(num_view_rules == 40);
+  ASSERT_TRUE(sp::ParseKIFParallel(kif, 3) == nodes);
+  options.seed = 2;
+  ASSERT_TRUE(sp::GenerateGame(options) != kif);
+}
+
+TEST(GenerateGame, Adversarial) {
+  const auto node = sp::Parse(sp::GenerateDeeplyNestedTerm(1000)).front();
+  auto depth = 0;
+  for (auto current = &node; !current->IsLeaf(); current = &current->GetChildren().back()) {
+    ++depth;
+  }
+  ASSERT_TRUE(depth == 1000);
+  const auto rule = sp::Parse(sp::GenerateWideRule(1000)).front();
+  ASSERT_TRUE(rule.GetChildren().size() == 1002);
+  ASSERT_TRUE(rule.GetChildren().at(1).ToSexpr() == "(wide ?x0 ?x1000)");
+}
+
+TEST(ClauseProfiler, LocateKIFForms) {
+  const auto kif = "(role x) ; comment (role y)\n\n  (<= terminal\n    (true done))\n  fact";
+  const auto locations = sp::LocateKIFForms(kif);
+  ASSERT_TRUE(locations.size() == sp::ParseKIF(kif).size());
+  ASSERT_TRUE(locations.size() == 3);
+  ASSERT_TRUE(locations[0].line == 1 && locations[0].column == 1);
+  ASSERT_TRUE(locations[1].line == 3 && locations[1].column == 3);
+  ASSERT_TRUE(locations[2].line == 5 && locations[2].column == 3);
+}
+
+TEST(ClauseProfiler, Report) {
+  const auto kif = std::string("(role x)\n(<= (legal ?r noop) (role ?r))\n(<= terminal (true done))");
+  const auto clauses = sp::ParseKIF(kif);
+  sp::ClauseProfiler profiler(clauses, sp::LocateKIFForms(kif));
+  ASSERT_TRUE(profiler.GetLabel(1) == "legal/2 at 2:1");
+  ASSERT_TRUE(profiler.GetLabel(2) == "terminal/0 at 3:1");
+  ASSERT_TRUE(sp::ClauseProfiler(clauses).GetLabel(0) == "role/1 #0");
+  {
+    sp::ClauseProfiler::Scope scope(&profiler, 2);
+    profiler.AddProbes(2, 5);
+  }
+  {
+    sp::ClauseProfiler::Scope scope(&profiler, 1);
+    profiler.AddProbes(1, 1);
+    profiler.AddTuples(1, 1);
+    // Longer than the other invocation on any clock
+    usleep(2000);
+  }
+  sp::ClauseProfiler other(clauses, sp::LocateKIFForms(kif));
+  {
+    sp::ClauseProfiler::Scope scope(&other, 1);
+  }
+  profiler.Merge(other);
+  ASSERT_TRUE(profiler.GetProfile(1).invocations == 2);
+  ASSERT_TRUE(profiler.GetProfile(1).tuples == 1);
+  ASSERT_TRUE(profiler.GetProfile(2).probes == 5);
+  ASSERT_TRUE(profiler.GetProfile(0).invocations == 0);
+  ASSERT_TRUE(profiler.GetSortedClauses() == std::vector<std::size_t>({1, 2}));
+  std::ostringstream report;
+  profiler.WriteReport(report);
+  const auto text = report.str();
+  ASSERT_TRUE(std::count(text.begin(), text.end(), '\n') == 3);
+  ASSERT_TRUE(text.find("legal/2 at 2:1") < text.find("terminal/0 at 3:1"));
+  std::ostringstream folded;
+  profiler.WriteFoldedStacks(folded, "game");
+  ASSERT_TRUE(folded.str().compare(0, 20, "game;legal/2 at 2:1 ") == 0);
+}
+
+TEST(Reachability, Game) {
+  auto clauses = sp::ParseKIF(sp::GenerateGame());
+  for (const auto& clause : sp::ParseKIF(
+      "(<= (legal ?r (pass ?o)) (role ?r) (role ?o) (distinct ?r ?o))"
+      "(<= (next (flag ?r)) (or (does ?r noop) (does ?r (pass ?o))))"
+      "(<= (next (never ?r)) (does ?r noop) (distinct ?r ?r))")) {
+    clauses.push_back(clause);
+  }
+  sp::ClauseProfiler profiler(clauses);
+  sp::Reachability reachability;
+  ASSERT_TRUE(sp::AnalyzeReachability(clauses, reachability, SIZE_MAX, &profiler));
+  std::unordered_set<std::string> bases;
+  for (const auto& base : reachability.bases) {
+    bases.insert(base.ToSexpr());
+  }
+  std::unordered_set<std::string> inputs;
+  for (const auto& input : reachability.inputs) {
+    inputs.insert(input.ToSexpr());
+  }
+  // 3x3 cells of b, r0 or r1, control of each role and a flag of each role
+  ASSERT_TRUE(bases.size() == 27 + 2 + 2);
+  ASSERT_TRUE(bases.count("(base (cell 2 3 r1))"));
+  ASSERT_TRUE(bases.count("(base (control r1))"));
+  ASSERT_TRUE(bases.count("(base (flag r0))"));
+  // Marks on 9 cells, noop and a pass for each role
+  ASSERT_TRUE(inputs.size() == 9 * 2 + 2 + 2);
+  ASSERT_TRUE(inputs.count("(input r0 (pass r1))"));
+  ASSERT_TRUE(!inputs.count("(input r0 (pass r0))"));
+  ASSERT_TRUE(reachability.iterations > 1);
+  // Joins of the mark rule are counted on its clause
+  const auto mark = std::find_if(clauses.begin(), clauses.end(), [](const sp::TreeNode& clause) {
+    return clause.ToSexpr().compare(0, 19, "(<= (legal ?r (mark") == 0;
+  }) - clauses.begin();
+  ASSERT_TRUE(profiler.GetProfile(mark).invocations > 0);
+  ASSERT_TRUE(profiler.GetProfile(mark).tuples >= 18);
+  ASSERT_TRUE(profiler.GetProfile(mark).probes >= profiler.GetProfile(mark).tuples);
+}
+
+TEST(Reachability, Unbounded) {
+  const auto clauses = sp::ParseKIF("(role r) (init (count 0)) (<= (next (count (s ?x))) (true (count ?x)))");
+  sp::Reachability reachability;
+  ASSERT_TRUE(!sp::AnalyzeReachability(clauses, reachability, 1000));
+  ASSERT_TRUE(reachability.fact_count > 1000);
+}
+
+TEST(DatalogStateMachine, Game) {
+  sp::DatalogStateMachine machine(sp::ParseKIF(sp::GenerateGame()));
+  ASSERT_TRUE(machine.IsValid());
+  ASSERT_TRUE(machine.GetRoleCount() == 2);
+  ASSERT_TRUE(machine.GetRoleName(1) == "r1");
+  auto state = machine.GetInitialState();
+  ASSERT_TRUE(state.size() == 9 + 1);
+  ASSERT_TRUE(!machine.IsTerminal(state));
+  ASSERT_TRUE(machine.GetLegalMoves(state, 0).size() == 9);
+  const auto noop = machine.GetLegalMoves(state, 1);
+  ASSERT_TRUE(noop.size() == 1 && machine.ToTreeNode(noop[0]).ToSexpr() == "noop");
+  // Marking every cell in turn
+  for (auto i = 0; i < 9; ++i) {
+    const auto role = i % 2;
+    const auto moves = machine.GetLegalMoves(state, role);
+    ASSERT_TRUE(moves.size() == static_cast<std::size_t>(9 - i));
+    std::vector<sp::GameMove> joint_moves(2);
+    joint_moves[role] = moves.front();
+    joint_moves[1 - role] = machine.GetLegalMoves(state, 1 - role).front();
+    state = machine.GetNextState(state, joint_moves);
+  }
+  ASSERT_TRUE(machine.IsTerminal(state));
+  ASSERT_TRUE(machine.GetGoal(state, 0) + machine.GetGoal(state, 1) == 100);
+  ASSERT_TRUE(!sp::DatalogStateMachine(sp::ParseKIF("(role r) (<= p (not q)) (<= q (not p))")).IsValid());
+}
+
+TEST(DatalogStateMachine, GroundFacts) {
+  // Facts of relations that also have state-dependent rules
+  const auto clauses = sp::ParseKIF(
+      "(role a) (role b) (init (step 0)) (succ 0 1)"
+      "(legal b noop) (<= (legal a go) (true (step 0)))"
+      "(<= (next (step ?y)) (true (step ?x)) (succ ?x ?y))"
+      "(goal a 50) (<= (goal b 100) (true (step 1)))"
+      "(<= terminal (true (step 1)))");
+  sp::DatalogStateMachine machine(clauses);
+  ASSERT_TRUE(machine.IsValid());
+  const auto init = machine.GetInitialState();
+  ASSERT_TRUE(machine.GetLegalMoves(init, 0).size() == 1);
+  ASSERT_TRUE(machine.GetLegalMoves(init, 1).size() == 1);
+  const auto moves = std::vector<sp::GameMove>{machine.GetLegalMoves(init, 0)[0], machine.GetLegalMoves(init, 1)[0]};
+  const auto next = machine.GetNextState(init, moves);
+  ASSERT_TRUE(machine.IsTerminal(next));
+  ASSERT_TRUE(machine.GetLegalMoves(next, 1).size() == 1);
+  ASSERT_TRUE(machine.GetGoal(next, 0) == 50 && machine.GetGoal(next, 1) == 100);
+  ASSERT_TRUE(machine.GetGoal(init, 0) == 50 && machine.GetGoal(init, 1) == -1);
+  sp::GameStatisticsOptions options;
+  options.time_limit = 0;
+  options.max_playouts = 5;
+  sp::GameStatistics statistics;
+  ASSERT_TRUE(sp::SampleGameStatistics(clauses, options, statistics));
+  ASSERT_TRUE(statistics.incomplete_playouts == 0);
+  ASSERT_TRUE(statistics.length.mean == 1);
+}
+
+TEST(GameStatistics, Sample) {
+  const auto clauses = sp::ParseKIF(sp::GenerateGame());
+  sp::GameStatisticsOptions options;
+  options.num_threads = 3;
+  options.time_limit = 0;
+  options.max_playouts = 40;
+  sp::GameStatistics statistics;
+  ASSERT_TRUE(sp::SampleGameStatistics(clauses, options, statistics));
+  ASSERT_TRUE(statistics.playouts == 40);
+  ASSERT_TRUE(statistics.incomplete_playouts == 0);
+  ASSERT_TRUE(statistics.states == 40 * 9);
+  // Every game fills the board
+  ASSERT_TRUE(statistics.length.mean == 9 && statistics.length.margin == 0);
+  ASSERT_TRUE(statistics.min_length == 9 && statistics.max_length == 9);
+  ASSERT_TRUE(!statistics.is_simultaneous);
+  ASSERT_TRUE(statistics.roles.size() == 2 && statistics.roles[0].name == "r0");
+  // r0 has 9, 7, 5, 3 and 1 moves in its turns and a noop in the others
+  ASSERT_TRUE(std::abs(statistics.roles[0].branching_factor.mean - 29.0 / 9) < 1e-9);
+  ASSERT_TRUE(std::abs(statistics.roles[1].branching_factor.mean - 25.0 / 9) < 1e-9);
+  ASSERT_TRUE(statistics.roles[0].goal_counts[0] + statistics.roles[0].goal_counts[100] == 40);
+  ASSERT_TRUE(statistics.roles[0].goal_counts[100] == statistics.roles[1].goal_counts[0]);
+  ASSERT_TRUE(statistics.roles[0].goal.margin > 0);
+  // The same playouts with other threads
+  options.num_threads = 1;
+  sp::GameStatistics single_threaded;
+  ASSERT_TRUE(sp::SampleGameStatistics(clauses, options, single_threaded));
+  ASSERT_TRUE(single_threaded.roles[0].goal_counts == statistics.roles[0].goal_counts);
+  // Simultaneous moves, and a fingerprint independent of the clause order
+  auto simultaneous = sp::ParseKIF(
+      "(role a) (role b) (init (step 0)) (succ 0 1) (succ 1 2)"
+      "(<= (legal ?r (pick 1)) (role ?r)) (<= (legal ?r (pick 2)) (role ?r))"
+      "(<= (next (step ?y)) (true (step ?x)) (succ ?x ?y))"
+      "(<= (next (won ?r)) (does ?r (pick 2)) (role ?o) (distinct ?r ?o) (does ?o (pick 1)))"
+      "(<= (next (won ?r)) (true (won ?r)))"
+      "(<= terminal (true (step 2)))"
+      "(<= (goal ?r 100) (true (won ?r))) (<= (goal ?r 0) (role ?r) (not (true (won ?r))))");
+  options.max_playouts = 20;
+  sp::GameStatistics simultaneous_statistics;
+  ASSERT_TRUE(sp::SampleGameStatistics(simultaneous, options, simultaneous_statistics));
+  ASSERT_TRUE(simultaneous_statistics.is_simultaneous && simultaneous_statistics.simultaneous_fraction == 1);
+  ASSERT_TRUE(simultaneous_statistics.joint_branching_factor.mean == 4);
+  std::reverse(simultaneous.begin(), simultaneous.end());
+  ASSERT_TRUE(sp::GetGameFingerprint(simultaneous) == simultaneous_statistics.fingerprint);
+  ASSERT_TRUE(simultaneous_statistics.fingerprint != statistics.fingerprint);
+  std::ostringstream json;
+  sp::WriteGameStatisticsJSON(json, statistics);
+  ASSERT_TRUE(json.str().find("\"fingerprint\":\"" + statistics.fingerprint + "\"") != std::string::npos);
+  ASSERT_TRUE(json.str().find("\"goal_counts\":{\"0\":") != std::string::npos);
+}
+
+TEST(CorpusLoader, Load) {
+  std::vector<std::string> paths;
+  std::vector<std::string> kifs;
+  for (auto i = 0; i < 20; ++i) {
+    sp::GameGeneratorOptions options;
+    options.seed = i;
+    // Larger than the first read of the fallback's pipes and of io_uring
+    options.num_predicates = i == 0 ? 5000 : 5;
+    kifs.push_back(i == 1 ? std::string() : sp::GenerateGame(options));
+    char path[] = "/tmp/sexpr_parser_testXXXXXX";
+    const auto fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_TRUE(write(fd, kifs.back().data(), kifs.back().size()) == static_cast<ssize_t>(kifs.back().size()));
+    close(fd);
+    paths.push_back(path);
+  }
+  paths.push_back("/tmp/sexpr_parser_test_missing");
+  // 1 byte lets a single text wait at a time, smaller than any file here
+  for (const std::size_t max_queued_bytes : {std::size_t(256 << 20), std::size_t(1)}) {
+    for (const auto uses_io_uring : {true, false}) {
+      sp::CorpusLoaderOptions options;
+      options.uses_io_uring = uses_io_uring;
+      options.queue_depth = 4;
+      options.num_parse_threads = 3;
+      options.max_queued_bytes = max_queued_bytes;
+      sp::CorpusLoader loader(options);
+      const auto files = loader.Load(paths);
+      if (!uses_io_uring) {
+        ASSERT_TRUE(loader.GetLastBackend() == sp::LoaderBackend::kThreadPool);
+      }
+      ASSERT_TRUE(files.size() == 21);
+      for (auto i = 0; i < 20; ++i) {
+        ASSERT_TRUE(files[i].path == paths[i]);
+        ASSERT_TRUE(files[i].error == 0);
+        ASSERT_TRUE(files[i].size == kifs[i].size());
+        ASSERT_TRUE(files[i].forms == sp::ParseKIF(kifs[i]));
+      }
+      ASSERT_TRUE(files[20].error == ENOENT);
+    }
+  }
+  sp::CorpusLoaderOptions options;
+  options.limits.max_tokens = 1000;
+  const auto files = sp::CorpusLoader(options).Load(paths);
+  ASSERT_TRUE(files[0].limit_error.kind == sp::LimitKind::kTokens);
+  // Not the forms before the limit was exceeded
+  ASSERT_TRUE(files[0].forms.empty());
+  ASSERT_TRUE(files[2].limit_error.kind == sp::LimitKind::kNone);
+  ASSERT_TRUE(!files[2].forms.empty());
+  for (auto i = 0; i < 20; ++i) {
+    std::remove(paths[i].c_str());
+  }
+}
+
+TEST(MessageParser, SameAsParse) {
+  sp::MessageParser parser;
+  for (const auto& sexpr : {
+      std::string("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))"),
+      std::string(" ; comment\n(a;comment\nb) () ) (c (d"),
+      std::string(""),
+      sp::GenerateGame()}) {
+    parser.Parse(sexpr);
+    std::vector<sp::TreeNode> nodes;
+    for (std::size_t i = 0; i < parser.GetRootCount(); ++i) {
+      nodes.push_back(parser.ToTreeNode(parser.GetRoot(i)));
+    }
+    ASSERT_TRUE(nodes == sp::Parse(sexpr));
+  }
+  parser.Parse("(a bc)");
+  ASSERT_TRUE(parser.GetChildCount(0) == 2);
+  ASSERT_TRUE(parser.GetChild(0, 1) == 2);
+  ASSERT_TRUE(std::string(parser.GetValue(2), parser.GetValueLength(2)) == "bc");
+  // Values themselves, not only through ToTreeNode()
+  const auto sexpr = std::string("(ROLE Player) (<= TERMINAL (True (Control x)) (DISTINCT ?X TERMINALS))");
+  parser.Parse(sexpr);
+  sp::FlatDocument document(sp::Parse(sexpr));
+  ASSERT_TRUE(parser.GetNodeCount() == document.GetNodeCount());
+  for (sp::NodeIndex i = 0; i < parser.GetNodeCount(); ++i) {
+    ASSERT_TRUE(parser.IsLeaf(i) == document.IsLeaf(i));
+    if (parser.IsLeaf(i)) {
+      ASSERT_TRUE(std::string(parser.GetValue(i), parser.GetValueLength(i)) == document.GetSymbol(document.GetNode(i).symbol));
+    }
+  }
+  ASSERT_TRUE(std::string(parser.GetValue(1), parser.GetValueLength(1)) == "role");
+  ASSERT_TRUE(std::string(parser.GetValue(2), parser.GetValueLength(2)) == "Player");
+}
+
+// Allocation budgets. A failure means that an API allocates more than it
+// used to.
+
+TEST(AllocationBudget, Accessors) {
+  const auto nodes = sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
+  const sp::FlatDocument document(nodes);
+  const auto kif = std::string("(role player) ((fact2 1))");
+  auto c_document = sp_parse(kif.data(), kif.size());
+  AllocationCounter counter;
+  auto checksum = (nodes[3] == nodes[4]) + nodes[4].GetChildren().size() + nodes[1].GetValue().size();
+  for (sp::NodeIndex i = 0; i < document.GetNodeCount(); ++i) {
+    checksum += document.GetChildCount(i) + document.IsLeaf(i);
+  }
+  for (sp_node i = 0; i < sp_document_node_count(c_document); ++i) {
+    checksum += sp_node_child_count(c_document, i) + sp_node_get_value(c_document, i).length;
+  }
+  ASSERT_TRUE(counter.GetCount() == 0);
+  ASSERT_TRUE(checksum > 0);
+  sp_document_free(c_document);
+}
+
+TEST(AllocationBudget, Traversal) {
+  const auto nodes = sp::Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
+  AllocationCounter counter;
+  std::size_t count = 0;
+  for (sp::TreeCursor cursor(nodes); cursor.IsValid(); cursor.Next()) {
+    ++count;
+  }
+  ASSERT_TRUE(count == 20);
+  // Only the cursor's two stacks
+  ASSERT_TRUE(counter.GetCount() <= 2);
+}
+
+TEST(AllocationBudget, Parse) {
+  const auto sexpr = std::string("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
+  AllocationCounter counter;
+  const auto nodes = sp::Parse(sexpr);
+  // One child vector per list and the growth of the result, as the atoms
+  // fit in the small string buffer
+  ASSERT_TRUE(counter.GetCount() <= 20);
+}
+
+TEST(AllocationBudget, ReusedParser) {
+  sp::MessageParser parser;
+  parser.Parse("(play 12 (mark 1 2) nil) ; first message");
+  const auto message = std::string("(play 12 (mark 2 2) noop)");
+  AllocationCounter counter;
+  parser.Parse(message);
+  ASSERT_TRUE(counter.GetCount() == 0);
+  ASSERT_TRUE(parser.GetNodeCount() == 8);
+}
+
+TEST(AllocationBudget, Serialization) {
+  const auto node = sp::Parse("(<= (rule2 ?x) fact1 (fact2 ?x) (fact3 ?x ?y ?z) (fact4 (f ?x) (g ?y) (h ?z)))").front();
+  {
+    AllocationCounter counter;
+    const auto sexpr = node.ToSexpr();
+    // Growth of the result only
+    ASSERT_TRUE(counter.GetCount() <= 3);
+  }
+  {
+    AllocationCounter counter;
+    const auto sexpr = node.ToSexpr(12);
+    // Short enough for the small string buffer
+    ASSERT_TRUE(counter.GetCount() == 0);
+  }
+}
+
+TEST(AllocationBudget, SteadyStateDelta) {
+  const auto state = sp::Parse("(true (cell 1 b)) (true (cell 2 x)) (true (control x)) (does x (mark 1))");
+  sp::PrologStateDeltaEmitter emitter(false);
+  emitter.EmitDelta(std::vector<sp::TreeNode>(), state);
+  emitter.EmitDelta(state, std::vector<sp::TreeNode>());
+  AllocationCounter counter;
+  const auto delta = emitter.EmitDelta(state, state);
+  ASSERT_TRUE(delta.empty());
+  // Facts are interned before, and the buffers hold states of this size
+  ASSERT_TRUE(counter.GetCount() == 0);
+}
+
+TEST(AllocationBudget, IncrementalEdit) {
+  sp::IncrementalParser parser("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
+  AllocationCounter counter;
+  parser.Edit(21, 5, "fact3");
+  // Proportional to the changed form, not to the text
+  ASSERT_TRUE(counter.GetCount() <= 5);
+}